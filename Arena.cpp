@@ -0,0 +1,80 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "Arena.h"
+#include "MathDefs.h"
+
+Arena::Arena(unsigned size) :
+	buffer_(new unsigned char[size]),
+	capacity_(size),
+	used_(0),
+	overflowSize_(0),
+	peak_(0),
+	numHeapAllocations_(1)
+{
+}
+
+Arena::~Arena()
+{
+	for (unsigned i = 0; i < overflow_.Size(); ++i)
+		delete[] overflow_[i];
+	delete[] buffer_;
+}
+
+void* Arena::Allocate(unsigned size, unsigned alignment)
+{
+	unsigned start = (used_ + alignment - 1) & ~(alignment - 1);
+	if (start + size <= capacity_)
+	{
+		used_ = start + size;
+		return buffer_ + start;
+	}
+
+	// Out of room until the next reset. new[] aligns for any plain type
+	unsigned char* block = new unsigned char[size];
+	overflow_.Push(block);
+	overflowSize_ += size;
+	++numHeapAllocations_;
+	return block;
+}
+
+void Arena::Reset()
+{
+	peak_ = Max((int)peak_, (int)(used_ + overflowSize_));
+
+	if (!overflow_.Empty())
+	{
+		for (unsigned i = 0; i < overflow_.Size(); ++i)
+			delete[] overflow_[i];
+		overflow_.Clear();
+		overflowSize_ = 0;
+
+		// Room for the high-water mark and the alignment padding between allocations
+		delete[] buffer_;
+		capacity_ = NextPowerOfTwo(peak_ + peak_ / 4);
+		buffer_ = new unsigned char[capacity_];
+		++numHeapAllocations_;
+	}
+
+	used_ = 0;
+}
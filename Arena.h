@@ -0,0 +1,135 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "Vector.h"
+
+#include <new>
+
+using namespace Urho3D;
+
+/// Bump allocator for transient plain data. Allocations are not freed one by one, Reset() drops them all at once. When the
+/// buffer runs out, the rest of the period is served from separate heap blocks and the next Reset() grows the buffer to the
+/// high-water mark, so a steady state does not touch the heap.
+class Arena
+{
+public:
+	/// Construct with an initial buffer size in bytes.
+	Arena(unsigned size);
+	/// Destruct.
+	~Arena();
+
+	/// Allocate uninitialized memory. Alignment must be a power of two.
+	void* Allocate(unsigned size, unsigned alignment = 16);
+	/// Allocate an uninitialized array, aligned to the lowest set bit of the value size up to 16. A type's size is a multiple
+	/// of its alignment, so that is enough for the type.
+	template <class T> T* Allocate(unsigned count)
+	{
+		unsigned alignment = sizeof(T) & (0u - (unsigned)sizeof(T));
+		return static_cast<T*>(Allocate(count * sizeof(T), alignment < 16 ? alignment : 16));
+	}
+	/// Drop all allocations.
+	void Reset();
+
+	/// Return bytes allocated since the last reset.
+	unsigned GetUsed() const { return used_ + overflowSize_; }
+	/// Return the buffer size in bytes.
+	unsigned GetCapacity() const { return capacity_; }
+	/// Return the most bytes allocated between two resets.
+	unsigned GetPeak() const { return peak_; }
+	/// Return how many times the arena had to go to the heap.
+	unsigned GetNumHeapAllocations() const { return numHeapAllocations_; }
+
+private:
+	/// Prevent copy construction.
+	Arena(const Arena& rhs);
+	/// Prevent assignment.
+	Arena& operator = (const Arena& rhs);
+
+	/// Buffer.
+	unsigned char* buffer_;
+	/// Buffer size.
+	unsigned capacity_;
+	/// Bytes used in the buffer.
+	unsigned used_;
+	/// Heap blocks allocated after the buffer ran out.
+	PODVector<unsigned char*> overflow_;
+	/// Bytes allocated in heap blocks.
+	unsigned overflowSize_;
+	/// High-water mark.
+	unsigned peak_;
+	/// Heap allocations made.
+	unsigned numHeapAllocations_;
+};
+
+/// Growable array of values in an arena. Growing copy constructs the values in a new allocation, the old one is dropped with
+/// the rest of the arena. Values are never destructed, so they must not own memory or other resources.
+template <class T> class ArenaArray
+{
+public:
+	/// Construct empty.
+	ArenaArray(Arena& arena) :
+		arena_(arena),
+		data_(0),
+		size_(0),
+		capacity_(0)
+	{
+	}
+
+	/// Add a value to the end.
+	void Push(const T& value)
+	{
+		if (size_ == capacity_)
+		{
+			unsigned capacity = capacity_ ? capacity_ * 2 : 16;
+			T* data = arena_.Allocate<T>(capacity);
+			for (unsigned i = 0; i < size_; ++i)
+				new(data + i) T(data_[i]);
+			data_ = data;
+			capacity_ = capacity;
+		}
+		new(data_ + size_++) T(value);
+	}
+
+	/// Return value at index.
+	T& operator [](unsigned index) { return data_[index]; }
+	/// Return const value at index.
+	const T& operator [](unsigned index) const { return data_[index]; }
+	/// Return the values.
+	const T* GetData() const { return data_; }
+	/// Return number of values.
+	unsigned Size() const { return size_; }
+	/// Return whether empty.
+	bool Empty() const { return size_ == 0; }
+
+private:
+	/// Arena.
+	Arena& arena_;
+	/// Values.
+	T* data_;
+	/// Number of values.
+	unsigned size_;
+	/// Room for values.
+	unsigned capacity_;
+};
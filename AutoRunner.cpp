@@ -22,15 +22,29 @@
 
 #include "AnimatedModel.h"
 #include "AnimationController.h"
+#include "BlockPool.h"
 #include "Camera.h"
+#include "CameraRig.h"
 #include "Character.h"
+#include "ComponentPool.h"
 #include "CollisionShape.h"
 #include "Controls.h"
 #include "CoreEvents.h"
+#include "DebugHud.h"
+#include "DebugLayer.h"
+#include "FrameJobGraph.h"
+#include "GameMemory.h"
 #include "Engine.h"
+#include "EngineEvents.h"
 #include "FileSystem.h"
 #include "Font.h"
+#include "GameEvents.h"
+#include "GameIds.h"
+#include "GhostRace.h"
 #include "Input.h"
+#include "LatencyTracer.h"
+#include "Leaderboard.h"
+#include "LevelScript.h"
 #include "Light.h"
 #include "Material.h"
 #include "Model.h"
@@ -40,11 +54,15 @@
 #include "Renderer.h"
 #include "RigidBody.h"
 #include "ResourceCache.h"
+#include "RivalCrowd.h"
+#include "RunnerLevel.h"
+#include "RunSnapshot.h"
 #include "Scene.h"
 #include "StaticModel.h"
 #include "Text.h"
 #include "Touch.h"
 #include "UI.h"
+#include "WorkQueue.h"
 #include "Zone.h"
 
 #include "AutoRunner.h"
@@ -63,8 +81,10 @@
 #include "XMLFile.h"
 #include "PhysicsEvents.h"
 #include "SmoothedTransform.h"
+#include "StartupTimeline.h"
 #include "Log.h"
 #include "Param.h"
+#include "PerfOverlay.h"
 #include "Menu.h"
 #include "UIEvents.h"
 #include "Console.h"
@@ -82,17 +102,49 @@ DEFINE_APPLICATION_MAIN(AutoRunner)
 AutoRunner::AutoRunner(Context* context) :
 	Sample(context),
 	touch_(new Touch(context)),
+	cameraRig_(new CameraRig(context)),
+	perfOverlay_(new PerfOverlay(context)),
+	debugLayer_(new DebugLayer(context)),
+	leaderboard_(new Leaderboard(context)),
+	snapshot_(new RunSnapshot(context)),
+	levelScript_(new LevelScript(context)),
+	rivals_(new RivalCrowd(context)),
+	numRivals_(0),
+	frameJobs_(new FrameJobGraph(context)),
+	rivalJob_(0),
+	rivalNodesJob_(0),
+	cameraJob_(0),
+	frameTimeStep_(0.0f),
 	drawDebug_(false),
 	isPlaying_(false),
 	useMouseMove_(false),
-	numBlocks_(0)
+	profiling_(false),
+	profilerInterval_(0.0f),
+	fpsFrames_(0),
+	fpsTime_(0.0f),
+	hudDistance_(0),
+	hudFps_(0),
+	loadingText_(0),
+	gameMenu_(0),
+	playText_(0),
+	infoText_(0),
+	lastScoreText_(0),
+	highScoreText_(0),
+	newHighScoreMark_(0),
+	newHighScore_(false)
 {
+	// Time the cold start from here, the engine has been constructed
+	context->RegisterSubsystem(new StartupTimeline(context));
 	Character::RegisterObject(context);
+	context->RegisterSubsystem(new GameEventHub(context));
+	context->RegisterSubsystem(new GameMemory(context));
+	context->RegisterSubsystem(new GhostRace(context));
 }
 
 void AutoRunner::Setup()
 {
 	Sample::Setup();
+	GetSubsystem<StartupTimeline>()->Mark("Application setup");
 	/*// On Android and iOS, read command line from a file as parameters can not otherwise be easily given
 #if defined(ANDROID) || defined(IOS)
 	engineParameters_["FullScreen"]  = true;
@@ -106,6 +158,10 @@ void AutoRunner::Setup()
 
 void AutoRunner::Start()
 {
+	// Graphics, renderer, audio, resource and UI subsystems were initialized since setup
+	StartupTimeline* timeline = GetSubsystem<StartupTimeline>();
+	timeline->Mark("Engine initialize");
+
 #ifdef ENABLE_ANGELSCRIPT
 	// Instantiate and register the AngelScript subsystem
 	context_->RegisterSubsystem(new Script(context_));
@@ -117,17 +173,43 @@ void AutoRunner::Start()
 	context_->RegisterSubsystem(luaScript);
 #endif
 
+	timeline->Mark("Script subsystems");
+
 	// Execute base class startup
 	Sample::Start();
+	timeline->Mark("Sample start");
+
+	// Trace input latency of the desktop keys. Touch swipes are traced by the Touch helper.
+	LatencyTracer* tracer = new LatencyTracer(context_);
+	context_->RegisterSubsystem(tracer);
+	tracer->MapKey('A', CTRL_LEFT);
+	tracer->MapKey('D', CTRL_RIGHT);
+	tracer->MapKey('S', CTRL_BACK);
+	tracer->MapKey('W', CTRL_JUMP);
+
+	// Identifier hashes are computed at startup, check that no two of them collide
+	CheckGameIds();
+
+	// Block components come from pools. -nopools allocates them from the heap, to compare the two
+	if (!GetArguments().Contains("-nopools"))
+		RegisterComponentPools(context_);
+	timeline->Mark("Game subsystems");
 
 	// Init scene content
 	InitScene();
+	timeline->Mark("Scene");
 
 	// Create Camera
 	CreateCamera();
+	cameraRig_->SetPhysicsWorld(scene_->GetComponent<PhysicsWorld>());
+	perfOverlay_->SetScene(scene_, cameraNode_->GetComponent<Camera>());
+	perfOverlay_->SetBlockPool(level_->GetPool());
+	timeline->Mark("Camera");
 
 	// Create overlays
 	CreateOverlays();
+	CreateFrameJobs();
+	timeline->Mark("Overlays and jobs");
 
 	// Initialize touch input on Android & iOS
 	if (GetPlatform() == "Android" || GetPlatform() == "iOS")
@@ -142,15 +224,71 @@ void AutoRunner::Start()
 	// Subscribe to necessary events
 	SubscribeToEvents();
 
-	//GetSubsystem<Console>()->Toggle();
-	GetSubsystem<Console>()->SetFocusOnShow(false);
+	// Race ghosts: -ghosthost serves and races on this machine, -ghost <address> joins a server
+	GhostRace* ghostRace = GetSubsystem<GhostRace>();
+	ghostRace->SetScene(scene_);
+	ghostRace->SetLevel(level_);
+	const Vector<String>& arguments = GetArguments();
+	for (unsigned i = 0; i < arguments.Size(); ++i)
+	{
+		if (arguments[i] == "-ghosthost" && ghostRace->StartServer(GHOST_PORT))
+			ghostRace->Connect("127.0.0.1", GHOST_PORT);
+		else if (arguments[i] == "-ghost" && i + 1 < arguments.Size())
+			ghostRace->Connect(arguments[++i], GHOST_PORT);
+	}
+
+	// Scores persist between sessions, -leaderboard <url> also posts them to a leaderboard server
+	leaderboard_->Load(GetUserDataDir() + "Leaderboard.dat");
+	for (unsigned i = 0; i + 1 < arguments.Size(); ++i)
+	{
+		if (arguments[i] == "-leaderboard")
+			leaderboard_->SetURL(arguments[i + 1]);
+		else if (arguments[i] == "-rivals")
+			numRivals_ = ToUInt(arguments[i + 1]);
+		else if (arguments[i] == "-levelscript")
+			levelScript_->Load(arguments[i + 1]);
+	}
+	timeline->Mark("Ghosts and scores");
+
+	// Compare the typed channels against engine event dispatch when asked to
+	if (GetArguments().Contains("-benchevents"))
+		GetSubsystem<GameEventHub>()->Benchmark(100000);
+
+	// The console drives the game's tuning commands. Script subsystems would otherwise try to execute each line too
+#ifdef ENABLE_ANGELSCRIPT
+	GetSubsystem<Script>()->SetExecuteConsoleCommands(false);
+#endif
+#ifdef ENABLE_LUA
+	GetSubsystem<LuaScript>()->SetExecuteConsoleCommands(false);
+#endif
+
+	// The logo stays hidden, so it is never created. The console and debug HUD are created when first toggled
 	GetSubsystem<Graphics>()->SetWindowTitle("AutoRunner Kit Game");
-	SetLogoVisible(false);
 	CreateUI();
+	timeline->Mark("Menu UI");
+
+	// Continue a run that was interrupted by the application going to the background
+	if (snapshot_->Load(GetSnapshotFileName()))
+	{
+		ResumeRun();
+		timeline->Mark("Snapshot resume");
+	}
+}
+
+void AutoRunner::SetupConsole(Console* console)
+{
+	// Keep the game keys working while the console shows the log
+	console->SetFocusOnShow(false);
 }
 
 void AutoRunner::Stop()
 {
+	// Headless runs have no HUD to show latencies, so write them out.
+	if (engine_->IsHeadless())
+		GetSubsystem<LatencyTracer>()->SaveHistograms(GetSubsystem<FileSystem>()->GetProgramDir() + "InputLatency.csv");
+
+	GetSubsystem<GameEventHub>()->UnsubscribeAll(this);
+	leaderboard_->Save();
 	ResetGame();
 }
 
@@ -162,31 +300,15 @@ void AutoRunner::InitScene()
 	String resourceDataDir = dirs[1];
 
 	scene_ = new Scene(context_);
-	// Create RunnerGameKit Scene to create all prefabs
-	if (cache->Exists("Data/RunnerGameKit_Scene.cfg"))
-	{
-		XMLFile* kitConfig = cache->GetResource<XMLFile>("Data/RunnerGameKit_Scene.cfg");
-		if (kitConfig->GetRoot())
-		{
-			// Load all block properties from Scene.cfg file
-			XMLElement rootElement = kitConfig->GetRoot();
-			assert(rootElement.HasChild("block"));
-			XMLElement blockElement = rootElement.GetChild("block");
-			// Traverse all Block nodes
-			for (XMLElement blockElement = rootElement.GetChild(); !blockElement.IsNull(); blockElement = blockElement.GetNext())
-			{
-				String blockName = blockElement.GetAttribute("name");
-				blockNames_.Push("Objects/" + blockName + ".xml");
-			}
-		}
-	}
-	else
-	{
-		InitBlockParameters();
-	}
-
 	File loadFile(context_, resourceDataDir + "Scenes/AutoRunner.xml", FILE_READ);
 	scene_->LoadXML(loadFile);
+	debugLayer_->SetScene(scene_);
+	level_ = new RunnerLevel(context_);
+	level_->SetScene(scene_);
+	level_->SetDebugLayer(debugLayer_);
+	level_->SetScript(levelScript_);
+	// Floor bodies of a block are merged into one static body. -nomerge keeps a body per floor, to compare broadphase costs
+	level_->GetPool()->SetMergeStatic(!GetArguments().Contains("-nomerge"));
 
 	String platform = GetPlatform();
 	if (platform == "Android" || platform == "iOS" || platform == "Raspberry Pi")
@@ -213,54 +335,6 @@ void AutoRunner::InitScene()
 	soundSource->Play(sound);
 }
 
-void AutoRunner::CreateCharacter()
-{
-	ResourceCache* cache = GetSubsystem<ResourceCache>();
-	// Create root node of player
-	Node* objectNode = scene_->CreateChild("Player");
-	objectNode->SetPosition(Vector3(0.0f, 40.0f, 0.0f));
-	// Create model node
-	Node* modelNode = objectNode->CreateChild("PlayerModel");
-	modelNode->SetScale(Vector3(.4f, .4f, .4f));
-	modelNode->SetRotation(Quaternion(180, Vector3::UP));
-	// Create the rendering component + animation controller
-	AnimatedModel* object = modelNode->CreateComponent<AnimatedModel>();
-	object->SetModel(cache->GetResource<Model>("Models/vempire.mdl"));
-	object->SetMaterial(cache->GetResource<Material>("Materials/Vempire.xml"));
-	object->SetCastShadows(true);
-	modelNode->CreateComponent<AnimationController>();
-
-	String headName = "Bip001 Head";
-	// Set the head bone for manual control
-	object->GetSkeleton().GetBone(headName)->animated_ = false;
-
-	// Create rigidbody, and set non-zero mass so that the body becomes dynamic
-	RigidBody* body = objectNode->CreateComponent<RigidBody>();
-	body->SetCollisionLayer(FLOOR_COLLISION_MASK|COIN_COLLISION_MASK|OBSTACLE_COLLISION_MASK);
-	body->SetMass(1.0f);
-
-	// Set zero angular factor so that physics doesn't turn the character on its own.
-	// Instead we will control the character yaw manually
-	body->SetAngularFactor(Vector3::ZERO);
-
-	// Set the rigidbody to signal collision also when in rest, so that we get ground collisions properly
-	body->SetCollisionEventMode(COLLISION_ALWAYS);
-
-	// Set a capsule shape for collision
-	CollisionShape* shape = objectNode->CreateComponent<CollisionShape>();
-	shape->SetCapsule(0.7f, 1.5f, Vector3(0.0f, 0.8f, 0.0f));
-
-	// Create the character logic component, which takes care of steering the rigidbody
-	// Remember it so that we can set the controls. Use a WeakPtr because the scene hierarchy already owns it
-	// and keeps it alive as long as it's not removed from the hierarchy
-	character_ = objectNode->CreateComponent<Character>();
-	// Set the head of this character body.
-	characterHead_ = modelNode->GetChild(headName, true);
-
-	// Add smoothed transform component.
-	objectNode->CreateComponent<SmoothedTransform>();
-}
-
 void AutoRunner::CreateCamera()
 {
 	cameraNode_ = new Node(context_);
@@ -285,14 +359,27 @@ void AutoRunner::CreateOverlays()
 	ResourceCache* cache = GetSubsystem<ResourceCache>();
 	UI* ui = GetSubsystem<UI>();
 	
-	// Construct new Text object, set string to display and font to use
-	scoreText_ = ui->GetRoot()->CreateChild<Text>();
-	scoreText_->SetText("Score 0");
-	scoreText_->SetFont(cache->GetResource<Font>("Fonts/BlueHighway.ttf"), 17);
-	scoreText_->SetPosition(5, 5);
-	scoreText_->SetAlignment(HA_LEFT, VA_TOP);
-	scoreText_->SetColor(C_BOTTOMLEFT, Color(1, 1, 0.25));
-	scoreText_->SetColor(C_BOTTOMRIGHT, Color(1, 1, 0.25));
+	// Construct the HUD counter Text objects, set font to use. The counters set their text on change only
+	HudCounter* counters[] = { &scoreCounter_, &distanceCounter_, &coinsCounter_, &fpsCounter_ };
+	const char* formats[] = { "Score %d", "Distance %dm", "Coins %d", "FPS %d" };
+	for (unsigned i = 0; i < 4; ++i)
+	{
+		Text* counterText = ui->GetRoot()->CreateChild<Text>();
+		counterText->SetFont(cache->GetResource<Font>("Fonts/BlueHighway.ttf"), 17);
+		counterText->SetColor(C_BOTTOMLEFT, Color(1, 1, 0.25));
+		counterText->SetColor(C_BOTTOMRIGHT, Color(1, 1, 0.25));
+		counters[i]->SetText(counterText, formats[i]);
+		counters[i]->SetValue(0);
+	}
+
+	// Score, distance and coins are stacked at the top left, FPS at the top right.
+	for (unsigned i = 0; i < 3; ++i)
+	{
+		counters[i]->GetText()->SetPosition(5, 5 + i * 20);
+		counters[i]->GetText()->SetAlignment(HA_LEFT, VA_TOP);
+	}
+	fpsCounter_.GetText()->SetPosition(-5, 5);
+	fpsCounter_.GetText()->SetAlignment(HA_RIGHT, VA_TOP);
 
 	// Construct Loading Text object.
 	loadingText_ = ui->GetRoot()->CreateChild<Text>();
@@ -307,8 +394,12 @@ void AutoRunner::CreateOverlays()
 
 void AutoRunner::SubscribeToEvents()
 {
-	// Subscribe to FixedUpdate event for updating the character path
-	SubscribeToEvent(E_PHYSICSPRESTEP, HANDLER(AutoRunner, HandleFixedUpdate));
+	// Subscribe to the physics pre-step. Input is applied first, then the character's fixed update runs from the typed step channel
+	SubscribeToEvent(scene_->GetComponent<PhysicsWorld>(), E_PHYSICSPRESTEP, HANDLER(AutoRunner, HandleFixedUpdate));
+
+	// Score and coin counters follow pickups instead of being polled every frame
+	GetSubsystem<GameEventHub>()->pickup_.Subscribe<AutoRunner, &AutoRunner::OnPickup>(this);
+	GetSubsystem<GameEventHub>()->death_.Subscribe<AutoRunner, &AutoRunner::OnDeath>(this);
 
 	// Subscribe HandleUpdate() function for processing update events
 	SubscribeToEvent(E_UPDATE, HANDLER(AutoRunner, HandleUpdate));
@@ -319,6 +410,12 @@ void AutoRunner::SubscribeToEvents()
 	// Subscribe HandlePostRenderUpdate() function for processing the post-render update event, during which we request debug geometry
 	SubscribeToEvent(E_POSTRENDERUPDATE, HANDLER(AutoRunner, HandlePostRenderUpdate));
 
+	// Subscribe to focus changes to snapshot the run when backgrounded
+	SubscribeToEvent(E_INPUTFOCUS, HANDLER(AutoRunner, HandleInputFocus));
+
+	// Subscribe to console commands for live tuning
+	SubscribeToEvent(E_CONSOLECOMMAND, HANDLER(AutoRunner, HandleConsoleCommand));
+
 	if (touch_->touchEnabled_)
 		touch_->SubscribeToTouchEvents();
 }
@@ -326,34 +423,75 @@ void AutoRunner::SubscribeToEvents()
 void AutoRunner::HandleFixedUpdate(StringHash eventType, VariantMap& eventData)
 {
 	using namespace PhysicsPreStep;
+	AllocationScope allocationScope;
+
+	float timeStep = eventData[P_TIMESTEP].GetFloat();
+
+	if (character_ && !character_->IsDead())
+	{
+		// Recognized swipes are applied at the physics step following the touch sample, not at the next render frame.
+		if (touch_->touchEnabled_)
+			character_->QueueActions(touch_->ApplyInput());
 
+		// The level streams and the character steers once per physics step, as the race server replays them
+		HiresTimer streamTimer;
+		if (level_->Update())
+		{
+			UpdateDebugPath();
+			UpdateDebugBlocks();
+			perfOverlay_->AddTime(PERF_STREAMING, streamTimer.GetUSec(false));
+		}
+	}
+
+	bool alive = character_ && !character_->IsDead();
+	StepEvent step;
+	step.timeStep_ = timeStep;
+	GetSubsystem<GameEventHub>()->fixedStep_.Send(step);
+
+	// Only the step's input and an occasional keyframe leave the machine. The step the character dies in is recorded too, so
+	// that the race server simulates the same end of the run
+	if (alive)
+	{
+		GhostRace* ghostRace = GetSubsystem<GhostRace>();
+		Node* characterNode = character_->GetNode();
+		ghostRace->RecordStep(PackGhostInput(character_->controls_.buttons_, character_->GetStepActions()),
+			characterNode->GetWorldPosition(), characterNode->GetWorldRotation().YawAngle(), character_->GetSim().GetChecksum());
+		if (character_->IsDead())
+			ghostRace->EndRun(character_->GetScore());
+	}
+}
+
+void AutoRunner::OnDeath(const DeathEvent& event)
+{
+	// Only queued here, the leaderboard posts it from later frames and the file is written at the next start
+	RunResult result;
+	result.score_ = event.score_;
+	result.distance_ = (int)character_->GetDistance();
+	result.coins_ = character_->GetNumCoins();
+	newHighScore_ = leaderboard_->Submit(result);
+	snapshot_->DiscardAsync(GetSnapshotFileName());
+}
+
+void AutoRunner::OnPickup(const PickupEvent& event)
+{
+	scoreCounter_.SetValue(event.score_);
+	coinsCounter_.SetValue(character_->GetNumCoins());
 }
 
 void AutoRunner::HandleUpdate(StringHash eventType, VariantMap& eventData)
 {
 	using namespace Update;
+	AllocationScope allocationScope;
 
 	UI* ui = GetSubsystem<UI>();
 	Input* input = GetSubsystem<Input>();
 	ResourceCache* cache = GetSubsystem<ResourceCache>();
-	float timeStep = eventData[P_TIMESTEP].GetFloat();
 
 	if (useMouseMove_)
 		ui->GetCursor()->SetVisible(!input->GetMouseButtonDown(MOUSEB_RIGHT));
 
 	if (character_ && !character_->IsDead())
 	{
-		// Update path.
-		Vector3 point;
-		if (character_->GetNumPoints() <= 3/* && character_->HasTurnRequest()*/) {
-			UpdatePath(false);
-			character_->RemovePassedBlocks();
-
-			if (blocks_.Size() <= 0)
-				CreateLevel();
-		}
-
-		character_->FollowPath(timeStep);
 		// Clear previous controls
 		character_->controls_.Set(CTRL_FORWARD | CTRL_LEFT | CTRL_RIGHT | CTRL_BACK | CTRL_JUMP, false);
 
@@ -376,6 +514,26 @@ void AutoRunner::HandleUpdate(StringHash eventType, VariantMap& eventData)
 				character_->controls_.Set(CTRL_BACK, input->GetKeyDown('S'));
 				character_->controls_.Set(CTRL_JUMP, input->GetKeyDown('W'));
 
+				// Key presses are latched as actions, so a press shorter than a physics step is not lost
+				// and a press spanning several steps is not applied twice.
+				int actions = 0;
+				if (input->GetKeyPress('A'))
+					actions |= CTRL_LEFT;
+				if (input->GetKeyPress('D'))
+					actions |= CTRL_RIGHT;
+				if (input->GetKeyPress('S'))
+					actions |= CTRL_BACK;
+				if (input->GetKeyPress('W'))
+					actions |= CTRL_JUMP;
+				character_->QueueActions(actions);
+
+				LatencyTracer* tracer = GetSubsystem<LatencyTracer>();
+				for (int control = CTRL_BACK; control <= CTRL_JUMP; control <<= 1)
+				{
+					if (actions & control)
+						tracer->Mark(control, LATENCY_CONTROLS);
+				}
+
 				if (useMouseMove_)
 				{
 					// Add character yaw & pitch from the mouse motion
@@ -394,7 +552,17 @@ void AutoRunner::HandleUpdate(StringHash eventType, VariantMap& eventData)
 
 	// Toggle debug geometry with space
 	if (input->GetKeyPress(KEY_F3))
+	{
 		drawDebug_ = !drawDebug_;
+		// Hidden sets are not kept up to date, so build them now
+		debugLayer_->SetVisible(drawDebug_);
+		UpdateDebugPath();
+		UpdateDebugBlocks();
+	}
+
+	// Toggle performance overlay
+	if (input->GetKeyPress(KEY_F5))
+		perfOverlay_->Toggle();
 
 	// Toggle fill mode on main camera
 	if (input->GetKeyPress(KEY_F4))
@@ -421,60 +589,77 @@ void AutoRunner::HandleUpdate(StringHash eventType, VariantMap& eventData)
 
 void AutoRunner::HandlePostUpdate(StringHash eventType, VariantMap& eventData)
 {
-	if (!character_)
-		return;
+	AllocationScope allocationScope;
+	frameTimeStep_ = eventData[PostUpdate::P_TIMESTEP].GetFloat();
 
-	if (character_->IsDead())
+	// Average the frame rate over half a second so the counter does not change every frame
+	fpsFrames_++;
+	fpsTime_ += frameTimeStep_;
+	if (fpsTime_ >= 0.5f)
 	{
-		if (!isPlaying_)
-			return;
-
-		static int highScore = 0;
-
-		if (!touch_->touchEnabled_)
-			GetSubsystem<UI>()->GetCursor()->SetVisible(true);
-
-		String elementName = "InfoText";
-		Text* infoText = static_cast<Text*>(gameMenu_->GetChild(elementName));
-		infoText->SetText("You Dead!, Restart or Exit..");
-		infoText->SetPosition(60, infoText->GetPosition().y_);
-		elementName = "LastScoreText";
-		Text* lastScoreText = static_cast<Text*>(gameMenu_->GetChild(elementName));
-		lastScoreText->SetVisible(true);
-		lastScoreText->SetText("Score: " + String(character_->GetScore()));
-
-		elementName = "HighScoreText";
-		Text* highScoreText = static_cast<Text*>(gameMenu_->GetChild(elementName));
-		if (highScore < character_->GetScore())
-		{
-			highScore = character_->GetScore();
-			highScoreText->GetChild(0)->SetVisible(true);
-		}
-		else
-		{
-			highScoreText->GetChild(0)->SetVisible(false);
-		}
-
-		highScoreText->SetVisible(true);
-		highScoreText->SetText("High Score: " + String(highScore));
-
-		elementName = "PlayBtn";
-		Button* playBtn = static_cast<Button*>(gameMenu_->GetChild(elementName));
-		Text* playText = static_cast<Text*>(playBtn->GetChild(0));
-		playText->SetText("RESTART!");
-
-		gameMenu_->SetEnabled(true);
-		gameMenu_->SetVisible(true);
-		gameMenu_->SetFocus(true);
-		isPlaying_ = false;
-		numBlocks_ = 0;
+		hudFps_ = (int)(fpsFrames_ / fpsTime_ + 0.5f);
+		fpsFrames_ = 0;
+		fpsTime_ = 0.0f;
+	}
 
+	// Distance text is only formatted and laid out when the value changes, score and coins follow pickups
+	bool running = character_ && !character_->IsDead();
+	if (running)
+		hudDistance_ = (int)character_->GetDistance();
+	// Formatting two counters costs less than handing it to a worker thread
+	FormatHud();
+
+	// Rivals keep running past a dead player until the next run
+	unsigned numRivals = rivals_->BeginUpdate(frameTimeStep_) ? rivals_->GetNumRivals() : 0;
+	frameJobs_->SetSize(rivalJob_, numRivals);
+	frameJobs_->SetSize(rivalNodesJob_, numRivals);
+	frameJobs_->SetSize(cameraJob_, running ? 1 : 0);
+	frameJobs_->Run();
+	perfOverlay_->AddTime(PERF_RIVALS, frameJobs_->GetJobTime(rivalJob_) + frameJobs_->GetJobTime(rivalNodesJob_));
+	perfOverlay_->AddTime(PERF_JOBS, frameJobs_->GetRunTime());
+
+	// Show the result menu once when the character dies
+	if (!character_ || !character_->IsDead() || !isPlaying_)
 		return;
-	}
 
-	// Update score
-	scoreText_->SetText("Score " + String(character_->GetScore()));
+	if (!touch_->touchEnabled_)
+		GetSubsystem<UI>()->GetCursor()->SetVisible(true);
+
+	// Elements were resolved when the menu was created, only the texts change here
+	int score = character_->GetScore();
+	infoText_->SetText("You Dead!, Restart or Exit..");
+	infoText_->SetPosition(60, infoText_->GetPosition().y_);
+	lastScoreText_->SetVisible(true);
+	lastScoreText_->SetText("Score: " + String(score));
+
+	newHighScoreMark_->SetVisible(newHighScore_);
+
+	String highScoreText = "High Score: " + String(leaderboard_->GetHighScore());
+	if (leaderboard_->GetServerBest() >= 0)
+		highScoreText += " (Best: " + String(leaderboard_->GetServerBest()) + ")";
+	highScoreText_->SetVisible(true);
+	highScoreText_->SetText(highScoreText);
+	playText_->SetText("RESTART!");
+
+	gameMenu_->SetEnabled(true);
+	gameMenu_->SetVisible(true);
+	gameMenu_->SetFocus(true);
+	isPlaying_ = false;
+}
 
+void AutoRunner::CreateFrameJobs()
+{
+	// Worker jobs touch only their own data, main thread jobs the scene and UI. The camera's sphere cast and the HUD texts
+	// overlap the rival simulation, the rival nodes are written once it is done
+	rivalJob_ = frameJobs_->AddJob<RivalCrowd, &RivalCrowd::Simulate>("Rival simulation", rivals_, false, RIVAL_CHUNK_SIZE);
+	cameraJob_ = frameJobs_->AddJob<AutoRunner, &AutoRunner::UpdateCamera>("Camera", this, true);
+	rivalNodesJob_ = frameJobs_->AddJob<RivalCrowd, &RivalCrowd::ApplyNodes>("Rival nodes", rivals_, true);
+	frameJobs_->AddDependency(rivalNodesJob_, rivalJob_);
+	frameJobs_->AddJob<AutoRunner, &AutoRunner::ApplyHud>("HUD text", this, true);
+}
+
+void AutoRunner::UpdateCamera(unsigned first, unsigned last)
+{
 	Node* characterNode = character_->GetNode();
 	// Get camera lookat dir from character yaw + pitch
 	float yawAngle = 0;
@@ -503,20 +688,27 @@ void AutoRunner::HandlePostUpdate(StringHash eventType, VariantMap& eventData)
 		// Third person camera: position behind the character
 		Vector3 aimPoint = characterNode->GetPosition() + rot * Vector3(0.0f, 2.3f, -1.5f);
 
-		// Collide camera ray with static physics objects (layer bitmask 2) to ensure we see the character properly
+		// Keep the camera clear of static geometry. The rig reuses its last sphere cast while the view barely moves
 		Vector3 rayDir = dir * Vector3::BACK;
-		float rayDistance = touch_->cameraDistance_;
-		PhysicsRaycastResult result;
-		scene_->GetComponent<PhysicsWorld>()->RaycastSingle(result, Ray(aimPoint, rayDir), rayDistance, 2);
-		if (result.body_)
-			rayDistance = Min(rayDistance, result.distance_);
-		rayDistance = Clamp(rayDistance, CAMERA_MIN_DIST, CAMERA_MAX_DIST);
+		float rayDistance = cameraRig_->Update(aimPoint, rayDir, touch_->cameraDistance_, frameTimeStep_);
 
 		cameraNode_->SetPosition(aimPoint + rayDir * rayDistance);
 		cameraNode_->SetRotation(dir);
 	}
 }
 
+void AutoRunner::FormatHud()
+{
+	distanceCounter_.Format(hudDistance_);
+	fpsCounter_.Format(hudFps_);
+}
+
+void AutoRunner::ApplyHud(unsigned first, unsigned last)
+{
+	distanceCounter_.Apply();
+	fpsCounter_.Apply();
+}
+
 void AutoRunner::HandlePostRenderUpdate(StringHash eventType, VariantMap& eventData)
 {
 	// If draw debug mode is enabled, draw viewport debug geometry. Disable depth test so that we can see the effect of occlusion
@@ -525,18 +717,56 @@ void AutoRunner::HandlePostRenderUpdate(StringHash eventType, VariantMap& eventD
 		GetSubsystem<Renderer>()->DrawDebugGeometry(false);
 		scene_->GetComponent<PhysicsWorld>()->DrawDebugGeometry(true);
 	}
+}
 
-	DebugRenderer* debug = scene_->GetComponent<DebugRenderer>();
-	for (unsigned int i = 0; i < lines_.Size(); i++)
+void AutoRunner::UpdateDebugPath()
+{
+	if (!debugLayer_->IsVisible() || !character_)
+		return;
+
+	// The lanes of the track from the character's block on. Side lanes are offset from the center path like the simulation
+	// does, and only live until they are drawn
+	Arena& arena = GetSubsystem<GameMemory>()->GetFrameArena();
+	float laneWidth = SIM_LANE_WIDTH.ToFloat();
+	unsigned first = Max((int)character_->GetSim().GetNumBlocks() - 1, 0);
+	debugLayer_->BeginSet("Path");
+	for (unsigned i = first; i < level_->GetTrackSize(); ++i)
 	{
-		DebugLine line = lines_[i];
-		debug->AddLine(line.start_, line.end_, line.color_);
+		const PODVector<Vector3>& points = level_->GetTrackBlock(i).points_;
+		for (int lane = -1; lane <= 1; ++lane)
+		{
+			ArenaArray<Vector3> lanePoints(arena);
+			for (unsigned j = 0; j < points.Size(); ++j)
+			{
+				Vector3 segment = points[j + 1 < points.Size() ? j + 1 : j] - points[j ? j - 1 : 0];
+				segment.y_ = 0.0f;
+				lanePoints.Push(points[j] + Vector3::UP.CrossProduct(segment.Normalized()) * (lane * laneWidth));
+			}
+			debugLayer_->AddPolyline(lanePoints.GetData(), lanePoints.Size(), lane ? Color::CYAN : Color::YELLOW);
+		}
 	}
+	debugLayer_->EndSet();
+}
 
-	for (unsigned int i = 0; i < spheres_.Size(); i++)
+void AutoRunner::UpdateDebugBlocks()
+{
+	if (!debugLayer_->IsVisible())
+		return;
+
+	const PODVector<Node*>& blocks = level_->GetPool()->GetActiveBlocks();
+	PODVector<StaticModel*> models;
+	debugLayer_->BeginSet("Blocks");
+	for (PODVector<Node*>::ConstIterator i = blocks.Begin(); i != blocks.End(); ++i)
 	{
-		debug->AddSphere(spheres_[i], Color::RED);
+		BoundingBox footprint;
+		(*i)->GetComponents<StaticModel>(models, true);
+		for (PODVector<StaticModel*>::ConstIterator j = models.Begin(); j != models.End(); ++j)
+			footprint.Merge((*j)->GetWorldBoundingBox());
+
+		if (footprint.defined_)
+			debugLayer_->AddBoundingBox(footprint, Color::GREEN);
 	}
+	debugLayer_->EndSet();
 }
 
 void AutoRunner::HandleControlClicked(StringHash eventType, VariantMap& eventData)
@@ -554,9 +784,6 @@ void AutoRunner::HandleControlClicked(StringHash eventType, VariantMap& eventDat
 			gameMenu_->SetFocus(false);
 			loadingText_->SetVisible(true);
 
-			if (character_ && character_->IsDead())
-				ResetGame();
-
 			InitGame();
 			if (!touch_->touchEnabled_)
 				GetSubsystem<UI>()->GetCursor()->SetVisible(false);
@@ -570,243 +797,294 @@ void AutoRunner::HandleControlClicked(StringHash eventType, VariantMap& eventDat
 	}
 }
 
-void AutoRunner::CreateLevel()
+void AutoRunner::HandleInputFocus(StringHash eventType, VariantMap& eventData)
 {
-	int cnt = 3;
-	int maxRecursive = 30;
-	int maxBlockNumber = blockNames_.Size();
-	ResourceCache* cache = GetSubsystem<ResourceCache>();
+	using namespace InputFocus;
 
-	while (cnt > 0)
-	{
-		Vector3 blockPos = lastOutWorldPosition_;
-		Quaternion blockRot = lastOutWorldRotation_;
+	if (!eventData[P_FOCUS].GetBool())
+		SaveSnapshot();
+}
 
-		// Initial transform has been given from out node.
-		unsigned int rnd = static_cast<unsigned int>(Random(maxBlockNumber));
-		// Set the starting platform.
-		if (numBlocks_ == 0)
-			rnd = 0;
+void AutoRunner::SaveSnapshot()
+{
+	if (!character_ || character_->IsDead() || !isPlaying_)
+		return;
 
-		String prefabName = blockNames_[rnd];
-		SharedPtr<File> fBlock1 = cache->GetFile(prefabName);
-		Node* blockNode = scene_->InstantiateXML(*fBlock1, Vector3::ZERO, blockRot);
-		int outs = blockNode->GetVar(GameVariants::P_OUT).GetInt();
+	HiresTimer snapshotTimer;
+	snapshot_->Capture(level_, character_);
+	snapshot_->SaveAsync(GetSnapshotFileName());
+	DebugHud* debugHud = GetSubsystem<DebugHud>();
+	if (debugHud)
+		debugHud->SetAppStats("Snapshot", ToString("%u bytes, %.2f ms", snapshot_->GetSize(),
+			snapshotTimer.GetUSec(false) * 0.001f));
+}
 
-		// And, then set actual transform of this block to get offset In node.
-		Node* inNode = blockNode->GetChild("In");
-		inNode->SetWorldPosition(blockPos);
-		inNode->SetWorldRotation(lastOutWorldRotation_);
-		//Vector3 offset = inNode->GetPosition();//inNode->GetVar(GameVarirants::P_OFFSET).GetVector3();
-		//Vector3 trans = inNode->GetWorldRotation() * offset;
-		//blockNode->Translate(-trans/*trans*/);
+bool AutoRunner::ResumeRun()
+{
+	HiresTimer resumeTimer;
 
-		if (numBlocks_ == 0)
-		{
-			Vector3 pos = inNode->GetWorldPosition();
-			character_->GetNode()->SetWorldPosition(Vector3(pos.x_, 10.0f, pos.z_));
-		}
+	if (!character_)
+	{
+		character_ = level_->CreateCharacter();
+		characterHead_ = character_->GetNode()->GetChild(NODE_PLAYER_HEAD.GetHash(), true);
+	}
+	else
+	{
+		RestartGame();
+	}
 
-		// Check obstacles before creating coins to prevent cycling path.
-		String posix = String::EMPTY;
-		int twoWay = 1;
-		// If the path is two way turned.
-		if (outs >= 2)
-		{
-			posix = "R";
-			twoWay++;
-		}
+	yaw_ = pitch_ = 0.0f;
+	cameraRig_->Reset();
 
-		bool accepted = true;
-		Node* outNode = inNode->GetChild("Out" + posix);
+	if (!snapshot_->Restore(level_, character_))
+	{
+		LOGWARNING("Could not restore the run snapshot");
+		snapshot_->DiscardAsync(GetSnapshotFileName());
+		return false;
+	}
 
-		while (twoWay > 0)
-		{
-			Vector3 outDir = outNode->GetWorldRotation() * Vector3::LEFT;
-			Vector3 origin = outNode->GetWorldPosition();
-			Ray ray(origin, outDir);
-			PhysicsRaycastResult result;
+	scoreCounter_.SetValue(character_->GetScore());
+	distanceCounter_.SetValue((int)character_->GetDistance());
+	coinsCounter_.SetValue(character_->GetNumCoins());
+	isPlaying_ = true;
 
-			PhysicsWorld* world = scene_->GetComponent<PhysicsWorld>();
-			world->RaycastSingle(result, ray, 20.0f, FLOOR_COLLISION_MASK);
+	gameMenu_->SetVisible(false);
+	gameMenu_->SetEnabled(false);
+	gameMenu_->SetFocus(false);
+	if (!touch_->touchEnabled_)
+		GetSubsystem<UI>()->GetCursor()->SetVisible(false);
+
+	UpdateDebugPath();
+	UpdateDebugBlocks();
+	DebugHud* debugHud = GetSubsystem<DebugHud>();
+	if (debugHud)
+		debugHud->SetAppStats("Resume", ToString("%.2f ms", resumeTimer.GetUSec(false) * 0.001f));
+	return true;
+}
 
-			if (result.body_)
-			{
-				if (maxRecursive == 0)
-					assert(false);
+String AutoRunner::GetUserDataDir() const
+{
+	// The program directory is the read-only package or bundle on Android and iOS
+	FileSystem* fs = GetSubsystem<FileSystem>();
+	String dir = fs->GetUserDocumentsDir() + "AutoRunner/";
+	if (!fs->DirExists(dir))
+		fs->CreateDir(dir);
+	return dir;
+}
 
-				blockNode->Remove();
-				maxRecursive--;
-				accepted = false;
-				break;
-			}
-			else
-			{
-				maxRecursive = 30;
-			}
+String AutoRunner::GetSnapshotFileName() const
+{
+	return GetUserDataDir() + "RunSnapshot.bin";
+}
 
-			// We tried first way as an Right posix, then will be trying other way as a Left posix.
-			if (outs >= 2)
-				posix = "L";
+void AutoRunner::HandleConsoleCommand(StringHash eventType, VariantMap& eventData)
+{
+	using namespace ConsoleCommand;
 
-			twoWay--;
-		}
+	Vector<String> args = eventData[P_COMMAND].GetString().Trimmed().Split(' ');
+	if (args.Empty())
+		return;
 
-		// If this created is not accepted then continue.
-		if (!accepted)
-			continue;
+	String command = args[0].ToLower();
+	bool hasValue = args.Size() > 1;
+	const String& value = hasValue ? args[1] : String::EMPTY;
+	Renderer* renderer = GetSubsystem<Renderer>();
+	Camera* camera = cameraNode_->GetComponent<Camera>();
 
-		// Choose group randomly.
-		Node* groups = blockNode->GetChild("Groups", true);
-		int numChildren = groups->GetNumChildren();
-		rnd = static_cast<unsigned int>(Random(numChildren));
-		for (unsigned int i = 0; i < groups->GetNumChildren(); i++)
+	if (command == "help")
+	{
+		LOGRAW("lookahead [blocks]       Blocks generated ahead of the character\n");
+		LOGRAW("levelscript [file|off]   Script choosing the blocks, .as or .lua\n");
+		LOGRAW("rivals [count]           AI rivals running the track\n");
+		LOGRAW("jobs [on|off]            Run frame jobs on worker threads, print their times\n");
+		LOGRAW("physicsfps [fps]         Physics steps per second\n");
+		LOGRAW("shadows [on|off]         Shadow rendering\n");
+		LOGRAW("shadowmap [size]         Shadow map resolution\n");
+		LOGRAW("shadowquality [0-3]      Shadow depth and filtering quality\n");
+		LOGRAW("lodbias [bias]           Camera LOD bias\n");
+		LOGRAW("occlusion [triangles]    Max occluder triangles, 0 disables occlusion\n");
+		LOGRAW("farclip [distance]       Camera far clip distance\n");
+		LOGRAW("pooling [on|off]         Reuse passed blocks instead of instantiating new ones\n");
+		LOGRAW("profile start|stop       Capture profiler data and write it to a file\n");
+		LOGRAW("counts                   Print live block, node and resource counts\n");
+		LOGRAW("snapshot save|load       Snapshot the run in progress, or resume the saved one\n");
+		LOGRAW("startup                  Print the cold start timeline\n");
+	}
+	else if (command == "lookahead")
+	{
+		if (hasValue)
+			level_->SetLookahead(ToInt(value));
+		LOGINFO("Lookahead " + String(level_->GetLookahead()) + " blocks");
+	}
+	else if (command == "levelscript")
+	{
+		if (value == "off")
+			levelScript_->Clear();
+		else if (hasValue)
+			levelScript_->Load(value);
+		if (levelScript_->IsLoaded())
 		{
-			Node* groupNode = groups->GetChild(i);
-			if (i == rnd)
-			{
-				for (unsigned int itemIndex = 0; itemIndex < groupNode->GetNumChildren(); itemIndex++)
-				{
-					Node* itemNode = groupNode->GetChild(itemIndex);
-					bool isAnimated = itemNode->GetVar(GameVariants::P_ISANIMATED).GetBool();
-					if (isAnimated)
-					{
-						AnimationController* aCtrl = itemNode->CreateComponent<AnimationController>();
-						aCtrl->Play("AnimStackTake 001.ani", 0, true, 0.2f);
-					}
-				}
-
-				continue;
-			}
-
-			groupNode->SetEnabled(false, true);
+			unsigned numCalls = levelScript_->GetNumCalls();
+			LOGINFO(ToString("Level script %s, %u batches, %.3f ms per batch, %.2f%% of the time", levelScript_->GetFileName().CString(),
+				numCalls, numCalls ? levelScript_->GetCallTime() * 0.001f / numCalls : 0.0f, levelScript_->GetTimeShare() * 100.0f));
 		}
-
-		cnt--;
-		numBlocks_++;
-		blocks_.Push(blockNode);
-
-		// If the last block is the straight then,
-		// Go ahead creating the block until the last block is turned one.
-		if (cnt == 0 && outs == 0)
+		else
+			LOGINFO("Level script off");
+	}
+	else if (command == "rivals")
+	{
+		if (hasValue)
 		{
-			// TODO: You should check the length of straight path.
-			//cnt++;
+			numRivals_ = ToUInt(value);
+			rivals_->SetNumRivals(numRivals_);
 		}
-
-		// If the block is the last one that has two way turned, then set the cnt is zero.
-		if (outs >= 2)
-			cnt = 0;
-
-		lastOutWorldPosition_ = outNode->GetWorldPosition();
-		lastOutWorldRotation_ = outNode->GetWorldRotation();
+		LOGINFO(ToString("%u rivals, update %.2f ms", rivals_->GetNumRivals(),
+			(frameJobs_->GetJobTime(rivalJob_) + frameJobs_->GetJobTime(rivalNodesJob_)) * 0.001f));
 	}
-
-	UpdatePath();
-}
-
-void AutoRunner::UpdatePath(bool startIn)
-{
-	List<Vector3> leftPoints;
-	List<Vector3> rightPoints;
-	List<Vector3> centerPoints;
-
-	while (blocks_.Size() > 0)
+	else if (command == "jobs")
 	{
-		Node* block = blocks_.Front();
-		int outs = block->GetVar(GameVariants::P_OUT).GetInt();
-
-		Node* paths = block->GetChild("Paths", true);
-		String posix = (startIn || outs == 0) ? "In" : "Out";
-		// Check the block whether it has two way outs or not, 
-		// then add the "L" or "R" to the posix.
-		if (outs >= 2 && !startIn)
+		if (hasValue)
+			frameJobs_->SetParallel(value == "on" || ToBool(value));
+		for (unsigned i = 0; i < frameJobs_->GetNumJobs(); ++i)
+			LOGRAW(ToString("%-20s %.3f ms\n", frameJobs_->GetJobName(i).CString(), frameJobs_->GetJobTime(i) * 0.001f));
+		LOGINFO(ToString("Frame jobs %s on %u worker threads, main thread %.3f ms", frameJobs_->IsParallel() ? "parallel" : "serial",
+			GetSubsystem<WorkQueue>()->GetNumThreads(), frameJobs_->GetRunTime() * 0.001f));
+	}
+	else if (command == "physicsfps")
+	{
+		PhysicsWorld* world = scene_->GetComponent<PhysicsWorld>();
+		if (hasValue)
+			world->SetFps(ToInt(value));
+		LOGINFO("Physics " + String(world->GetFps()) + " fps");
+	}
+	else if (command == "shadows")
+	{
+		if (hasValue)
+			renderer->SetDrawShadows(value == "on" || ToBool(value));
+		LOGINFO("Shadows " + String(renderer->GetDrawShadows() ? "on" : "off"));
+	}
+	else if (command == "shadowmap")
+	{
+		if (hasValue)
+			renderer->SetShadowMapSize(ToInt(value));
+		LOGINFO("Shadow map size " + String(renderer->GetShadowMapSize()));
+	}
+	else if (command == "shadowquality")
+	{
+		if (hasValue)
+			renderer->SetShadowQuality(Clamp(ToInt(value), (int)SHADOWQUALITY_LOW_16BIT, (int)SHADOWQUALITY_HIGH_24BIT));
+		LOGINFO("Shadow quality " + String(renderer->GetShadowQuality()));
+	}
+	else if (command == "lodbias")
+	{
+		if (hasValue)
+			camera->SetLodBias(ToFloat(value));
+		LOGINFO("LOD bias " + String(camera->GetLodBias()));
+	}
+	else if (command == "occlusion")
+	{
+		if (hasValue)
+			renderer->SetMaxOccluderTriangles(Max(ToInt(value), 0));
+		LOGINFO("Max occluder triangles " + String(renderer->GetMaxOccluderTriangles()));
+	}
+	else if (command == "farclip")
+	{
+		if (hasValue)
+			camera->SetFarClip(ToFloat(value));
+		LOGINFO("Far clip " + String(camera->GetFarClip()));
+	}
+	else if (command == "pooling")
+	{
+		BlockPool* pool = level_->GetPool();
+		if (hasValue)
+			pool->SetEnabled(value == "on" || ToBool(value));
+		LOGINFO("Pooling " + String(pool->IsEnabled() ? "on" : "off"));
+	}
+	else if (command == "profile")
+	{
+		Profiler* profiler = GetSubsystem<Profiler>();
+		DebugHud* debugHud = GetSubsystem<DebugHud>();
+		if (!profiler)
 		{
-			TurnState lastState = character_->GetTurnState();
-			if (lastState == NO_SUCCEEDED)
-				return;
-
-			if (lastState == LEFT_SUCCEEDED)
-			{
-				posix += "L";
-			}
-			else
+			LOGERROR("Profiler not available");
+		}
+		else if (value == "start")
+		{
+			// The debug HUD restarts the profiler interval periodically, hold it off for the capture
+			if (debugHud)
 			{
-				posix += "R";
+				profilerInterval_ = debugHud->GetProfilerInterval();
+				debugHud->SetProfilerInterval(M_LARGE_VALUE);
 			}
-
-			// Set the last out world transform.
-			Node* outNode = block->GetChild(posix);
-			lastOutWorldPosition_ = outNode->GetWorldPosition();
-			lastOutWorldRotation_ = outNode->GetWorldRotation();
+			profiler->BeginInterval();
+			profiling_ = true;
+			LOGINFO("Profiler capture started");
 		}
-
-		Node* path = paths->GetChild("Center" + posix);
-		unsigned int numChildren = path->GetNumChildren();
-
-		for (unsigned int i = 0; i < numChildren; i++)
+		else if (value == "stop" && profiling_)
 		{
-			Node* pointNode = path->GetChild(i);
-			centerPoints.Push(pointNode->GetWorldPosition());
-			// Create a box-model component to see each path point.
-			/*StaticModel* boxObject = pointNode->CreateComponent<StaticModel>();
-			boxObject->SetModel(GetSubsystem<ResourceCache>()->GetResource<Model>("Models/Box.mdl"));
-			boxObject->SetMaterial(GetSubsystem<ResourceCache>()->GetResource<Material>("Materials/Stone.xml"));
-			pointNode->SetScale(Vector3(0.1f, 0.1f, 0.1f));*/
+			String fileName = GetSubsystem<FileSystem>()->GetProgramDir() + "Profile_" +
+				Time::GetTimeStamp().Replaced(':', '_').Replaced('.', '_').Replaced(' ', '_') + ".txt";
+			File file(context_, fileName, FILE_WRITE);
+			file.WriteString(profiler->GetData(false, false));
+			if (debugHud)
+				debugHud->SetProfilerInterval(profilerInterval_);
+			profiling_ = false;
+			LOGINFO("Profiler capture saved to " + fileName);
 		}
-
-		path = paths->GetChild("Left" + posix);
-		numChildren = path->GetNumChildren();
-
-		for (unsigned int i = 0; i < numChildren; i++)
+		else
 		{
-			Node* pointNode = path->GetChild(i);
-			leftPoints.Push(pointNode->GetWorldPosition());
-			// Create a box-model component to see each path point.
-			/*StaticModel* boxObject = pointNode->CreateComponent<StaticModel>();
-			boxObject->SetModel(GetSubsystem<ResourceCache>()->GetResource<Model>("Models/Box.mdl"));
-			boxObject->SetMaterial(GetSubsystem<ResourceCache>()->GetResource<Material>("Materials/Stone.xml"));
-			pointNode->SetScale(Vector3(0.1f, 0.1f, 0.1f));*/
+			LOGINFO("Profiler capture " + String(profiling_ ? "running" : "stopped"));
 		}
-
-		path = paths->GetChild("Right" + posix);
-		numChildren = path->GetNumChildren();
-
-		for (unsigned int i = 0; i < numChildren; i++)
+	}
+	else if (command == "snapshot")
+	{
+		if (value == "save")
+			SaveSnapshot();
+		else if (value == "load" && snapshot_->Load(GetSnapshotFileName()))
+			ResumeRun();
+		LOGINFO("Snapshot " + String(snapshot_->GetSize()) + " bytes");
+	}
+	else if (command == "startup")
+	{
+		GetSubsystem<StartupTimeline>()->Log();
+	}
+	else if (command == "counts")
+	{
+		BlockPool* pool = level_->GetPool();
+		LOGINFO("Blocks: " + String(pool->GetNumActive()) + " active, " + String(pool->GetNumPooled()) + " pooled, " +
+			String(pool->GetNumInstantiated()) + " instantiated in " + String(pool->GetInstantiateTime() / 1000) + " ms, " +
+			String(pool->GetNumReused()) + " reused, " + String(level_->GetNumBranchBlocks()) + " prepared past the junction");
+		PODVector<RigidBody*> bodies;
+		scene_->GetComponents(bodies, true);
+		unsigned numActiveBodies = 0;
+		for (PODVector<RigidBody*>::ConstIterator i = bodies.Begin(); i != bodies.End(); ++i)
 		{
-			Node* pointNode = path->GetChild(i);
-			rightPoints.Push(pointNode->GetWorldPosition());
-			// Create a box-model component to see each path point.
-			/*StaticModel* boxObject = pointNode->CreateComponent<StaticModel>();
-			boxObject->SetModel(GetSubsystem<ResourceCache>()->GetResource<Model>("Models/Box.mdl"));
-			boxObject->SetMaterial(GetSubsystem<ResourceCache>()->GetResource<Material>("Materials/Stone.xml"));
-			pointNode->SetScale(Vector3(0.1f, 0.1f, 0.1f));*/
+			if ((*i)->IsEnabledEffective())
+				++numActiveBodies;
 		}
-
-		if (outs > 0)
+		LOGINFO("Bodies: " + String(numActiveBodies) + " in broadphase, " + String(bodies.Size()) + " in scene, " +
+			String(pool->GetNumMergedBodies()) + " floor bodies merged into " + String(pool->GetNumStaticBodies()));
+		LogComponentPools();
+		LOGINFO("Nodes: " + String(scene_->GetNumChildren(true)) + " in scene");
+
+		ResourceCache* cache = GetSubsystem<ResourceCache>();
+		const HashMap<ShortStringHash, ResourceGroup>& groups = cache->GetAllResources();
+		for (HashMap<ShortStringHash, ResourceGroup>::ConstIterator i = groups.Begin(); i != groups.End(); ++i)
 		{
-			if (!startIn)
-				startIn = true;
-			else
-				break;
+			if (i->second_.resources_.Empty())
+				continue;
+			LOGINFO(context_->GetTypeName(i->first_) + ": " + String(i->second_.resources_.Size()) + " resources, " +
+				String(i->second_.memoryUse_ / 1024) + " kB");
 		}
-
-		blocks_.PopFront();
+		LOGINFO("Resources total " + String(cache->GetTotalMemoryUse() / 1024) + " kB");
+
+		GameMemory* memory = GetSubsystem<GameMemory>();
+		Arena& arena = memory->GetFrameArena();
+		LOGINFO("Game heap allocations: " + String(memory->GetFrameAllocations()) + " last frame, " +
+			String(memory->GetTotalAllocations()) + " total");
+		LOGINFO("Frame arena: " + String(arena.GetCapacity() / 1024) + " kB, peak " + String(arena.GetPeak()) + " bytes, " +
+			String(arena.GetNumHeapAllocations()) + " heap allocations");
 	}
-
-	character_->AddToPath(LEFT_SIDE, leftPoints);
-	character_->AddToPath(RIGHT_SIDE, rightPoints);
-	character_->AddToPath(CENTER_SIDE, centerPoints);
-}
-
-void AutoRunner::InitBlockParameters()
-{
-	blockNames_.Push("Objects/Block1.xml");
-	//blockNames_.Push("Objects/Block2.xml");
-	//blockNames_.Push("Objects/Block3.xml");
-	//blockNames_.Push("Objects/Block4.xml");
-	blockNames_.Push("Objects/Block5.xml");
-	blockNames_.Push("Objects/Block6.xml");
 }
 
 void AutoRunner::CreateUI()
@@ -829,6 +1107,8 @@ void AutoRunner::CreateUI()
 		cursor->SetPosition(graphics->GetWidth() / 2, graphics->GetHeight() / 2);
 	}
 
+	// Texts get their font faces here, so every size used by the menu is rasterized while loading
+	Font* font = cache->GetResource<Font>("Fonts/BlueHighway.ttf");
 	XMLFile* gameMenu = cache->GetResource<XMLFile>("UI/AutoRunnerGameMenu.xml");
 	if (gameMenu)
 	{
@@ -852,6 +1132,7 @@ void AutoRunner::CreateUI()
 			IntVector2 btnSize = IntVector2((int)(menuSize.x_ * 0.4f), (int)(menuSize.y_ * 0.3f));
 			Button* btn = static_cast<Button*>(gameMenu_->GetChild(btnName));
 			btn->SetSize(btnSize);
+			playText_ = static_cast<Text*>(btn->GetChild(0));
 			IntVector2 btnPos = IntVector2((int)(menuSize.x_ * 0.1f), (int)(menuSize.y_ * 0.05f));
 			btn->SetPosition(btnPos);
 			btnName = "ExitBtn";
@@ -864,28 +1145,32 @@ void AutoRunner::CreateUI()
 			// Set text's size and positions.
 			String txtName = "LastScoreText";
 			Text* txt = static_cast<Text*>(gameMenu_->GetChild(txtName));
+			lastScoreText_ = txt;
 			IntVector2 textSize = IntVector2((int)(menuSize.x_ * 0.5f), (int)(menuSize.y_ * 0.1f));
 			IntVector2 textPos = IntVector2((int)(menuSize.x_ * 0.05f), (int)(menuSize.y_ * 0.1f));
 			txt->SetSize(textSize);
 			txt->SetPosition(textPos);
-			txt->SetFont("Fonts/BlueHighway.ttf", (int)(textSize.y_ * 0.8f));
+			txt->SetFont(font, (int)(textSize.y_ * 0.8f));
 			txt->SetVisible(false);
 			txtName = "HighScoreText";
 			txt = static_cast<Text*>(gameMenu_->GetChild(txtName));
+			highScoreText_ = txt;
+			newHighScoreMark_ = txt->GetChild(0);
 			textSize = IntVector2((int)(menuSize.x_ * 0.5f), (int)(menuSize.y_ * 0.1f));
 			textPos = IntVector2((int)(menuSize.x_ * 0.05f), (int)(menuSize.y_ * 0.8f));
 			txt->SetSize(textSize);
 			txt->SetPosition(textPos);
-			txt->SetFont("Fonts/BlueHighway.ttf", (int)(textSize.y_ * 0.8f));
+			txt->SetFont(font, (int)(textSize.y_ * 0.8f));
 			txt->SetVisible(false);
 			txt->GetChild(0)->SetVisible(false);
 			txtName = "InfoText";
 			txt = static_cast<Text*>(gameMenu_->GetChild(txtName));
+			infoText_ = txt;
 			textSize = IntVector2((int)(menuSize.x_ * 0.5f), (int)(menuSize.y_ * 0.1f));
 			textPos = IntVector2((int)(menuSize.x_ * 0.1f), (int)(menuSize.y_ * 0.25f));
 			txt->SetSize(textSize);
 			txt->SetPosition(textPos);
-			txt->SetFont("Fonts/BlueHighway.ttf", (int)(textSize.y_ * 0.8f));
+			txt->SetFont(font, (int)(textSize.y_ * 0.8f));
 		}
 	}
 
@@ -895,20 +1180,48 @@ void AutoRunner::CreateUI()
 
 void AutoRunner::InitGame()
 {
-	// Create the controllable character
-	CreateCharacter();
+	HiresTimer restartTimer;
+
+	// The loading text is up, a good moment for the file write the death screen skipped
+	leaderboard_->Save();
+
+	// Create the controllable character, or reuse the one from the previous run together with its level blocks
+	if (!character_)
+	{
+		character_ = level_->CreateCharacter();
+		// Set the head of this character body.
+		characterHead_ = character_->GetNode()->GetChild(NODE_PLAYER_HEAD.GetHash(), true);
+	}
+	else
+	{
+		RestartGame();
+	}
 
 	// Set initial parameters
-	lastOutWorldPosition_ = Vector3(0.0f, 0.0f, -2.0f);
-	lastOutWorldRotation_ = Quaternion(90, Vector3(1, 0, 0));
 	yaw_ = pitch_ = 0.0f;
-	scoreText_->SetText("Score 0");
-
-	// Set random seed according to the system time
-	SetRandomSeed(Time::GetSystemTime());
+	scoreCounter_.SetValue(0);
+	distanceCounter_.SetValue(0);
+	coinsCounter_.SetValue(0);
+	cameraRig_->Reset();
+
+	// Seed the level from the system time, or from the session seed when racing so that all runners get the same level
+	GhostRace* ghostRace = GetSubsystem<GhostRace>();
+	level_->Start(character_, ghostRace->HasSeed() ? ghostRace->GetSeed() : Time::GetSystemTime());
+	UpdateDebugPath();
+	rivals_->SetLevel(scene_, level_, character_);
+	rivals_->SetNumRivals(numRivals_);
+	ghostRace->BeginRun();
+
+	DebugHud* debugHud = GetSubsystem<DebugHud>();
+	if (debugHud)
+		debugHud->SetAppStats("Game start", ToString("%.2f ms", restartTimer.GetUSec(false) * 0.001f));
+}
 
-	// Create level
-	CreateLevel();
+void AutoRunner::RestartGame()
+{
+	// The blocks go back to the pool and the character starts over when the level starts again
+	debugLayer_->Clear();
+	touch_->Reset();
 }
 
 void AutoRunner::ResetGame()
@@ -920,17 +1233,18 @@ void AutoRunner::ResetGame()
 	Node* characterNode = character_->GetNode();
 	characterNode->RemoveComponent(character_);
 	characterNode->Remove();
-	// Check the last time if we have any block in current scene.
-	PODVector<Node*> allChildren;
-	scene_->GetChildren(allChildren);
-	for (PODVector<Node*>::Iterator it = allChildren.Begin(); it != allChildren.End(); ++it)
+	rivals_->Clear();
+	// Drop pooled blocks first, the rest are removed below.
+	level_->Reset();
+	debugLayer_->Clear();
+	// Check the last time if we have any block in current scene. Walk backwards, so removing does not need a copy of the list
+	const Vector<SharedPtr<Node> >& children = scene_->GetChildren();
+	for (unsigned i = children.Size(); i-- > 0;)
 	{
-		Node* child = *it;
+		Node* child = children[i];
 		if (child->GetName().Contains("Block"))
 			child->Remove();
 	}
-	// Remove all blocks.
-	blocks_.Clear();
 	// Reset some classes.
 	touch_->Reset();
 }
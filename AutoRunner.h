@@ -24,6 +24,7 @@
 
 #include "Sample.h"
 #include "DebugRenderer.h"
+#include "HudCounter.h"
 
 namespace Urho3D
 {
@@ -33,7 +34,18 @@ namespace Urho3D
 	class Text;
 }
 
+class CameraRig;
 class Character;
+class DebugLayer;
+class FrameJobGraph;
+class Leaderboard;
+class LevelScript;
+class PerfOverlay;
+class RivalCrowd;
+class RunnerLevel;
+class RunSnapshot;
+struct DeathEvent;
+struct PickupEvent;
 class Touch;
 
 class AutoRunner : public Sample
@@ -51,27 +63,57 @@ public:
 	/// Stop after engine exit.
 	virtual void Stop();
 
+protected:
+	/// Configure the console after it has been created.
+	virtual void SetupConsole(Console* console);
+
 private:
 	/// Create static scene content.
 	void InitScene();
-	/// Create controllable character.
-	void CreateCharacter();
 	/// Create camera.
 	void CreateCamera();
 	/// Create overlays.
 	void CreateOverlays();
 	/// Subscribe to necessary events.
 	void SubscribeToEvents();
-	/// Handle application fixed-update. Update character path.
+	/// Handle physics pre-step. Apply queued touch input to character controls and send the fixed step.
 	void HandleFixedUpdate(StringHash eventType, VariantMap& eventData);
+	/// Handle coin pickup. Update the score and coin counters.
+	void OnPickup(const PickupEvent& event);
+	/// Handle character death. End the ghost run.
+	void OnDeath(const DeathEvent& event);
 	/// Handle application update. Set controls to character.
 	void HandleUpdate(StringHash eventType, VariantMap& eventData);
 	/// Handle application post-update. Update camera position after character has moved.
 	void HandlePostUpdate(StringHash eventType, VariantMap& eventData);
+	/// Create the jobs run in each post-update.
+	void CreateFrameJobs();
+	/// Place the camera behind the character. Frame job.
+	void UpdateCamera(unsigned first, unsigned last);
+	/// Format the distance and frame rate counters.
+	void FormatHud();
+	/// Pass the formatted counters to the HUD. Frame job.
+	void ApplyHud(unsigned first, unsigned last);
 	/// Handle the post-render update event.
 	void HandlePostRenderUpdate(StringHash eventType, VariantMap& eventData);
 	/// Handle any UI control being clicked.
 	void HandleControlClicked(StringHash eventType, VariantMap& eventData);
+	/// Rebuild the debug path lines from the character's path.
+	void UpdateDebugPath();
+	/// Rebuild the debug block footprints from the active blocks.
+	void UpdateDebugBlocks();
+	/// Handle input focus change. Snapshot the run when the application goes to the background.
+	void HandleInputFocus(StringHash eventType, VariantMap& eventData);
+	/// Capture the run in progress and write it in the background.
+	void SaveSnapshot();
+	/// Continue the run of the loaded snapshot. Return false if it could not be restored.
+	bool ResumeRun();
+	/// Return the writable directory of the saved scores and snapshots.
+	String GetUserDataDir() const;
+	/// Return the snapshot file name.
+	String GetSnapshotFileName() const;
+	/// Handle a console command. Query or set performance settings, see "help".
+	void HandleConsoleCommand(StringHash eventType, VariantMap& eventData);
 
 	/// Scene.
 	SharedPtr<Scene> scene_;
@@ -79,6 +121,32 @@ private:
 	SharedPtr<Node> cameraNode_;
 	/// Touch utility object.
 	SharedPtr<Touch> touch_;
+	/// Third person camera collision rig.
+	SharedPtr<CameraRig> cameraRig_;
+	/// Performance graphs.
+	SharedPtr<PerfOverlay> perfOverlay_;
+	/// Retained debug geometry.
+	SharedPtr<DebugLayer> debugLayer_;
+	/// Level streamed ahead of the character.
+	SharedPtr<RunnerLevel> level_;
+	/// High score and result submission.
+	SharedPtr<Leaderboard> leaderboard_;
+	/// Snapshot of the run in progress.
+	SharedPtr<RunSnapshot> snapshot_;
+	/// Block choice script of the level.
+	SharedPtr<LevelScript> levelScript_;
+	/// AI rivals running the level.
+	SharedPtr<RivalCrowd> rivals_;
+	/// Number of rivals in each run.
+	unsigned numRivals_;
+	/// Jobs of the post-update.
+	SharedPtr<FrameJobGraph> frameJobs_;
+	/// Frame job indices whose size changes per frame.
+	unsigned rivalJob_;
+	unsigned rivalNodesJob_;
+	unsigned cameraJob_;
+	/// Time step of the post-update in progress.
+	float frameTimeStep_;
 	/// The controllable character component.
 	WeakPtr<Character> character_;
 	/// Camera yaw angle.
@@ -94,21 +162,32 @@ private:
 	void CreateUI();
 	void InitGame();
 	void ResetGame();
-	void CreateLevel();
-	void UpdatePath(bool startIn = true);
-	void InitBlockParameters();
+	void RestartGame();
 
 	bool isPlaying_;
-	unsigned int numBlocks_;
-	List<Node*> blocks_;
-	Vector3 lastOutWorldPosition_;
-	Quaternion lastOutWorldRotation_;
-	Text* scoreText_;
+	/// Profiler capture running flag.
+	bool profiling_;
+	/// Debug HUD profiler interval to restore after a capture.
+	float profilerInterval_;
+	HudCounter scoreCounter_;
+	HudCounter distanceCounter_;
+	HudCounter coinsCounter_;
+	HudCounter fpsCounter_;
+	unsigned fpsFrames_;
+	float fpsTime_;
+	/// Counter values formatted by the frame jobs.
+	int hudDistance_;
+	int hudFps_;
 	Text* loadingText_;
 	Menu* gameMenu_;
+	/// Menu elements updated when the character dies.
+	Text* playText_;
+	Text* infoText_;
+	Text* lastScoreText_;
+	Text* highScoreText_;
+	UIElement* newHighScoreMark_;
+	/// Last run set a new high score flag.
+	bool newHighScore_;
 	Node* characterHead_;
-	Vector<DebugLine> lines_;
-	Vector<Sphere> spheres_;
-	Vector<String> blockNames_;
 
 };
@@ -0,0 +1,34 @@
+-- Block choice rules of the AutoRunner level generator. Load with -levelscript LuaScripts/LevelRules.lua or the
+-- "levelscript" console command. The game asks for a batch of choices at once and writes each as a block prefab index
+-- and an item group index into the choices buffer. Both are taken modulo the prefab and group counts.
+
+-- Blocks over which the level goes from mostly the first prefab to an even mix of all of them.
+local RAMP_BLOCKS = 40
+
+local randomState = 1
+
+local function NextRandom()
+    -- Park-Miller generator, the same sequence as LevelRules.as. The products stay exact in a double
+    randomState = randomState * 16807 % 2147483647
+    return randomState
+end
+
+function ChooseBlocks(firstBlock, count, numPrefabs, seed, choices)
+    randomState = seed % 2147483646 + 1
+
+    -- The whole batch is one loop inside the script, which LuaJIT compiles to a single trace
+    for i = 0, count - 1 do
+        local block = firstBlock + i
+        -- Chance of the first prefab falls from 100% to an even share as the run goes on
+        local ramp = math.min(block, RAMP_BLOCKS)
+        local firstChance = 100 - math.floor(ramp * (100 - math.floor(100 / numPrefabs)) / RAMP_BLOCKS)
+
+        local prefab = 0
+        if NextRandom() % 100 >= firstChance then
+            prefab = NextRandom() % numPrefabs
+        end
+
+        choices:WriteUByte(prefab)
+        choices:WriteUByte(NextRandom() % 256)
+    end
+end
@@ -0,0 +1,35 @@
+// Block choice rules of the AutoRunner level generator. Load with -levelscript Scripts/LevelRules.as or the
+// "levelscript" console command. The game asks for a batch of choices at once and writes each as a block prefab index
+// and an item group index into the choices buffer. Both are taken modulo the prefab and group counts.
+
+// Blocks over which the level goes from mostly the first prefab to an even mix of all of them.
+const uint RAMP_BLOCKS = 40;
+
+uint randomState;
+
+uint NextRandom()
+{
+    // Park-Miller generator, the same sequence as LevelRules.lua
+    randomState = uint(uint64(randomState) * 16807 % 2147483647);
+    return randomState;
+}
+
+void ChooseBlocks(uint firstBlock, uint count, uint numPrefabs, uint seed, VectorBuffer& choices)
+{
+    randomState = seed % 2147483646 + 1;
+
+    for (uint i = 0; i < count; ++i)
+    {
+        uint block = firstBlock + i;
+        // Chance of the first prefab falls from 100% to an even share as the run goes on
+        uint ramp = block < RAMP_BLOCKS ? block : RAMP_BLOCKS;
+        uint firstChance = 100 - ramp * (100 - 100 / numPrefabs) / RAMP_BLOCKS;
+
+        uint prefab = 0;
+        if (NextRandom() % 100 >= firstChance)
+            prefab = NextRandom() % numPrefabs;
+
+        choices.WriteUByte(uint8(prefab));
+        choices.WriteUByte(uint8(NextRandom() % 256));
+    }
+}
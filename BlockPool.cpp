@@ -0,0 +1,344 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "BlockPool.h"
+#include "CollisionShape.h"
+#include "File.h"
+#include "Param.h"
+#include "ResourceCache.h"
+#include "RigidBody.h"
+#include "Scene.h"
+#include "Timer.h"
+
+/// Exit node names of a block: the entry, the single exit, and the left and right exits of a junction.
+static const char* exitNames[] = { "In", "Out", "OutL", "OutR" };
+/// Path node names leading to each exit, by lane side in the order of the character's path sides.
+static const char* pathNames[][MAX_BLOCK_EXITS] =
+{
+	{ "LeftIn", "LeftOut", "LeftOutL", "LeftOutR" },
+	{ "RightIn", "RightOut", "RightOutL", "RightOutR" },
+	{ "CenterIn", "CenterOut", "CenterOutL", "CenterOutR" }
+};
+
+/// Append the child indices from a root to one of its descendants. Return the start of the path.
+static unsigned AppendIndexPath(Node* root, Node* node, PODVector<unsigned>& indices)
+{
+	PODVector<unsigned> path;
+	for (; node && node != root; node = node->GetParent())
+	{
+		const Vector<SharedPtr<Node> >& siblings = node->GetParent()->GetChildren();
+		for (unsigned i = 0; i < siblings.Size(); ++i)
+		{
+			if (siblings[i] == node)
+			{
+				path.Push(i);
+				break;
+			}
+		}
+	}
+
+	unsigned start = indices.Size();
+	indices.Push(path.Size());
+	for (unsigned i = path.Size(); i > 0; --i)
+		indices.Push(path[i - 1]);
+	return start;
+}
+
+/// Follow child indices from a root.
+static Node* FollowIndexPath(Node* root, const PODVector<unsigned>& indices, unsigned start)
+{
+	unsigned length = indices[start];
+	for (unsigned i = 1; i <= length; ++i)
+		root = root->GetChildren()[indices[start + i]];
+	return root;
+}
+
+BlockPool::BlockPool(Context* context) :
+	Object(context),
+	enabled_(true),
+	mergeStatic_(true),
+	numInstantiated_(0),
+	numReused_(0),
+	instantiateTime_(0),
+	numMergedBodies_(0),
+	numStaticBodies_(0)
+{
+}
+
+void BlockPool::SetScene(Scene* scene)
+{
+	Reset();
+	scene_ = scene;
+}
+
+void BlockPool::SetEnabled(bool enable)
+{
+	if (!enable)
+		Clear();
+
+	enabled_ = enable;
+}
+
+Node* BlockPool::Acquire(const String& prefabName, const Quaternion& rotation)
+{
+	if (!scene_)
+		return 0;
+
+	HashMap<StringHash, PODVector<Node*> >::Iterator it = pooled_.Find(StringHash(prefabName));
+	if (it != pooled_.End() && !it->second_.Empty())
+	{
+		Node* block = it->second_.Back();
+		it->second_.Pop();
+		// Re-enabling is recursive, which also brings back picked coins and the groups that were not chosen last time.
+		block->SetEnabled(true, true);
+		block->SetPosition(Vector3::ZERO);
+		block->SetRotation(rotation);
+		active_.Push(block);
+		++numReused_;
+		return block;
+	}
+
+	SharedPtr<File> file = GetSubsystem<ResourceCache>()->GetFile(prefabName);
+	if (!file)
+		return 0;
+
+	HiresTimer instantiateTimer;
+	Node* block = scene_->InstantiateXML(*file, Vector3::ZERO, rotation);
+	instantiateTime_ += instantiateTimer.GetUSec(false);
+	if (!block)
+		return 0;
+
+	block->SetVar(GameVariants::P_PREFAB, prefabName);
+	if (mergeStatic_)
+		MergeStaticBodies(block);
+
+	// Anchors are searched by name in the first instance of a prefab only, the later ones index the children instead
+	StringHash prefab(prefabName);
+	HashMap<StringHash, BlockSchema>::Iterator schema = schemas_.Find(prefab);
+	if (schema == schemas_.End())
+	{
+		schema = schemas_.Insert(MakePair(prefab, BlockSchema()));
+		CompileSchema(block, schema->second_);
+	}
+	BlockAnchors& anchors = anchors_[block];
+	ResolveAnchors(block, schema->second_, anchors);
+
+	active_.Push(block);
+	++numInstantiated_;
+	return block;
+}
+
+void BlockPool::Release(Node* block)
+{
+	if (!block)
+		return;
+
+	active_.Remove(block);
+
+	if (!enabled_)
+	{
+		RemoveAnchors(block);
+		block->Remove();
+		return;
+	}
+
+	block->SetEnabled(false, true);
+	pooled_[StringHash(block->GetVar(GameVariants::P_PREFAB).GetString())].Push(block);
+}
+
+void BlockPool::ReleaseAll()
+{
+	while (!active_.Empty())
+		Release(active_.Back());
+}
+
+void BlockPool::Clear()
+{
+	for (HashMap<StringHash, PODVector<Node*> >::Iterator i = pooled_.Begin(); i != pooled_.End(); ++i)
+	{
+		for (PODVector<Node*>::Iterator j = i->second_.Begin(); j != i->second_.End(); ++j)
+		{
+			RemoveAnchors(*j);
+			(*j)->Remove();
+		}
+	}
+
+	pooled_.Clear();
+}
+
+void BlockPool::Reset()
+{
+	Clear();
+	active_.Clear();
+	anchors_.Clear();
+}
+
+void BlockPool::MergeStaticBodies(Node* block)
+{
+	Node* floors = block->GetChild("Floors", true);
+	if (!floors)
+		return;
+
+	// Only solid platform floors are merged. Trigger floors, coins, turn points and obstacles keep their own bodies, as
+	// groups are switched on and off per block
+	PODVector<RigidBody*> bodies;
+	const Vector<SharedPtr<Node> >& children = floors->GetChildren();
+	for (Vector<SharedPtr<Node> >::ConstIterator i = children.Begin(); i != children.End(); ++i)
+	{
+		RigidBody* body = (*i)->GetComponent<RigidBody>();
+		if (!body || body->GetMass() != 0.0f || body->IsTrigger() || !(*i)->GetVar(GameVariants::P_ISINPLATFORM).GetBool())
+			continue;
+		if (!bodies.Empty() && (body->GetCollisionLayer() != bodies[0]->GetCollisionLayer() ||
+			body->GetCollisionMask() != bodies[0]->GetCollisionMask()))
+			continue;
+		bodies.Push(body);
+	}
+
+	if (bodies.Size() < 2)
+		return;
+
+	// The merged body is a child of Floors like the floors themselves, so the character finds the block above it the same way
+	Node* merged = floors->CreateChild("StaticCollision");
+	merged->SetVar(GameVariants::P_ISINPLATFORM, true);
+	Matrix3x4 toMerged = merged->GetWorldTransform().Inverse();
+	unsigned layer = bodies[0]->GetCollisionLayer();
+	unsigned mask = bodies[0]->GetCollisionMask();
+	float friction = bodies[0]->GetFriction();
+	float restitution = bodies[0]->GetRestitution();
+
+	for (PODVector<RigidBody*>::ConstIterator i = bodies.Begin(); i != bodies.End(); ++i)
+	{
+		Node* floor = (*i)->GetNode();
+		Matrix3x4 transform = toMerged * floor->GetWorldTransform();
+		Vector3 position;
+		Quaternion rotation;
+		Vector3 scale;
+		transform.Decompose(position, rotation, scale);
+
+		// Take the body out of the world before its shapes, so that the compound is not rebuilt for each removed shape
+		floor->RemoveComponent(*i);
+
+		PODVector<CollisionShape*> shapes;
+		floor->GetComponents(shapes);
+		for (PODVector<CollisionShape*>::ConstIterator j = shapes.Begin(); j != shapes.End(); ++j)
+		{
+			CollisionShape* source = *j;
+			CollisionShape* shape = merged->CreateComponent<CollisionShape>();
+			shape->SetModel(source->GetModel());
+			shape->SetLodLevel(source->GetLodLevel());
+			shape->SetMargin(source->GetMargin());
+			shape->SetShapeType(source->GetShapeType());
+			shape->SetSize(source->GetSize() * scale);
+			shape->SetTransform(transform * source->GetPosition(), rotation * source->GetRotation());
+			floor->RemoveComponent(source);
+		}
+
+		++numMergedBodies_;
+	}
+
+	// The body is created after the shapes, so its compound is built once
+	RigidBody* body = merged->CreateComponent<RigidBody>();
+	body->SetCollisionLayerAndMask(layer, mask);
+	body->SetFriction(friction);
+	body->SetRestitution(restitution);
+	++numStaticBodies_;
+}
+
+unsigned BlockPool::GetNumPooled() const
+{
+	unsigned count = 0;
+	for (HashMap<StringHash, PODVector<Node*> >::ConstIterator i = pooled_.Begin(); i != pooled_.End(); ++i)
+		count += i->second_.Size();
+
+	return count;
+}
+
+unsigned BlockPool::GetNumLiveCoins() const
+{
+	unsigned count = 0;
+	for (PODVector<Node*>::ConstIterator i = active_.Begin(); i != active_.End(); ++i)
+	{
+		HashMap<Node*, BlockAnchors>::ConstIterator anchors = anchors_.Find(*i);
+		if (anchors == anchors_.End())
+			continue;
+
+		// Picked coins and coins of the groups not chosen are disabled.
+		const PODVector<Node*>& coins = anchors->second_.coins_;
+		for (PODVector<Node*>::ConstIterator j = coins.Begin(); j != coins.End(); ++j)
+		{
+			if ((*j)->IsEnabled())
+				++count;
+		}
+	}
+
+	return count;
+}
+
+const BlockAnchors* BlockPool::GetAnchors(Node* block) const
+{
+	HashMap<Node*, BlockAnchors>::ConstIterator i = anchors_.Find(block);
+	return i != anchors_.End() ? &i->second_ : 0;
+}
+
+void BlockPool::CompileSchema(Node* block, BlockSchema& schema)
+{
+	Node* nodes[MAX_BLOCK_ANCHORS];
+	for (unsigned i = 0; i < MAX_BLOCK_EXITS; ++i)
+		nodes[ANCHOR_IN + i] = block->GetChild(exitNames[i], true);
+	nodes[ANCHOR_PATHS] = block->GetChild("Paths", true);
+	nodes[ANCHOR_GROUPS] = block->GetChild("Groups", true);
+	for (unsigned i = 0; i < MAX_BLOCK_SIDES; ++i)
+	{
+		for (unsigned j = 0; j < MAX_BLOCK_EXITS; ++j)
+			nodes[ANCHOR_PATH + i * MAX_BLOCK_EXITS + j] = nodes[ANCHOR_PATHS] ? nodes[ANCHOR_PATHS]->GetChild(pathNames[i][j]) : 0;
+	}
+
+	schema.indices_.Clear();
+	for (unsigned i = 0; i < MAX_BLOCK_ANCHORS; ++i)
+		schema.anchors_[i] = nodes[i] ? AppendIndexPath(block, nodes[i], schema.indices_) : M_MAX_UNSIGNED;
+
+	PODVector<Node*> children;
+	block->GetChildren(children, true);
+	for (PODVector<Node*>::ConstIterator i = children.Begin(); i != children.End(); ++i)
+	{
+		if (!(*i)->GetVar(GameVariants::P_POINT).IsEmpty())
+			schema.coins_.Push(AppendIndexPath(block, *i, schema.indices_));
+	}
+}
+
+void BlockPool::ResolveAnchors(Node* block, const BlockSchema& schema, BlockAnchors& anchors)
+{
+	for (unsigned i = 0; i < MAX_BLOCK_ANCHORS; ++i)
+		anchors.nodes_[i] = schema.anchors_[i] != M_MAX_UNSIGNED ? FollowIndexPath(block, schema.indices_, schema.anchors_[i]) : 0;
+
+	anchors.coins_.Resize(schema.coins_.Size());
+	for (unsigned i = 0; i < schema.coins_.Size(); ++i)
+		anchors.coins_[i] = FollowIndexPath(block, schema.indices_, schema.coins_[i]);
+}
+
+void BlockPool::RemoveAnchors(Node* block)
+{
+	HashMap<Node*, BlockAnchors>::Iterator i = anchors_.Find(block);
+	if (i != anchors_.End())
+		anchors_.Erase(i);
+}
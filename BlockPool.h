@@ -0,0 +1,173 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "HashMap.h"
+#include "Object.h"
+#include "Quaternion.h"
+
+using namespace Urho3D;
+
+namespace Urho3D
+{
+	class Node;
+	class Scene;
+}
+
+/// Exits of a block: the entry, the single exit, and the left and right exits of a junction.
+static const unsigned MAX_BLOCK_EXITS = 4;
+/// Lane sides of a block's paths, in the order of the character's path sides.
+static const unsigned MAX_BLOCK_SIDES = 3;
+
+/// Named anchor nodes of a block prefab.
+enum BlockAnchor
+{
+	/// Exit nodes, in exit order.
+	ANCHOR_IN = 0,
+	ANCHOR_OUT,
+	ANCHOR_OUTL,
+	ANCHOR_OUTR,
+	/// Parent of the lane paths.
+	ANCHOR_PATHS,
+	/// Parent of the item groups.
+	ANCHOR_GROUPS,
+	/// Lane paths by side and exit.
+	ANCHOR_PATH,
+	MAX_BLOCK_ANCHORS = ANCHOR_PATH + MAX_BLOCK_SIDES * MAX_BLOCK_EXITS
+};
+
+/// Child index paths of the anchors of a block prefab. Found by name in the first instance, the later instances are resolved
+/// by indexing the children.
+struct BlockSchema
+{
+	/// Child indices from the block root, each path preceded by its length.
+	PODVector<unsigned> indices_;
+	/// Start of each anchor's path in the indices, or M_MAX_UNSIGNED if the prefab does not have the anchor.
+	unsigned anchors_[MAX_BLOCK_ANCHORS];
+	/// Start of each coin's path.
+	PODVector<unsigned> coins_;
+};
+
+/// Anchor nodes of a block instance.
+struct BlockAnchors
+{
+	/// Return an anchor node, or null if the prefab does not have it.
+	Node* Get(BlockAnchor anchor) const { return nodes_[anchor]; }
+	/// Return an exit node by exit index.
+	Node* GetExit(unsigned exit) const { return nodes_[ANCHOR_IN + exit]; }
+	/// Return the path of a lane side leading to an exit.
+	Node* GetPath(unsigned side, unsigned exit) const { return nodes_[ANCHOR_PATH + side * MAX_BLOCK_EXITS + exit]; }
+
+	/// Anchor nodes.
+	Node* nodes_[MAX_BLOCK_ANCHORS];
+	/// Coin nodes.
+	PODVector<Node*> coins_;
+};
+
+/// Pool of level blocks. Released blocks are disabled and kept in the scene, so that the next block of the same prefab skips XML instantiation.
+class BlockPool : public Object
+{
+	OBJECT(BlockPool);
+
+public:
+	/// Construct.
+	BlockPool(Context* context);
+
+	/// Set the scene blocks are instantiated into. Drops all pooled blocks.
+	void SetScene(Scene* scene);
+	/// Enable or disable pooling. Disabling removes pooled blocks, later releases remove the block.
+	void SetEnabled(bool enable);
+	/// Enable or disable merging the floor bodies of newly instantiated blocks into one static body. Pooled blocks keep their state.
+	void SetMergeStatic(bool enable) { mergeStatic_ = enable; }
+	/// Return an enabled block of the prefab, at the origin with the given rotation.
+	Node* Acquire(const String& prefabName, const Quaternion& rotation);
+	/// Return a block to the pool, or remove it if pooling is disabled.
+	void Release(Node* block);
+	/// Release all blocks handed out.
+	void ReleaseAll();
+	/// Remove all pooled blocks from the scene.
+	void Clear();
+	/// Remove all pooled blocks and forget the active ones. Call when the active blocks have been removed otherwise.
+	void Reset();
+
+	/// Return whether pooling is enabled.
+	bool IsEnabled() const { return enabled_; }
+	/// Return whether floor bodies are merged.
+	bool GetMergeStatic() const { return mergeStatic_; }
+	/// Return number of blocks waiting in the pool.
+	unsigned GetNumPooled() const;
+	/// Return number of blocks handed out and not yet released.
+	unsigned GetNumActive() const { return active_.Size(); }
+	/// Return the blocks handed out.
+	const PODVector<Node*>& GetActiveBlocks() const { return active_; }
+	/// Return number of blocks instantiated from XML.
+	unsigned GetNumInstantiated() const { return numInstantiated_; }
+	/// Return number of acquires served from the pool.
+	unsigned GetNumReused() const { return numReused_; }
+	/// Return the time spent instantiating blocks from XML in microseconds.
+	long long GetInstantiateTime() const { return instantiateTime_; }
+	/// Return number of floor bodies merged away.
+	unsigned GetNumMergedBodies() const { return numMergedBodies_; }
+	/// Return number of static bodies created by merging.
+	unsigned GetNumStaticBodies() const { return numStaticBodies_; }
+	/// Return number of coins left in the active blocks.
+	unsigned GetNumLiveCoins() const;
+	/// Return the anchors of a block handed out or pooled, or null if the block did not come from the pool.
+	const BlockAnchors* GetAnchors(Node* block) const;
+
+private:
+	/// Move the collision shapes of the platform floors of a block onto one static body, so the block is a single broadphase proxy.
+	void MergeStaticBodies(Node* block);
+	/// Find the anchors of the first instance of a prefab by name and record their child indices.
+	void CompileSchema(Node* block, BlockSchema& schema);
+	/// Resolve the anchors of an instance from the child indices of its prefab.
+	void ResolveAnchors(Node* block, const BlockSchema& schema, BlockAnchors& anchors);
+	/// Forget the anchors of a block that is removed.
+	void RemoveAnchors(Node* block);
+
+	/// Scene.
+	WeakPtr<Scene> scene_;
+	/// Disabled blocks by prefab name hash.
+	HashMap<StringHash, PODVector<Node*> > pooled_;
+	/// Pooling enabled flag.
+	bool enabled_;
+	/// Floor body merging flag.
+	bool mergeStatic_;
+	/// Blocks handed out.
+	PODVector<Node*> active_;
+	/// Anchor child indices by prefab name hash.
+	HashMap<StringHash, BlockSchema> schemas_;
+	/// Anchors of each block.
+	HashMap<Node*, BlockAnchors> anchors_;
+	/// Blocks instantiated from XML.
+	unsigned numInstantiated_;
+	/// Acquires served from the pool.
+	unsigned numReused_;
+	/// Time spent instantiating from XML in microseconds.
+	long long instantiateTime_;
+	/// Floor bodies merged away.
+	unsigned numMergedBodies_;
+	/// Static bodies created by merging.
+	unsigned numStaticBodies_;
+};
@@ -0,0 +1,99 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "CameraRig.h"
+#include "Character.h"
+#include "PhysicsWorld.h"
+#include "Ray.h"
+#include "Touch.h"
+
+CameraRig::CameraRig(Context* context) :
+	Object(context),
+	lastAimPoint_(Vector3::ZERO),
+	lastDirection_(Vector3::BACK),
+	lastDesiredDistance_(CAMERA_INITIAL_DIST),
+	targetDistance_(CAMERA_INITIAL_DIST),
+	distance_(CAMERA_INITIAL_DIST),
+	velocity_(0.0f),
+	cacheValid_(false),
+	numQueries_(0)
+{
+}
+
+void CameraRig::SetPhysicsWorld(PhysicsWorld* world)
+{
+	physicsWorld_ = world;
+	Reset();
+}
+
+float CameraRig::Update(const Vector3& aimPoint, const Vector3& direction, float desiredDistance, float timeStep)
+{
+	bool snap = !cacheValid_;
+
+	// Reuse the previous hit while neither the aim point nor the view direction moved beyond the tolerance.
+	if (!cacheValid_ || (aimPoint - lastAimPoint_).LengthSquared() > CAMERA_REQUERY_DISTANCE * CAMERA_REQUERY_DISTANCE ||
+		direction.DotProduct(lastDirection_) < CAMERA_REQUERY_DOT || desiredDistance != lastDesiredDistance_)
+	{
+		targetDistance_ = desiredDistance;
+
+		if (physicsWorld_)
+		{
+			// Cast against static physics objects (layer bitmask 2) to ensure we see the character properly
+			PhysicsRaycastResult result;
+			physicsWorld_->SphereCast(result, Ray(aimPoint, direction), CAMERA_PROBE_RADIUS, desiredDistance, FLOOR_COLLISION_MASK);
+			++numQueries_;
+			if (result.body_)
+				targetDistance_ = Min(desiredDistance, result.distance_);
+		}
+
+		targetDistance_ = Clamp(targetDistance_, CAMERA_MIN_DIST, CAMERA_MAX_DIST);
+		lastAimPoint_ = aimPoint;
+		lastDirection_ = direction;
+		lastDesiredDistance_ = desiredDistance;
+		cacheValid_ = true;
+	}
+
+	if (snap)
+	{
+		distance_ = targetDistance_;
+		velocity_ = 0.0f;
+		return distance_;
+	}
+
+	// Critically damped spring towards the target. Pull in quickly so geometry does not cut the view, ease back out slowly
+	float smoothTime = targetDistance_ < distance_ ? CAMERA_SPRING_IN_TIME : CAMERA_SPRING_OUT_TIME;
+	float omega = 2.0f / smoothTime;
+	float x = omega * timeStep;
+	float decay = 1.0f / (1.0f + x + 0.48f * x * x + 0.235f * x * x * x);
+	float change = distance_ - targetDistance_;
+	float temp = (velocity_ + omega * change) * timeStep;
+	velocity_ = (velocity_ - omega * temp) * decay;
+	distance_ = targetDistance_ + (change + temp) * decay;
+
+	return distance_;
+}
+
+void CameraRig::Reset()
+{
+	cacheValid_ = false;
+	velocity_ = 0.0f;
+}
@@ -0,0 +1,85 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "Object.h"
+#include "Vector3.h"
+
+using namespace Urho3D;
+
+namespace Urho3D
+{
+	class PhysicsWorld;
+}
+
+/// Radius of the sphere swept from the aim point towards the camera.
+const float CAMERA_PROBE_RADIUS = 0.3f;
+/// Aim point movement that invalidates the cached probe result.
+const float CAMERA_REQUERY_DISTANCE = 0.25f;
+/// Cosine of the view direction change that invalidates the cached probe result.
+const float CAMERA_REQUERY_DOT = 0.999f;
+/// Spring smoothing time when the camera has to move closer to the character.
+const float CAMERA_SPRING_IN_TIME = 0.05f;
+/// Spring smoothing time when the camera moves back out.
+const float CAMERA_SPRING_OUT_TIME = 0.3f;
+
+/// Third person camera rig. Sphere casts for occluders only when the view has changed noticeably, and eases distance changes
+/// with a critically damped spring.
+class CameraRig : public Object
+{
+	OBJECT(CameraRig);
+
+public:
+	/// Construct.
+	CameraRig(Context* context);
+
+	/// Set the physics world to cast against.
+	void SetPhysicsWorld(PhysicsWorld* world);
+	/// Return the smoothed camera distance from the aim point along the direction.
+	float Update(const Vector3& aimPoint, const Vector3& direction, float desiredDistance, float timeStep);
+	/// Forget the cached hit and snap to the next requested distance.
+	void Reset();
+
+	/// Return number of sphere casts made so far.
+	unsigned GetNumQueries() const { return numQueries_; }
+
+private:
+	/// Physics world.
+	WeakPtr<PhysicsWorld> physicsWorld_;
+	/// Aim point of the last query.
+	Vector3 lastAimPoint_;
+	/// Direction of the last query.
+	Vector3 lastDirection_;
+	/// Desired distance of the last query.
+	float lastDesiredDistance_;
+	/// Unobstructed distance found by the last query.
+	float targetDistance_;
+	/// Current smoothed distance.
+	float distance_;
+	/// Spring velocity of the distance.
+	float velocity_;
+	/// Cached query valid flag.
+	bool cacheValid_;
+	/// Number of sphere casts made.
+	unsigned numQueries_;
+};
@@ -21,52 +21,47 @@
 //
 
 #include "AnimationController.h"
+#include "AnimationState.h"
 #include "Character.h"
 #include "Context.h"
-#include "MemoryBuffer.h"
-#include "PhysicsEvents.h"
-#include "PhysicsWorld.h"
-#include "RigidBody.h"
-#include "Scene.h"
-#include "SceneEvents.h"
-#include "Log.h"
-#include "SmoothedTransform.h"
-#include "AnimationState.h"
-#include "Ray.h"
 #include "DebugRenderer.h"
-#include "Param.h"
-#include "CollisionShape.h"
-#include "SoundSource.h"
+#include "Deserializer.h"
+#include "GameEvents.h"
+#include "LatencyTracer.h"
+#include "Log.h"
 #include "ResourceCache.h"
+#include "RunnerLevel.h"
+#include "Scene.h"
+#include "Serializer.h"
 #include "Sound.h"
+#include "SoundSource.h"
 
 namespace Urho3D
 {
 	extern const char* SCENE_CATEGORY;
 }
 
+/// Actions whose first physics step is marked for the latency tracer.
+static const int tracedActions[] = { CTRL_LEFT, CTRL_RIGHT, CTRL_JUMP, CTRL_BACK };
+
 Character::Character(Context* context) :
     LogicComponent(context),
-    onGround_(false),
-    inAirTimer_(0.0f),
-	score_(0),
-	turnRequest_(false),
-	inTrigger_(false),
-	onJumpGround_(false),
 	rolling_(false),
 	isDead_(false),
-	currentBlock_(0),
-	currentSide_(CENTER_SIDE),
-	jumpState_(STOP_JUMPING),
-	turnState_(NO_SUCCEEDED)
+	stepActions_(0),
+	animCtrl_(0),
+	events_(0),
+	jumpState_(STOP_JUMPING)
 {
-	// Only the physics update event is needed: unsubscribe from the rest for optimization
-	SetUpdateEventMask(USE_FIXEDUPDATE|USE_POSTUPDATE);
+	// The fixed update arrives through the typed step channel, right after the application has queued its input.
+	// Only the post-update event is needed from the base class: unsubscribe from the rest for optimization
+	SetUpdateEventMask(USE_POSTUPDATE);
 }
 
 Character::~Character()
 {
-	Stop();
+	if (events_)
+		events_->UnsubscribeAll(this);
 }
 
 void Character::RegisterObject(Context* context)
@@ -77,279 +72,112 @@ void Character::RegisterObject(Context* context)
     // We specify the Default attribute mode which means it will be used both for saving into file, and network replication
     ATTRIBUTE(Character, VAR_FLOAT, "Controls Yaw", controls_.yaw_, 0.0f, AM_DEFAULT);
     ATTRIBUTE(Character, VAR_FLOAT, "Controls Pitch", controls_.pitch_, 0.0f, AM_DEFAULT);
-    ATTRIBUTE(Character, VAR_BOOL, "On Ground", onGround_, false, AM_DEFAULT);
-    ATTRIBUTE(Character, VAR_FLOAT, "In Air Timer", inAirTimer_, 0.0f, AM_DEFAULT);
 }
 
 void Character::Start()
 {
-	// Component has been inserted into its scene node. Subscribe to events now
-	SubscribeToEvent(GetNode(), E_NODECOLLISION, HANDLER(Character, HandleNodeCollision));
-	SubscribeToEvent(GetNode(), E_NODECOLLISIONSTART, HANDLER(Character, HandleNodeCollisionStart));
-	SubscribeToEvent(GetNode(), E_NODECOLLISIONEND, HANDLER(Character, HandleNodeCollisionEnd));
+	// A hub set before the delayed start, such as a race match's own, is kept
+	if (!events_)
+		SetEventHub(GetSubsystem<GameEventHub>());
 
-	animCtrl_ = GetNode()->GetChild("PlayerModel")->GetComponent<AnimationController>();
+	animCtrl_ = GetNode()->GetChild(NODE_PLAYER_MODEL.GetHash())->GetComponent<AnimationController>();
 }
 
-void Character::Stop()
+void Character::SetEventHub(GameEventHub* hub)
 {
-	// Remove all way-points and passed blocks.
-	runPath_.Clear();
-	RemovePassedBlocks();
+	if (events_)
+		events_->UnsubscribeAll(this);
+
+	events_ = hub;
+	if (events_)
+		events_->fixedStep_.Subscribe<Character, &Character::OnFixedStep>(this);
 }
 
 void Character::FixedUpdate(float timeStep)
 {
-	static float coolDown = 0.0f;
-
-	if (coolDown > 0)
-		coolDown -= timeStep;
-
-    /// \todo Could cache the components for faster access instead of finding them each frame
-    RigidBody* body = GetComponent<RigidBody>();
-    
-    // Update the in air timer. Reset if grounded
-    if (!onGround_)
-        inAirTimer_ += timeStep;
-    else
-        inAirTimer_ = 0.0f;
-    // When character has been in air less than 1/10 second, it's still interpreted as being on ground
-    bool softGrounded = inAirTimer_ < INAIR_THRESHOLD_TIME;
-    
-    // Update movement & animation
-    const Quaternion& rot = GetNode()->GetRotation();
-    Vector3 moveDir = Vector3::ZERO;
-    const Vector3& velocity = body->GetLinearVelocity();
-    // Velocity on the XZ plane
-    Vector3 planeVelocity(velocity.x_, 0.0f, velocity.z_);
-
-	if (inAirTimer_ > 20.0f)
-		isDead_ = true;
+	// Every action queued since the last step is handled by this step only.
+	int actions = commands_.Consume();
+	stepActions_ = actions;
+	if (!level_)
+		return;
 
 	if (isDead_)
 	{
-		if (!animCtrl_->IsPlaying(ANIM_DEATH))
-		{
-			moveDir = Vector3::BACK;
-			body->SetLinearVelocity(Vector3::ZERO);
-			body->ApplyImpulse(rot * moveDir * 5.5f);
-			//LOGDEBUG("Stopping all animations.");
+		if (!IsPlayingAnim(ANIM_DEATH))
 			animCtrl_->StopAll();
-		}
-
-		animCtrl_->Play(ANIM_DEATH, 0, false, 0.2f);
-		//LOGDEBUG("Playing death.");
-		animCtrl_->SetSpeed(ANIM_DEATH, 0.3f);
 
+		animCtrl_->Play(ANIM_DEATH.GetString(), 0, false, 0.2f);
+		animCtrl_->SetSpeed(ANIM_DEATH.GetString(), 0.3f);
 		return;
 	}
-	else
-	{
-		if (controls_.IsDown(CTRL_FORWARD))
-		{
-			moveDir = Vector3::FORWARD;
-			body->ApplyImpulse(rot * moveDir * (softGrounded ? MOVE_FORCE : INAIR_MOVE_FORCE));
-		}
-
-		if (controls_.IsDown(CTRL_BACK|CTRL_JUMP|CTRL_LEFT|CTRL_RIGHT) && coolDown <= 0)
-			coolDown = 0.2f;
 
-		if (controls_.IsDown(CTRL_LEFT))
-		{
-			turnState_ = LEFT_SUCCEEDED;
-		}
-		else if (coolDown <= 0)
-		{
-			turnState_ = NO_SUCCEEDED;
-		}
-
-		if (controls_.IsDown(CTRL_RIGHT))
-		{
-			turnState_ = RIGHT_SUCCEEDED;
-		}
-		else if (coolDown <= 0)
-		{
-			turnState_ = NO_SUCCEEDED;
-		}
-
-		if (controls_.IsDown(CTRL_BACK))
-			rolling_ = true;
-
-		// Adjusting character collision shape's size and position each movement state.
-		if (rolling_ || jumpState_ == LOOP_JUMPING)
-		{
-			CollisionShape* shape = GetNode()->GetComponent<CollisionShape>();
-			shape->SetSize(Vector3(0.7f, 0.6f, 0.7f));
-			shape->SetPosition(Vector3(0.0f, 0.5f, 0.0f));
-		}
-		else
-		{
-			CollisionShape* shape = GetNode()->GetComponent<CollisionShape>();
-			shape->SetSize(Vector3(0.7f, 1.5f, 0.7f));
-			shape->SetPosition(Vector3(0.0f, 0.8f, 0.0f));
-		}
-
-		if (Urho3D::Equals(coolDown, 0.2f) && !inTrigger_)
-		{
-			if (controls_.IsDown(CTRL_LEFT) && CheckSide(CTRL_LEFT))
-			{
-				moveDir = Vector3::LEFT;
-				turnState_ = SIDE_LEFT_SUCCEEDED;
+	LatencyTracer* tracer = GetSubsystem<LatencyTracer>();
+	for (unsigned i = 0; tracer && i < sizeof tracedActions / sizeof tracedActions[0]; ++i)
+	{
+		if (actions & tracedActions[i])
+			tracer->Mark(tracedActions[i], LATENCY_IMPULSE);
+	}
+	if (actions & CTRL_BACK)
+		rolling_ = true;
 
-				if (jumpState_ == STOP_JUMPING)
-					body->ApplyImpulse(rot * moveDir * MOVE_SIDE_FORCE);
-				else
-					body->ApplyForce(rot * moveDir * MOVE_SIDE_AIR_FORCE);
-			}
+	unsigned numBlocks = sim_.GetNumBlocks();
+	Fixed lateral = sim_.GetLateral();
+	int score = sim_.GetScore();
+	sim_.Step(controls_.buttons_, actions);
 
-			if (controls_.IsDown(CTRL_RIGHT) && CheckSide(CTRL_RIGHT))
-			{
-				moveDir = Vector3::RIGHT;
-				turnState_ = SIDE_RIGHT_SUCCEEDED;
+	const PODVector<SimPickup>& pickups = sim_.GetPickups();
+	for (unsigned i = 0; i < pickups.Size(); ++i)
+	{
+		const SimPickup& pickup = pickups[i];
+		Node* coin = level_ ? level_->GetTrackItem(pickup.block_, pickup.item_) : 0;
+		score += pickup.points_;
 
-				if (jumpState_ == STOP_JUMPING)
-					body->ApplyImpulse(rot * moveDir * MOVE_SIDE_FORCE);
-				else
-					body->ApplyForce(rot * moveDir * MOVE_SIDE_AIR_FORCE);
-			}
-		}
+		// Create hit sound.
+		Sound* sound = GetSubsystem<ResourceCache>()->GetResource<Sound>("Sounds/NutThrow.wav");
+		SoundSource* soundSource = node_->GetOrCreateComponent<SoundSource>();
+		soundSource->Play(sound);
+		soundSource->SetAutoRemove(true);
 
-		if (softGrounded)
-		{
-			// When on ground, apply a braking force to limit maximum ground velocity
-			Vector3 brakeForce = -planeVelocity * BRAKE_FORCE;
-			body->ApplyImpulse(brakeForce);
+		PickupEvent event;
+		event.coin_ = coin;
+		event.points_ = pickup.points_;
+		event.score_ = score;
+		events_->pickup_.Send(event);
 
-			// Jump. Must release jump control inbetween jumps
-			if (Urho3D::Equals(coolDown, 0.2f) && controls_.IsDown(CTRL_JUMP) && jumpState_ == STOP_JUMPING)
-			{
-				body->ApplyImpulse(Vector3::UP * JUMP_FORCE);
-				//LOGDEBUG("Stopping run.");
-				animCtrl_->Stop(ANIM_RUN, 0.2f);
-				animCtrl_->Play(ANIM_JUMP_START, 0, false, 0.2f);
-				//LOGDEBUG("Playing jump start.");
-				jumpState_ = START_JUMPING;
-			}
-		}
+		// Disable rather than remove, so that a pooled block can bring the coin back.
+		if (coin)
+			coin->SetEnabled(false);
 	}
 
-	if (jumpState_ == START_JUMPING || jumpState_ == LOOP_JUMPING)
+	if (sim_.GetNumBlocks() != numBlocks && level_)
 	{
-		float minJmpLoop = 0.4f;
-		float minDistance = 0.1f;
-		PhysicsRaycastResult result;
-		Ray ray(GetNode()->GetWorldPosition(), Vector3::DOWN);
-		GetNode()->GetScene()->GetComponent<PhysicsWorld>()->RaycastSingle(result, ray, 100.0f, FLOOR_COLLISION_MASK);
-		if (result.body_)
-		{
-			if (result.distance_ < minJmpLoop)
-			{
-				if (jumpState_ == START_JUMPING)
-				{
-					animCtrl_->Play(ANIM_JUMP_START, 0, false, 0.2f);
-					//LOGDEBUG("Playing jump start.");
-				}
-				else if (jumpState_ == LOOP_JUMPING)
-				{
-					if (animCtrl_->IsPlaying(ANIM_JUMP_LOOP))
-					{
-						//LOGDEBUG("Stopping jump loop.");
-						animCtrl_->Stop(ANIM_JUMP_LOOP, 0.2f);
-					}
-
-					animCtrl_->Play(ANIM_JUMP_END, 0, false, 0.2f);
-					//LOGDEBUG("Playing jump end.");
-
-					if (result.distance_ < minDistance)
-					{
-						//LOGDEBUG("Stopping jump loop.");
-						animCtrl_->Stop(ANIM_JUMP_LOOP, 0.2f);
-						jumpState_ = STOP_JUMPING;
-					}
-				}
-			}
-			else
-			{
-				if (jumpState_ == START_JUMPING)
-				{
-					//LOGDEBUG("Stopping jump start.");
-					animCtrl_->Stop(ANIM_JUMP_START, 0.2f);
-					jumpState_ = LOOP_JUMPING;
-				}
-				else if (jumpState_ == LOOP_JUMPING)
-				{
-					if (turnState_ == SIDE_LEFT_SUCCEEDED)
-					{
-						//LOGDEBUG("Stopping jump loop.");
-						animCtrl_->Stop(ANIM_JUMP_LOOP, 0.2f);
-						//LOGDEBUG("Playing jump left.");
-						animCtrl_->Play(ANIM_JUMP_LEFT, 0, false, 0.2f);
-					}
-					else if (turnState_ == SIDE_RIGHT_SUCCEEDED)
-					{
-						//LOGDEBUG("Stopping jump loop.");
-						animCtrl_->Stop(ANIM_JUMP_LOOP, 0.2f);
-						//LOGDEBUG("Playing jump right.");
-						animCtrl_->Play(ANIM_JUMP_RIGHT, 0, false, 0.2f);
-					}
-					else
-					{
-						if (IsPlayedAnim(ANIM_JUMP_LEFT))
-						{
-							//LOGDEBUG("Stopping jump left.");
-							animCtrl_->Stop(ANIM_JUMP_LEFT, 0.1f);
-						}
-
-						if (IsPlayedAnim(ANIM_JUMP_RIGHT))
-						{
-							//LOGDEBUG("Stopping jump right.");
-							animCtrl_->Stop(ANIM_JUMP_RIGHT, 0.1f);
-						}
-
-						animCtrl_->Play(ANIM_JUMP_LOOP, 0, true, 0.2f);
-						animCtrl_->SetSpeed(ANIM_JUMP_LOOP, 0.4f);
-						//LOGDEBUG("Playing jump loop.");
-					}
-				}
-			}
-		}
+		BlockEnteredEvent entered;
+		entered.block_ = level_->GetTrackBlock(sim_.GetNumBlocks() - 1).block_;
+		entered.previousBlock_ = numBlocks ? level_->GetTrackBlock(numBlocks - 1).block_ : 0;
+		events_->blockEntered_.Send(entered);
 	}
 
-	// Play walk animation if moving on ground, otherwise fade it out
-	if (jumpState_ == STOP_JUMPING && softGrounded/* && !moveDir.Equals(Vector3::ZERO)*/)
-	{
-		if (rolling_)
-		{
-			//LOGDEBUG("Stopping run.");
-			animCtrl_->Stop(ANIM_RUN, 0.2f);
-			//LOGDEBUG("Playing roll.");
-			animCtrl_->Play(ANIM_ROLL, 0, false, 0.1f);
-			animCtrl_->SetSpeed(ANIM_ROLL, 0.6f);
+	UpdateTransform(timeStep);
 
-			if (IsPlayedAnim(ANIM_ROLL))
-			{
-				//LOGDEBUG("Stopping roll.");
-				animCtrl_->Stop(ANIM_ROLL, 0.1f);
-				rolling_ = false;
-			}
-		}
-		else
+	if (sim_.IsDead())
+	{
+		Node* obstacle = 0;
+		if (sim_.GetHitItem() != M_MAX_UNSIGNED && level_)
+			obstacle = level_->GetTrackItem(sim_.GetNumBlocks() - 1, sim_.GetHitItem());
+		if (obstacle)
 		{
-			//LOGDEBUG("Stopping roll.");
-			animCtrl_->Stop(ANIM_ROLL, 0.1f);
-			//LOGDEBUG("Playing run.");
-			animCtrl_->Play(ANIM_RUN, 0, true, 0.2f);
-			// Set walk animation speed proportional to velocity
-			animCtrl_->SetSpeed(ANIM_RUN, planeVelocity.Length() * 0.3f);
+			// Create dead sound.
+			Sound* sound = GetSubsystem<ResourceCache>()->GetResource<Sound>("Sounds/BigExplosion.wav");
+			SoundSource* soundSource = node_->GetOrCreateComponent<SoundSource>();
+			soundSource->Play(sound);
+			soundSource->SetAutoRemove(true);
 		}
-	}
-	else
-	{
-		animCtrl_->Stop(ANIM_RUN, 0.2f);
+		Die(obstacle);
+		return;
 	}
 
-	// Reset grounded flag for next frame
-	onGround_ = false;
+	int side = sim_.GetLateral() < lateral ? -1 : (sim_.GetLateral() > lateral ? 1 : 0);
+	UpdateAnimations(side);
 }
 
 void Character::PostUpdate(float timeStep)
@@ -357,33 +185,9 @@ void Character::PostUpdate(float timeStep)
 	if (isDead_)
 		return;
 
-	// Remove closed points by character.
-	HashMap<unsigned, List<Vector3> >::Iterator it = runPath_.Find(CENTER_SIDE);
-	for (HashMap<unsigned, List<Vector3> >::Iterator it = runPath_.Begin(); it != runPath_.End(); ++it)
-	{
-		if (it->second_.Size() > 0)
-		{
-			Vector3 currentPoint = it->second_.Front();
-			Vector3 worldPos = GetNode()->GetWorldPosition();
-			currentPoint.y_ = worldPos.y_;
-			float length = (worldPos - currentPoint).Length();
-			if (length <= 1.0f)
-				RemoveFirstPoint();
-		}
-	}
-
-	if (1/*inTrigger_*/)
-	{
-		Quaternion rot = GetNode()->GetWorldRotation();
-		controls_.pitch_ = rot.PitchAngle();
-		controls_.yaw_ = rot.YawAngle();
-	}
-
-	//LOGDEBUG("Character y: " + String(node_->GetWorldPosition().y_));
-	//LOGDEBUG("PLatform y: " + String(currentBlock_->GetChild("Floor")->GetWorldPosition().y_));
-
-	//LOGDEBUG("Character Node Scale: " + GetNode()->GetWorldScale().ToString());
-	return;
+	Quaternion rot = GetNode()->GetWorldRotation();
+	controls_.pitch_ = rot.PitchAngle();
+	controls_.yaw_ = rot.YawAngle();
 }
 
 void Character::DrawDebugGeometry(DebugRenderer* debug, bool depthTest)
@@ -391,245 +195,269 @@ void Character::DrawDebugGeometry(DebugRenderer* debug, bool depthTest)
 	debug->AddSphere(Sphere(Vector3::ONE, 10.0f), Color(1, 1, 1));
 }
 
-void Character::HandleNodeCollision(StringHash eventType, VariantMap& eventData)
+void Character::OnFixedStep(const StepEvent& event)
 {
-	// Check collision contacts and see if character is standing on ground (look for a contact that has near vertical normal)
-	using namespace NodeCollision;
-	
-	MemoryBuffer contacts(eventData[P_CONTACTS].GetBuffer());
-	Node* otherNode = reinterpret_cast<Node*>(eventData[P_OTHERNODE].GetPtr());
-
-	// Check turn point
-	Variant var = otherNode->GetVar(GameVariants::P_TURNPOINT);
-	if (!var.IsEmpty())
-	{
-		turnRequest_ = var.GetBool() && (turnState_ != NO_SUCCEEDED);
-	}
-
-	// Get coin points
-	var = otherNode->GetVar(GameVariants::P_POINT);
-	if (!var.IsEmpty())
-	{
-		score_ += var.GetInt();
-		// Create hit sound.
-		Sound* sound = GetSubsystem<ResourceCache>()->GetResource<Sound>("Sounds/NutThrow.wav");
-		SoundSource* soundSource = node_->GetOrCreateComponent<SoundSource>();
-		soundSource->Play(sound);
-		soundSource->SetAutoRemove(true);
-		otherNode->Remove();
-	}
-
-    while (!contacts.IsEof())
-    {
-        Vector3 contactPosition = contacts.ReadVector3();
-        Vector3 contactNormal = contacts.ReadVector3();
-        float contactDistance = contacts.ReadFloat();
-        float contactImpulse = contacts.ReadFloat();
-
-        // If contact is below node center and mostly vertical, assume it's a ground contact
-        if (contactPosition.y_ < (GetNode()->GetPosition().y_ + 1.0f))
-        {
-			float level = Abs(contactNormal.y_);
-            if (level > 0.75)
-                onGround_ = true;
-        }
-    }
+	FixedUpdate(event.timeStep_);
 }
 
-void Character::HandleNodeCollisionStart(StringHash eventType, VariantMap& eventData)
+void Character::Die(Node* obstacle)
 {
-	using namespace NodeCollisionStart;
-
-	Node* otherNode = reinterpret_cast<Node*>(eventData[P_OTHERNODE].GetPtr());
-
-	// Check turn point
-	Variant var = otherNode->GetVar(GameVariants::P_TURNPOINT);
-	if (!var.IsEmpty())
-	{
-		turnRequest_ = var.GetBool() && (turnState_ != NO_SUCCEEDED);
-		inTrigger_ = true;
-	}
+	isDead_ = true;
 
-	// Check current platform.
-	var = otherNode->GetVar(GameVariants::P_ISINPLATFORM);
-	if (!var.IsEmpty())
-	{
-		Node* enteringBlock = otherNode->GetParent()->GetParent()->GetParent();
+	DeathEvent death;
+	death.obstacle_ = obstacle;
+	death.score_ = sim_.GetScore();
+	events_->death_.Send(death);
+}
 
-		if (currentBlock_)
-		{
-			if (currentBlock_->GetID() != enteringBlock->GetID())
-				passedBlocks_.Push(currentBlock_);
-		}
+void Character::UpdateTransform(float timeStep)
+{
+	Vector3 position;
+	Vector3 direction;
+	if (!level_ || !level_->GetTrackTransform(sim_.GetNumBlocks() - 1, sim_.GetBlockDistance().ToFloat(),
+		sim_.GetLateral().ToFloat(), position, direction))
+		return;
 
-		currentBlock_ = enteringBlock;
-	}
+	Node* node = GetNode();
+	position.y_ += sim_.GetHeight().ToFloat();
+	node->SetWorldPosition(position);
 
-	// Check obstacles.
-	var = otherNode->GetVar(GameVariants::P_ISOBSTACLE);
-	if (!var.IsEmpty())
-	{
-		// Create dead sound.
-		Sound* sound = GetSubsystem<ResourceCache>()->GetResource<Sound>("Sounds/BigExplosion.wav");
-		SoundSource* soundSource = node_->GetOrCreateComponent<SoundSource>();
-		soundSource->Play(sound);
-		soundSource->SetAutoRemove(true);
-		isDead_ = true;
-	}
+	// Turn by the scene's smoothing rate for one step here, rather than leaving it to the per-frame smoothing update, so that
+	// the heading only depends on the fixed steps
+	Quaternion targetRotation;
+	targetRotation.FromLookRotation(direction);
+	float constant = 1.0f - Clamp(powf(2.0f, -timeStep * GetScene()->GetSmoothingConstant()), 0.0f, 1.0f);
+	node->SetWorldRotation(node->GetWorldRotation().Slerp(targetRotation, constant));
 }
 
-void Character::HandleNodeCollisionEnd(StringHash eventType, VariantMap& eventData)
+void Character::UpdateAnimations(int side)
 {
-	using namespace NodeCollisionEnd;
+	bool onGround = sim_.IsOnGround();
 
-	Node* otherNode = reinterpret_cast<Node*>(eventData[P_OTHERNODE].GetPtr());
-	// Check turn point
-	Variant var = otherNode->GetVar(GameVariants::P_TURNPOINT);
-	if (!var.IsEmpty())
+	// A jump leaves the ground going up, anything else on the ground keeps running
+	if (!onGround && jumpState_ == STOP_JUMPING && sim_.GetVerticalSpeed().GetRaw() > 0)
 	{
-		turnRequest_ = false;
-		inTrigger_ = false;
+		StopAnim(ANIM_RUN, 0.2f);
+		animCtrl_->Play(ANIM_JUMP_START.GetString(), 0, false, 0.2f);
+		jumpState_ = START_JUMPING;
 	}
-}
 
-bool Character::CheckSide(int control)
-{
-	switch (control)
+	if (jumpState_ == START_JUMPING || jumpState_ == LOOP_JUMPING)
 	{
-	case CTRL_LEFT:
+		float minJmpLoop = 0.4f;
+		float minDistance = 0.1f;
+		float height = sim_.GetHeight().ToFloat();
+		if (height < minJmpLoop)
 		{
-			switch (currentSide_)
+			if (jumpState_ == START_JUMPING)
+			{
+				animCtrl_->Play(ANIM_JUMP_START.GetString(), 0, false, 0.2f);
+				// A jump cut short by a roll lands before it ever loops
+				if (onGround)
+					jumpState_ = STOP_JUMPING;
+			}
+			else if (jumpState_ == LOOP_JUMPING)
 			{
-			case LEFT_SIDE:
-				return false;
-			case RIGHT_SIDE:
-				currentSide_ = CENTER_SIDE;
-				break;
-			case CENTER_SIDE:
-				currentSide_ = LEFT_SIDE;
-				break;
+				StopAnim(ANIM_JUMP_LOOP, 0.2f);
+				animCtrl_->Play(ANIM_JUMP_END.GetString(), 0, false, 0.2f);
+
+				if (height < minDistance)
+					jumpState_ = STOP_JUMPING;
 			}
 		}
-		break;
-	case CTRL_RIGHT:
+		else
 		{
-			switch (currentSide_)
+			if (jumpState_ == START_JUMPING)
 			{
-			case LEFT_SIDE:
-				currentSide_ = CENTER_SIDE;
-				break;
-			case RIGHT_SIDE:
-				return false;
-			case CENTER_SIDE:
-				currentSide_ = RIGHT_SIDE;
-				break;
+				StopAnim(ANIM_JUMP_START, 0.2f);
+				jumpState_ = LOOP_JUMPING;
+			}
+			else if (side < 0)
+			{
+				StopAnim(ANIM_JUMP_LOOP, 0.2f);
+				animCtrl_->Play(ANIM_JUMP_LEFT.GetString(), 0, false, 0.2f);
+			}
+			else if (side > 0)
+			{
+				StopAnim(ANIM_JUMP_LOOP, 0.2f);
+				animCtrl_->Play(ANIM_JUMP_RIGHT.GetString(), 0, false, 0.2f);
+			}
+			else
+			{
+				if (IsPlayedAnim(ANIM_JUMP_LEFT))
+					StopAnim(ANIM_JUMP_LEFT, 0.1f);
+				if (IsPlayedAnim(ANIM_JUMP_RIGHT))
+					StopAnim(ANIM_JUMP_RIGHT, 0.1f);
+
+				animCtrl_->Play(ANIM_JUMP_LOOP.GetString(), 0, true, 0.2f);
+				animCtrl_->SetSpeed(ANIM_JUMP_LOOP.GetString(), 0.4f);
 			}
 		}
-		break;
-	default:
-		return false;
 	}
 
-	return true;
-}
-
-void Character::AddToPath(CharacterSide side, const List<Vector3>& points)
-{
-	if (points.Empty())
-		return;
+	// Play walk animation if moving on ground, otherwise fade it out
+	if (jumpState_ == STOP_JUMPING && onGround)
+	{
+		if (rolling_)
+		{
+			StopAnim(ANIM_RUN, 0.2f);
+			animCtrl_->Play(ANIM_ROLL.GetString(), 0, false, 0.1f);
+			animCtrl_->SetSpeed(ANIM_ROLL.GetString(), 0.6f);
 
-	HashMap<unsigned, List<Vector3> >::Iterator it = runPath_.Find(side);
-	if (it == runPath_.End())
-		runPath_[side] = points;
+			if (IsPlayedAnim(ANIM_ROLL))
+			{
+				StopAnim(ANIM_ROLL, 0.1f);
+				rolling_ = false;
+			}
+		}
+		else
+		{
+			StopAnim(ANIM_ROLL, 0.1f);
+			animCtrl_->Play(ANIM_RUN.GetString(), 0, true, 0.2f);
+			// Set walk animation speed proportional to velocity
+			animCtrl_->SetSpeed(ANIM_RUN.GetString(), sim_.GetSpeed().ToFloat() * 0.3f);
+		}
+	}
 	else
-		it->second_.Insert(it->second_.End(), points);
-}
-
-bool Character::GetCurrentPoint(Vector3& point)
-{
-	HashMap<unsigned, List<Vector3> >::Iterator it = runPath_.Find(currentSide_);
-	if (it->second_.Size() == 0)
-		return false;
-
-	point = it->second_.Front();
-	return true;
-}
-
-void Character::RemoveFirstPoint()
-{
-	runPath_[LEFT_SIDE].PopFront();
-	runPath_[RIGHT_SIDE].PopFront();
-	runPath_[CENTER_SIDE].PopFront();
+	{
+		StopAnim(ANIM_RUN, 0.2f);
+	}
 }
 
-void Character::FollowPath(float timeStep)
+void Character::StartRun(RunnerLevel* level)
 {
-	Vector3 nextWaypoint = Vector3::ZERO; 
-	if (GetCurrentPoint(nextWaypoint)) {
-		nextWaypoint.y_ = GetNode()->GetWorldPosition().y_;
-		Vector3 targetPos = nextWaypoint - GetNode()->GetWorldPosition();
-		Quaternion targetRotation;
-		targetRotation.FromLookRotation(targetPos);
-		SmoothedTransform* smooth = GetNode()->GetComponent<SmoothedTransform>();
-		float yaw = targetRotation.YawAngle();
-		float minYaw = -178.0f;
-		float maxYaw = 178.0f;
-		//LOGDEBUG("Target Yaw Angle: " + String(yaw));
-		yaw = Urho3D::Clamp(yaw, minYaw, maxYaw);
-		float absYaw = Urho3D::Abs(yaw);
-		if ((absYaw > 0 && absYaw < 1) || yaw == minYaw || yaw == maxYaw)
-			yaw = 0;
-
-		if (!targetRotation.IsNaN() && yaw)
-		{
-			//targetRotation = GetNode()->GetParent()->GetWorldRotation().Inverse() * targetRotation;
-			//GetNode()->SetRotation(targetRotation);
-			smooth->SetTargetWorldRotation(targetRotation);
-			//GetNode()->LookAt(nextWaypoint);
-		}
+	level_ = level;
+	rolling_ = false;
+	isDead_ = false;
+	stepActions_ = 0;
+	jumpState_ = STOP_JUMPING;
+	commands_.Clear();
+	controls_.Set(CTRL_FORWARD | CTRL_LEFT | CTRL_RIGHT | CTRL_BACK | CTRL_JUMP, false);
+	if (animCtrl_)
+		animCtrl_->StopAll();
+
+	sim_.Start(&level->GetSimKit(), level);
+
+	// Start at the beginning of the first block, facing along it
+	Vector3 position;
+	Vector3 direction;
+	if (level->GetTrackTransform(0, 0.0f, 0.0f, position, direction))
+	{
+		Quaternion rotation;
+		rotation.FromLookRotation(direction);
+		GetNode()->SetWorldPosition(position);
+		GetNode()->SetWorldRotation(rotation);
 	}
 }
 
-bool Character::HasTurnRequest()
+void Character::SaveRun(Serializer& dest)
 {
-	if (!turnRequest_)
-		return false;
-
-	bool success = false;
-	int outs = currentBlock_->GetVar(GameVariants::P_OUT).GetInt();
-	if (outs > 0) {
-		bool leftOut = currentBlock_->GetVar(GameVariants::P_LEFTOUT).GetBool();
-		bool rightOut = currentBlock_->GetVar(GameVariants::P_RIGHTOUT).GetBool();
-
-		success = (leftOut && turnState_ == LEFT_SUCCEEDED) || (rightOut && turnState_ == RIGHT_SUCCEEDED);
+	Node* node = GetNode();
+	dest.WriteVector3(node->GetPosition());
+	dest.WriteQuaternion(node->GetRotation());
+
+	sim_.Save(dest);
+	dest.WriteUByte((rolling_ ? 1 : 0) | (isDead_ ? 2 : 0));
+	dest.WriteUByte(jumpState_);
+	dest.WriteUInt(controls_.buttons_);
+	dest.WriteFloat(controls_.yaw_);
+	dest.WriteFloat(controls_.pitch_);
+
+	// The animations attribute lists each animation by name among its other values
+	VariantVector animations = animCtrl_->GetAnimationsAttr();
+	PODVector<const String*> names;
+	for (unsigned i = 0; i < animations.Size(); ++i)
+	{
+		if (animations[i].GetType() == VAR_STRING)
+			names.Push(&animations[i].GetString());
+	}
+	dest.WriteVLE(names.Size());
+	for (unsigned i = 0; i < names.Size(); ++i)
+	{
+		const String& name = *names[i];
+		dest.WriteString(name);
+		dest.WriteUByte(animCtrl_->GetLayer(name));
+		dest.WriteBool(animCtrl_->IsLooped(name));
+		dest.WriteFloat(animCtrl_->GetTime(name));
+		dest.WriteFloat(animCtrl_->GetWeight(name));
+		dest.WriteFloat(animCtrl_->GetSpeed(name));
+		dest.WriteFloat(animCtrl_->GetFadeTarget(name));
+		dest.WriteFloat(animCtrl_->GetFadeTime(name));
 	}
-
-	return success;
 }
 
-void Character::RemovePassedBlocks()
+bool Character::LoadRun(Deserializer& source, RunnerLevel* level)
 {
-	if (passedBlocks_.Size() <= 0)
-		return;
-
-	for (PODVector<Node*>::Iterator it = passedBlocks_.Begin(); it != passedBlocks_.End(); ++it)
+	// The level has restored the track cursor already, the simulation is read rather than started on it
+	level_ = level;
+	commands_.Clear();
+	stepActions_ = 0;
+	// A character created for the restore has not had its delayed start yet
+	if (!animCtrl_)
+		animCtrl_ = GetNode()->GetChild(NODE_PLAYER_MODEL.GetHash())->GetComponent<AnimationController>();
+	animCtrl_->StopAll();
+
+	Vector3 position = source.ReadVector3();
+	Quaternion rotation = source.ReadQuaternion();
+	GetNode()->SetPosition(position);
+	GetNode()->SetRotation(rotation);
+
+	if (!sim_.Load(source, &level->GetSimKit(), level))
+		return false;
+	unsigned char flags = source.ReadUByte();
+	rolling_ = (flags & 1) != 0;
+	isDead_ = (flags & 2) != 0;
+	jumpState_ = (JumpState)source.ReadUByte();
+	controls_.buttons_ = source.ReadUInt();
+	controls_.yaw_ = source.ReadFloat();
+	controls_.pitch_ = source.ReadFloat();
+
+	unsigned numAnimations = source.ReadVLE();
+	for (unsigned i = 0; i < numAnimations && !source.IsEof(); ++i)
 	{
-		Node* passedBlock = *it;
-		passedBlock->Remove();
+		String name = source.ReadString();
+		unsigned char layer = source.ReadUByte();
+		bool looped = source.ReadBool();
+		float time = source.ReadFloat();
+		float weight = source.ReadFloat();
+		float speed = source.ReadFloat();
+		float fadeTarget = source.ReadFloat();
+		float fadeTime = source.ReadFloat();
+
+		animCtrl_->Play(name, layer, looped, 0.0f);
+		animCtrl_->SetTime(name, time);
+		animCtrl_->SetWeight(name, weight);
+		animCtrl_->SetSpeed(name, speed);
+		if (fadeTime > 0.0f)
+			animCtrl_->Fade(name, fadeTarget, fadeTime);
 	}
 
-	passedBlocks_.Clear();
+	return true;
 }
 
-bool Character::IsPlayedAnim(const String& name) const
+bool Character::IsPlayedAnim(const GameId& anim) const
 {
 	bool played = false;
 
-	if (animCtrl_->IsPlaying(name))
+	AnimationState* state = animCtrl_->GetAnimationState(anim.GetHash());
+	if (state)
 	{
-		float diff = animCtrl_->GetLength(name) - animCtrl_->GetTime(name);
+		float diff = state->GetLength() - state->GetTime();
 		played = (diff == 0);
 	}
 
 	return played;
 }
+
+bool Character::IsPlayingAnim(const GameId& anim) const
+{
+	// The controller removes the state of an animation together with its control entry
+	return animCtrl_->GetAnimationState(anim.GetHash()) != 0;
+}
+
+void Character::StopAnim(const GameId& anim, float fadeOutTime)
+{
+	// Most stops are for animations that are not playing, those skip the controller's search by name
+	if (IsPlayingAnim(anim))
+		animCtrl_->Stop(anim.GetString(), fadeOutTime);
+}
@@ -23,16 +23,23 @@
 #pragma once
 
 #include "Controls.h"
+#include "GameIds.h"
 #include "LogicComponent.h"
-#include "List.h"
+#include "RunnerSim.h"
 
 #define BIT(x) (1<<(x))
 
 namespace Urho3D
 {
 	class AnimationController;
+	class Deserializer;
+	class Serializer;
 }
 
+class GameEventHub;
+class RunnerLevel;
+struct StepEvent;
+
 using namespace Urho3D;
 
 const int CTRL_FORWARD = BIT(0);
@@ -41,28 +48,12 @@ const int CTRL_LEFT = BIT(2);
 const int CTRL_RIGHT = BIT(3);
 const int CTRL_JUMP = BIT(4);
 
-const float MOVE_FORCE = 1.3f;
-const float MOVE_SIDE_FORCE = 13.0f;
-const float MOVE_SIDE_AIR_FORCE = 120.0f;
-const float INAIR_MOVE_FORCE = 0.02f;
-const float BRAKE_FORCE = 0.2f;
-const float JUMP_FORCE = 5.0f;
 const float YAW_SENSITIVITY = 0.1f;
-const float INAIR_THRESHOLD_TIME = 0.1f;
 
 const unsigned int FLOOR_COLLISION_MASK = BIT(1);
 const unsigned int COIN_COLLISION_MASK = BIT(2);
 const unsigned int OBSTACLE_COLLISION_MASK = BIT(3);
 
-const String ANIM_RUN = "Models/vempire_run.ani";
-const String ANIM_ROLL = "Models/vempire_roll.ani";
-const String ANIM_DEATH = "Models/vempire_death.ani";
-const String ANIM_JUMP_END = "Models/vempire_jmpEnd.ani";
-const String ANIM_JUMP_LEFT = "Models/vempire_jmpLeft.ani";
-const String ANIM_JUMP_LOOP = "Models/vempire_jmpLoop.ani";
-const String ANIM_JUMP_START = "Models/vempire_jmpStart.ani";
-const String ANIM_JUMP_RIGHT = "Models/vempire_jmpRight.ani";
-
 enum CharacterSide
 {
 	LEFT_SIDE = 0,
@@ -77,18 +68,35 @@ enum JumpState
 	STOP_JUMPING
 };
 
-enum TurnState
+/// Edge-triggered action buffer. Actions accumulate between physics steps and are consumed exactly once.
+class CommandBuffer
 {
-	NO_SUCCEEDED = 0,
-	LEFT_SUCCEEDED,
-	RIGHT_SUCCEEDED,
-	SIDE_LEFT_SUCCEEDED,
-	SIDE_RIGHT_SUCCEEDED
-};
+public:
+	/// Construct empty.
+	CommandBuffer() :
+		pending_(0)
+	{
+	}
+
+	/// Queue action control bits.
+	void Push(int actions) { pending_ |= actions; }
+	/// Return and clear the queued actions.
+	int Consume()
+	{
+		int actions = pending_;
+		pending_ = 0;
+		return actions;
+	}
+	/// Drop the queued actions.
+	void Clear() { pending_ = 0; }
 
-typedef HashMap<unsigned, List<Vector3> > RunPath;
+private:
+	/// Queued control bits.
+	int pending_;
+};
 
-/// Character component, responsible for physical movement according to controls, as well as animation.
+/// Character component. Runs the deterministic simulation on the level's track, places the node where the simulation is and
+/// animates it. Pickups and hits come from the simulation, not from physics, so the race server and ghosts replay the same run.
 class Character : public LogicComponent
 {
     OBJECT(Character)
@@ -102,65 +110,70 @@ public:
 	/// Register object factory and attributes.
 	static void RegisterObject(Context* context);
 
-	/// Handle startup. Called by LogicComponent base class. Creates model and loads animations.
+	/// Handle startup. Called by LogicComponent base class. Finds the animation controller.
 	virtual void Start();
-	/// Handle stop. Called by LogicComponent base class. Destruction this component.
-	virtual void Stop();
-	/// Handle physics world update. Called by LogicComponent base class.
+	/// Handle a fixed step. Steps the simulation and follows it with the node and the animations.
 	virtual void FixedUpdate(float timeStep);
 	/// Handle scene post-update, Called by LogicCOmponent base class.
 	virtual void PostUpdate(float timeStep);
 	/// Visualize the component as debug geometry.
 	virtual void DrawDebugGeometry(DebugRenderer* debug, bool depthTest);
 
-    /// Movement controls. Assigned by the main program each frame.
+    /// Movement controls. Assigned by the main program each frame. Only held state (forward) is read from here.
     Controls controls_;
 
-	void FollowPath(float timeStep);
-	bool HasTurnRequest();
-	bool GetCurrentPoint(Vector3& point);
-	void RemoveFirstPoint();
-	void RemovePassedBlocks();
-	void AddToPath(CharacterSide side, const List<Vector3>& points);
-
-	int GetScore() { return score_; }
-	CharacterSide GetSide() { return currentSide_; }
-	unsigned int GetNumPoints() { return runPath_[currentSide_].Size(); }
-	TurnState GetTurnState() { return turnState_; }
-	Node* GetCurrentBlock() { return currentBlock_; }
-	bool IsDead() { return isDead_; }
-	bool OnGround() { return onGround_; }
-	void SetCurrentPlatform(Node* platform) { currentBlock_ = platform; }
+	/// Set the gameplay event channels. Defaults to the GameEventHub subsystem, a hub of its own keeps the character apart from others in the process.
+	void SetEventHub(GameEventHub* hub);
+	/// Queue edge-triggered actions (lane change, jump, roll) for the next physics step.
+	void QueueActions(int actions) { commands_.Push(actions); }
+
+	/// Bring the character back to life with a fresh score and start a run on the level's track. Keeps the node and its
+	/// components.
+	void StartRun(RunnerLevel* level);
+	/// Write the simulation, controls and animation state for a snapshot.
+	void SaveRun(Serializer& dest);
+	/// Read the state written by SaveRun for a run on the level's track. Return false if the data is malformed.
+	bool LoadRun(Deserializer& source, RunnerLevel* level);
+
+	/// Return the simulation of the run.
+	const RunnerSim& GetSim() const { return sim_; }
+	int GetScore() const { return sim_.GetScore(); }
+	int GetNumCoins() const { return sim_.GetNumCoins(); }
+	/// Return the actions handled by the last physics step.
+	int GetStepActions() const { return stepActions_; }
+	float GetDistance() const { return sim_.GetDistance(); }
+	bool IsDead() const { return isDead_; }
+	bool OnGround() const { return sim_.IsOnGround(); }
 
 private:
-    /// Handle physics collision events.
-	void HandleNodeCollision(StringHash eventType, VariantMap& eventData);
-	void HandleNodeCollisionStart(StringHash eventType, VariantMap& eventData);
-	void HandleNodeCollisionEnd(StringHash eventType, VariantMap& eventData);
-
-    /// Grounded flag for movement.
-    bool onGround_;
-    /// In air timer. Due to possible physics inaccuracy, character can be off ground for max. 1/10 second and still be allowed to move.
-    float inAirTimer_;
-
-	/// Game mechanics.
-	bool CheckSide(int control);
-	bool IsPlayedAnim(const String& name) const;
-
-	int score_;
-	bool turnRequest_;
-	bool inTrigger_;
-	bool onJumpGround_;
+	/// Handle typed events.
+	void OnFixedStep(const StepEvent& event);
+	/// Kill the character. Obstacle is null when the run ended otherwise.
+	void Die(Node* obstacle);
+	/// Move the node to the simulated position, turning toward the track's heading by the scene's smoothing rate.
+	void UpdateTransform(float timeStep);
+	/// Play the animations of the simulated state. Side is the direction of a lane change in progress.
+	void UpdateAnimations(int side);
+
+	bool IsPlayedAnim(const GameId& anim) const;
+	/// Return whether an animation is playing. Looks up the animation state by hash instead of the controller by name.
+	bool IsPlayingAnim(const GameId& anim) const;
+	/// Fade out an animation if it is playing.
+	void StopAnim(const GameId& anim, float fadeOutTime);
+
+	/// Deterministic state of the run.
+	RunnerSim sim_;
+	/// Level whose track the run is on.
+	WeakPtr<RunnerLevel> level_;
 	bool rolling_;
 	bool isDead_;
+	/// Actions queued since the last physics step.
+	CommandBuffer commands_;
+	/// Actions handled by the last physics step.
+	int stepActions_;
 
 	AnimationController* animCtrl_;
-	CharacterSide currentSide_;
+	/// Gameplay event channels.
+	GameEventHub* events_;
 	JumpState jumpState_;
-	TurnState turnState_;
-
-	RunPath runPath_;
-	Node* currentBlock_;
-	PODVector<Node*> passedBlocks_;
-
 };
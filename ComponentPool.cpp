@@ -0,0 +1,52 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "CollisionShape.h"
+#include "ComponentPool.h"
+#include "Context.h"
+#include "Log.h"
+#include "RigidBody.h"
+#include "StaticModel.h"
+
+/// Log the statistics of one pool.
+template <class T> static void LogPool()
+{
+	const ComponentPoolStats& stats = Pooled<T>::GetStats();
+	LOGINFO(T::GetTypeNameStatic() + " pool: " + String(stats.live_) + " live, " + String(stats.peak_) + " peak, " +
+		String(stats.total_) + " allocated, " + String(Pooled<T>::GetReservedBytes() / 1024) + " kB reserved");
+}
+
+void RegisterComponentPools(Context* context)
+{
+	// A factory of the same type replaces the engine's, so scene loading and CreateComponent() allocate from the pools
+	context->RegisterFactory<Pooled<StaticModel> >();
+	context->RegisterFactory<Pooled<RigidBody> >();
+	context->RegisterFactory<Pooled<CollisionShape> >();
+}
+
+void LogComponentPools()
+{
+	LogPool<StaticModel>();
+	LogPool<RigidBody>();
+	LogPool<CollisionShape>();
+}
@@ -0,0 +1,102 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "Allocator.h"
+#include "Object.h"
+
+#include <cassert>
+
+using namespace Urho3D;
+
+/// Objects the first block of a component pool holds. Later blocks grow by half the capacity so far.
+static const unsigned COMPONENT_POOL_CAPACITY = 256;
+
+/// Statistics of a component pool.
+struct ComponentPoolStats
+{
+	/// Objects alive.
+	unsigned live_;
+	/// Most objects alive at once.
+	unsigned peak_;
+	/// Objects allocated since the start.
+	unsigned total_;
+};
+
+/// Component of an engine type allocated from a fixed-size pool of its own instead of the heap. Declares no type of its own,
+/// so scene files, GetComponent<T>() and the registered attributes see the engine type. Main thread only, like the scene.
+template <class T> class Pooled : public T
+{
+public:
+	/// Construct.
+	Pooled(Context* context) :
+		T(context)
+	{
+	}
+
+	/// Allocate from the pool.
+	static void* operator new(size_t size)
+	{
+		assert(size == sizeof(Pooled<T>));
+		if (!allocator_)
+			allocator_ = AllocatorInitialize(sizeof(Pooled<T>), COMPONENT_POOL_CAPACITY);
+		if (++stats_.live_ > stats_.peak_)
+			stats_.peak_ = stats_.live_;
+		++stats_.total_;
+		return AllocatorReserve(allocator_);
+	}
+
+	/// Return to the pool. The pool's blocks are kept for the next objects.
+	static void operator delete(void* object)
+	{
+		AllocatorFree(allocator_, object);
+		--stats_.live_;
+	}
+
+	/// Return the statistics.
+	static const ComponentPoolStats& GetStats() { return stats_; }
+	/// Return the bytes reserved by the pool's blocks.
+	static unsigned GetReservedBytes()
+	{
+		unsigned bytes = 0;
+		for (AllocatorBlock* block = allocator_; block; block = block->next_)
+			bytes += block->capacity_ * (sizeof(AllocatorNode) + block->nodeSize_);
+		return bytes;
+	}
+
+private:
+	/// Allocator blocks.
+	static AllocatorBlock* allocator_;
+	/// Statistics.
+	static ComponentPoolStats stats_;
+};
+
+template <class T> AllocatorBlock* Pooled<T>::allocator_ = 0;
+template <class T> ComponentPoolStats Pooled<T>::stats_;
+
+/// Replace the engine's factories of the common block component types (StaticModel, RigidBody, CollisionShape) with pooled
+/// ones. Call after the engine has registered its libraries and before any scene content is loaded.
+void RegisterComponentPools(Context* context);
+/// Log the statistics of the component pools.
+void LogComponentPools();
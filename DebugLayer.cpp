@@ -0,0 +1,193 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "BoundingBox.h"
+#include "CustomGeometry.h"
+#include "DebugLayer.h"
+#include "Material.h"
+#include "ResourceCache.h"
+#include "Scene.h"
+#include "Sphere.h"
+#include "Technique.h"
+
+/// Segments of a sphere circle.
+static const unsigned SPHERE_SEGMENTS = 16;
+
+DebugLayer::DebugLayer(Context* context) :
+	Object(context),
+	current_(M_MAX_UNSIGNED),
+	numLines_(0),
+	visible_(false)
+{
+}
+
+void DebugLayer::SetScene(Scene* scene)
+{
+	if (node_)
+		node_->Remove();
+
+	owners_.Clear();
+	lineCounts_.Clear();
+	current_ = M_MAX_UNSIGNED;
+	numLines_ = 0;
+
+	if (!scene)
+		return;
+
+	SharedPtr<Material> material(new Material(context_));
+	material->SetTechnique(0, GetSubsystem<ResourceCache>()->GetResource<Technique>("Techniques/NoTextureUnlitVCol.xml"));
+
+	node_ = scene->CreateChild("DebugLayer", LOCAL);
+	geometry_ = node_->CreateComponent<CustomGeometry>(LOCAL);
+	geometry_->SetMaterial(material);
+	node_->SetEnabled(visible_);
+}
+
+void DebugLayer::SetVisible(bool enable)
+{
+	visible_ = enable;
+	if (node_)
+		node_->SetEnabled(visible_);
+}
+
+void DebugLayer::BeginSet(StringHash owner)
+{
+	if (!geometry_)
+		return;
+
+	current_ = GetGeometryIndex(owner);
+	numLines_ -= lineCounts_[current_];
+	lineCounts_[current_] = 0;
+	geometry_->BeginGeometry(current_, LINE_LIST);
+}
+
+void DebugLayer::AddLine(const Vector3& start, const Vector3& end, const Color& color)
+{
+	if (current_ == M_MAX_UNSIGNED)
+		return;
+
+	geometry_->DefineVertex(start);
+	geometry_->DefineColor(color);
+	geometry_->DefineVertex(end);
+	geometry_->DefineColor(color);
+	++lineCounts_[current_];
+}
+
+void DebugLayer::AddPolyline(const Vector3* points, unsigned count, const Color& color)
+{
+	for (unsigned i = 1; i < count; ++i)
+		AddLine(points[i - 1], points[i], color);
+}
+
+void DebugLayer::AddBoundingBox(const BoundingBox& box, const Color& color)
+{
+	const Vector3& min = box.min_;
+	const Vector3& max = box.max_;
+
+	Vector3 v1(max.x_, min.y_, min.z_);
+	Vector3 v2(max.x_, max.y_, min.z_);
+	Vector3 v3(min.x_, max.y_, min.z_);
+	Vector3 v4(min.x_, min.y_, max.z_);
+	Vector3 v5(max.x_, min.y_, max.z_);
+	Vector3 v6(min.x_, max.y_, max.z_);
+
+	AddLine(min, v1, color);
+	AddLine(v1, v2, color);
+	AddLine(v2, v3, color);
+	AddLine(v3, min, color);
+	AddLine(v4, v5, color);
+	AddLine(v5, max, color);
+	AddLine(max, v6, color);
+	AddLine(v6, v4, color);
+	AddLine(min, v4, color);
+	AddLine(v1, v5, color);
+	AddLine(v2, max, color);
+	AddLine(v3, v6, color);
+}
+
+void DebugLayer::AddSphere(const Sphere& sphere, const Color& color)
+{
+	const Vector3& center = sphere.center_;
+	float radius = sphere.radius_;
+	float step = 360.0f / SPHERE_SEGMENTS;
+
+	for (unsigned i = 0; i < SPHERE_SEGMENTS; ++i)
+	{
+		float a1 = i * step;
+		float a2 = a1 + step;
+		float c1 = Cos(a1) * radius, s1 = Sin(a1) * radius;
+		float c2 = Cos(a2) * radius, s2 = Sin(a2) * radius;
+
+		AddLine(center + Vector3(c1, s1, 0.0f), center + Vector3(c2, s2, 0.0f), color);
+		AddLine(center + Vector3(c1, 0.0f, s1), center + Vector3(c2, 0.0f, s2), color);
+		AddLine(center + Vector3(0.0f, c1, s1), center + Vector3(0.0f, c2, s2), color);
+	}
+}
+
+void DebugLayer::EndSet()
+{
+	if (current_ == M_MAX_UNSIGNED)
+		return;
+
+	numLines_ += lineCounts_[current_];
+	current_ = M_MAX_UNSIGNED;
+	geometry_->Commit();
+}
+
+void DebugLayer::ClearSet(StringHash owner)
+{
+	HashMap<StringHash, unsigned>::ConstIterator it = owners_.Find(owner);
+	if (it == owners_.End() || !geometry_)
+		return;
+
+	BeginSet(owner);
+	EndSet();
+}
+
+void DebugLayer::Clear()
+{
+	if (!geometry_)
+		return;
+
+	for (HashMap<StringHash, unsigned>::ConstIterator i = owners_.Begin(); i != owners_.End(); ++i)
+	{
+		geometry_->BeginGeometry(i->second_, LINE_LIST);
+		lineCounts_[i->second_] = 0;
+	}
+
+	numLines_ = 0;
+	geometry_->Commit();
+}
+
+unsigned DebugLayer::GetGeometryIndex(StringHash owner)
+{
+	HashMap<StringHash, unsigned>::ConstIterator it = owners_.Find(owner);
+	if (it != owners_.End())
+		return it->second_;
+
+	unsigned index = lineCounts_.Size();
+	owners_[owner] = index;
+	lineCounts_.Push(0);
+	geometry_->SetNumGeometries(index + 1);
+	return index;
+}
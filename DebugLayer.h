@@ -0,0 +1,95 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "Color.h"
+#include "HashMap.h"
+#include "Object.h"
+
+using namespace Urho3D;
+
+namespace Urho3D
+{
+	class BoundingBox;
+	class CustomGeometry;
+	class Node;
+	class Scene;
+	class Sphere;
+}
+
+/// Retained debug geometry. Each owner keeps a set of lines that is uploaded once into a vertex buffer and drawn like any other
+/// geometry until the owner replaces it. Hidden layers are not drawn and owners are expected to skip building their sets.
+class DebugLayer : public Object
+{
+	OBJECT(DebugLayer);
+
+public:
+	/// Construct.
+	DebugLayer(Context* context);
+
+	/// Set the scene to draw into. Drops all sets.
+	void SetScene(Scene* scene);
+	/// Show or hide.
+	void SetVisible(bool enable);
+	/// Start replacing the set of an owner. The previous lines of the owner are dropped.
+	void BeginSet(StringHash owner);
+	/// Add a line to the set being built.
+	void AddLine(const Vector3& start, const Vector3& end, const Color& color);
+	/// Add a polyline to the set being built.
+	void AddPolyline(const Vector3* points, unsigned count, const Color& color);
+	/// Add the edges of a box to the set being built.
+	void AddBoundingBox(const BoundingBox& box, const Color& color);
+	/// Add three circles of a sphere to the set being built.
+	void AddSphere(const Sphere& sphere, const Color& color);
+	/// Upload the set being built.
+	void EndSet();
+	/// Drop the set of an owner.
+	void ClearSet(StringHash owner);
+	/// Drop all sets.
+	void Clear();
+
+	/// Return whether visible.
+	bool IsVisible() const { return visible_; }
+	/// Return number of lines uploaded.
+	unsigned GetNumLines() const { return numLines_; }
+
+private:
+	/// Return the geometry index of an owner, adding one if needed.
+	unsigned GetGeometryIndex(StringHash owner);
+
+	/// Node holding the geometry.
+	WeakPtr<Node> node_;
+	/// Line geometry, one geometry per owner.
+	WeakPtr<CustomGeometry> geometry_;
+	/// Geometry index of each owner.
+	HashMap<StringHash, unsigned> owners_;
+	/// Line counts of each geometry.
+	PODVector<unsigned> lineCounts_;
+	/// Geometry being built.
+	unsigned current_;
+	/// Total lines uploaded.
+	unsigned numLines_;
+	/// Visible flag.
+	bool visible_;
+};
@@ -0,0 +1,108 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <cmath>
+
+/// Fraction bits of a fixed-point number.
+static const int FIXED_SHIFT = 16;
+/// Fixed-point one.
+static const int FIXED_ONE = 1 << FIXED_SHIFT;
+
+/// Signed 16.16 fixed-point number. Integer arithmetic gives the same results on every compiler, architecture and optimization
+/// level, which floating point does not. The range is about +-32767 with a resolution of 1/65536. Products and quotients round
+/// toward negative infinity, assuming an arithmetic right shift of negative numbers as all supported compilers do.
+class Fixed
+{
+public:
+	/// Construct zero.
+	Fixed() :
+		raw_(0)
+	{
+	}
+
+	/// Return a number from its raw 16.16 representation.
+	static Fixed FromRaw(int raw)
+	{
+		Fixed ret;
+		ret.raw_ = raw;
+		return ret;
+	}
+
+	/// Return an integer as a number.
+	static Fixed FromInt(int value) { return FromRaw(value * FIXED_ONE); }
+	/// Return the number closest below a fraction.
+	static Fixed FromRatio(int numerator, int denominator) { return FromRaw((int)(((long long)numerator * FIXED_ONE) / denominator)); }
+	/// Return a floating point value rounded to a multiple of 1/steps. Only for data loaded once: the coarse grid hides the last
+	/// bits in which the loading builds may differ.
+	static Fixed Quantize(float value, int steps) { return FromRaw((int)floor(value * steps + 0.5f) * (FIXED_ONE / steps)); }
+
+	/// Add.
+	Fixed operator + (const Fixed& rhs) const { return FromRaw(raw_ + rhs.raw_); }
+	/// Subtract.
+	Fixed operator - (const Fixed& rhs) const { return FromRaw(raw_ - rhs.raw_); }
+	/// Negate.
+	Fixed operator - () const { return FromRaw(-raw_); }
+	/// Multiply.
+	Fixed operator * (const Fixed& rhs) const { return FromRaw((int)(((long long)raw_ * rhs.raw_) >> FIXED_SHIFT)); }
+	/// Multiply with an integer.
+	Fixed operator * (int rhs) const { return FromRaw(raw_ * rhs); }
+	/// Divide.
+	Fixed operator / (const Fixed& rhs) const { return FromRaw((int)(((long long)raw_ * FIXED_ONE) / rhs.raw_)); }
+	/// Add-assign.
+	Fixed& operator += (const Fixed& rhs) { raw_ += rhs.raw_; return *this; }
+	/// Subtract-assign.
+	Fixed& operator -= (const Fixed& rhs) { raw_ -= rhs.raw_; return *this; }
+
+	/// Test for equality.
+	bool operator == (const Fixed& rhs) const { return raw_ == rhs.raw_; }
+	/// Test for inequality.
+	bool operator != (const Fixed& rhs) const { return raw_ != rhs.raw_; }
+	/// Test for less than.
+	bool operator < (const Fixed& rhs) const { return raw_ < rhs.raw_; }
+	/// Test for less than or equal.
+	bool operator <= (const Fixed& rhs) const { return raw_ <= rhs.raw_; }
+	/// Test for greater than.
+	bool operator > (const Fixed& rhs) const { return raw_ > rhs.raw_; }
+	/// Test for greater than or equal.
+	bool operator >= (const Fixed& rhs) const { return raw_ >= rhs.raw_; }
+
+	/// Return the raw 16.16 representation.
+	int GetRaw() const { return raw_; }
+	/// Return the integer part, rounded toward zero.
+	int ToInt() const { return raw_ / FIXED_ONE; }
+	/// Return as floating point, for presentation only.
+	float ToFloat() const { return (float)raw_ / (float)FIXED_ONE; }
+
+private:
+	/// Raw 16.16 value.
+	int raw_;
+};
+
+/// Return the smaller of two fixed-point numbers.
+inline Fixed Min(const Fixed& lhs, const Fixed& rhs) { return lhs < rhs ? lhs : rhs; }
+/// Return the larger of two fixed-point numbers.
+inline Fixed Max(const Fixed& lhs, const Fixed& rhs) { return lhs > rhs ? lhs : rhs; }
+/// Return the absolute value of a fixed-point number.
+inline Fixed Abs(const Fixed& value) { return value.GetRaw() >= 0 ? value : -value; }
@@ -0,0 +1,171 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "FrameJobGraph.h"
+#include "Log.h"
+#include "Timer.h"
+#include "WorkQueue.h"
+
+FrameJobGraph::FrameJobGraph(Context* context) :
+	Object(context),
+	runTime_(0),
+	parallel_(true)
+{
+}
+
+unsigned FrameJobGraph::AddJob(const String& name, FrameJobFunction function, void* data, bool mainThread, unsigned chunkSize)
+{
+	if (jobs_.Size() >= MAX_FRAME_JOBS)
+	{
+		LOGERROR("Too many frame jobs, can not add " + name);
+		return M_MAX_UNSIGNED;
+	}
+
+	Job job;
+	job.name_ = name;
+	job.function_ = function;
+	job.data_ = data;
+	job.dependencies_ = 0;
+	job.size_ = 1;
+	job.chunkSize_ = mainThread ? 0 : chunkSize;
+	job.time_ = 0;
+	job.mainThread_ = mainThread;
+	jobs_.Push(job);
+	return jobs_.Size() - 1;
+}
+
+void FrameJobGraph::AddDependency(unsigned job, unsigned dependency)
+{
+	// Dependencies only point backwards, so the graph can not have cycles
+	if (job < jobs_.Size() && dependency < job)
+		jobs_[job].dependencies_ |= 1u << dependency;
+}
+
+void FrameJobGraph::SetSize(unsigned job, unsigned size)
+{
+	if (job < jobs_.Size())
+		jobs_[job].size_ = size;
+}
+
+void FrameJobGraph::SetParallel(bool enable)
+{
+	parallel_ = enable;
+}
+
+void FrameJobGraph::Run()
+{
+	HiresTimer runTimer;
+	WorkQueue* queue = GetSubsystem<WorkQueue>();
+
+	unsigned done = 0;
+	for (unsigned i = 0; i < jobs_.Size(); ++i)
+	{
+		jobs_[i].time_ = 0;
+		if (!jobs_[i].size_)
+			done |= 1u << i;
+	}
+
+	unsigned numJobs = jobs_.Size();
+	unsigned all = numJobs < MAX_FRAME_JOBS ? (1u << numJobs) - 1 : M_MAX_UNSIGNED;
+	while (done != all)
+	{
+		// Every job whose dependencies are done is ready. Dependencies point backwards, so the first job not done is always ready
+		unsigned ready = 0;
+		for (unsigned i = 0; i < numJobs; ++i)
+		{
+			if (!(done & (1u << i)) && !(jobs_[i].dependencies_ & ~done))
+				ready |= 1u << i;
+		}
+
+		// Split the worker jobs first and queue them, so the workers start while the main thread runs its own jobs
+		chunks_.Clear();
+		for (unsigned i = 0; i < numJobs; ++i)
+		{
+			Job& job = jobs_[i];
+			if (!(ready & (1u << i)) || job.mainThread_)
+				continue;
+
+			unsigned chunkSize = job.chunkSize_ ? job.chunkSize_ : job.size_;
+			for (unsigned first = 0; first < job.size_; first += chunkSize)
+			{
+				Chunk chunk;
+				chunk.job_ = &job;
+				chunk.first_ = first;
+				chunk.last_ = Min((int)(first + chunkSize), (int)job.size_);
+				chunk.time_ = 0;
+				chunks_.Push(chunk);
+			}
+		}
+
+		if (parallel_)
+		{
+			for (unsigned i = 0; i < chunks_.Size(); ++i)
+			{
+				SharedPtr<WorkItem> item = queue->GetFreeItem();
+				item->priority_ = M_MAX_UNSIGNED;
+				item->workFunction_ = RunChunkWork;
+				item->aux_ = &chunks_[i];
+				queue->AddWorkItem(item);
+			}
+		}
+
+		for (unsigned i = 0; i < numJobs; ++i)
+		{
+			Job& job = jobs_[i];
+			if ((ready & (1u << i)) && job.mainThread_)
+			{
+				HiresTimer jobTimer;
+				job.function_(job.data_, 0, job.size_);
+				job.time_ = jobTimer.GetUSec(false);
+			}
+		}
+
+		// The main thread takes on queued chunks too while it waits
+		if (parallel_)
+			queue->Complete(M_MAX_UNSIGNED);
+		else
+		{
+			for (unsigned i = 0; i < chunks_.Size(); ++i)
+				RunChunk(chunks_[i]);
+		}
+
+		for (unsigned i = 0; i < chunks_.Size(); ++i)
+			chunks_[i].job_->time_ += chunks_[i].time_;
+
+		done |= ready;
+	}
+
+	runTime_ = runTimer.GetUSec(false);
+}
+
+void FrameJobGraph::RunChunk(Chunk& chunk)
+{
+	HiresTimer chunkTimer;
+	chunk.job_->function_(chunk.job_->data_, chunk.first_, chunk.last_);
+	chunk.time_ = chunkTimer.GetUSec(false);
+}
+
+void FrameJobGraph::RunChunkWork(const WorkItem* item, unsigned threadIndex)
+{
+	RunChunk(*reinterpret_cast<Chunk*>(item->aux_));
+}
@@ -0,0 +1,133 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "Object.h"
+
+using namespace Urho3D;
+
+namespace Urho3D
+{
+	struct WorkItem;
+}
+
+/// Frame job function. Called with the job's data and a range of its items.
+typedef void (*FrameJobFunction)(void* data, unsigned first, unsigned last);
+
+/// Maximum number of jobs in a frame job graph.
+static const unsigned MAX_FRAME_JOBS = 32;
+
+/// Work of one frame as jobs with dependencies. Worker jobs touch only their own data and run on the work queue, split in
+/// chunks if they have many items. Main thread jobs touch the scene or UI and run on the main thread while the workers are
+/// busy. Run() returns once every job is done, so calling it from the post-update is the main thread's join before rendering.
+class FrameJobGraph : public Object
+{
+	OBJECT(FrameJobGraph);
+
+public:
+	/// Construct.
+	FrameJobGraph(Context* context);
+
+	/// Add a job with one item. A worker job given a chunk size is split into work items of that many items. Return the
+	/// job index.
+	unsigned AddJob(const String& name, FrameJobFunction function, void* data, bool mainThread, unsigned chunkSize = 0);
+	/// Add a member function of an object as a job.
+	template <class T, void (T::*Method)(unsigned, unsigned)> unsigned AddJob(const String& name, T* object, bool mainThread,
+		unsigned chunkSize = 0)
+	{
+		return AddJob(name, &CallMethod<T, Method>, object, mainThread, chunkSize);
+	}
+	/// Make a job wait for a job added before it.
+	void AddDependency(unsigned job, unsigned dependency);
+	/// Set the number of items of a job for the coming frames. A job with no items is skipped, its dependents still run.
+	void SetSize(unsigned job, unsigned size);
+	/// Set whether worker jobs run on the work queue. Otherwise all jobs run in order on the main thread.
+	void SetParallel(bool enable);
+	/// Run all jobs and wait for them to finish.
+	void Run();
+
+	/// Return number of jobs.
+	unsigned GetNumJobs() const { return jobs_.Size(); }
+	/// Return the name of a job.
+	const String& GetJobName(unsigned job) const { return jobs_[job].name_; }
+	/// Return the time a job took in the last run in microseconds, summed over its chunks.
+	long long GetJobTime(unsigned job) const { return jobs_[job].time_; }
+	/// Return the time the main thread spent in the last run in microseconds.
+	long long GetRunTime() const { return runTime_; }
+	/// Return whether worker jobs run on the work queue.
+	bool IsParallel() const { return parallel_; }
+
+private:
+	/// Job.
+	struct Job
+	{
+		/// Name.
+		String name_;
+		/// Function.
+		FrameJobFunction function_;
+		/// Function data.
+		void* data_;
+		/// Bit mask of the jobs this one waits for.
+		unsigned dependencies_;
+		/// Number of items.
+		unsigned size_;
+		/// Items per work item, 0 for a single work item.
+		unsigned chunkSize_;
+		/// Time of the last run in microseconds.
+		long long time_;
+		/// Runs on the main thread flag.
+		bool mainThread_;
+	};
+
+	/// Range of a worker job's items in flight.
+	struct Chunk
+	{
+		/// Job.
+		Job* job_;
+		/// Item range.
+		unsigned first_;
+		unsigned last_;
+		/// Time taken in microseconds.
+		long long time_;
+	};
+
+	/// Run a chunk and time it.
+	static void RunChunk(Chunk& chunk);
+	/// Work item function.
+	static void RunChunkWork(const WorkItem* item, unsigned threadIndex);
+	/// Adapt a member function to a job function.
+	template <class T, void (T::*Method)(unsigned, unsigned)> static void CallMethod(void* data, unsigned first, unsigned last)
+	{
+		(static_cast<T*>(data)->*Method)(first, last);
+	}
+
+	/// Jobs.
+	Vector<Job> jobs_;
+	/// Chunks of the worker jobs being run. Built before any is queued, so the work items can point into it.
+	PODVector<Chunk> chunks_;
+	/// Time of the last run in microseconds.
+	long long runTime_;
+	/// Parallel flag.
+	bool parallel_;
+};
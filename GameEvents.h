@@ -0,0 +1,177 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "Object.h"
+
+using namespace Urho3D;
+
+namespace Urho3D
+{
+	class Node;
+}
+
+/// Fixed physics step.
+struct StepEvent
+{
+	/// Time step in seconds.
+	float timeStep_;
+};
+
+/// Coin picked up.
+struct PickupEvent
+{
+	/// Coin node, or null if its block has been released. Disabled after the event has been sent.
+	Node* coin_;
+	/// Points awarded.
+	int points_;
+	/// Score after the pickup.
+	int score_;
+};
+
+/// Character died.
+struct DeathEvent
+{
+	/// Obstacle hit, or null when the run ended otherwise, such as at a junction without a turn.
+	Node* obstacle_;
+	/// Final score.
+	int score_;
+};
+
+/// Character entered a new block.
+struct BlockEnteredEvent
+{
+	/// Block entered.
+	Node* block_;
+	/// Block left, or null for the first block.
+	Node* previousBlock_;
+};
+
+/// Typed single-event channel. Receivers are bound at subscription time to a plain function thunk, so sending is an
+/// indirect call per receiver with no hashing or Variant conversion.
+template <class T> class GameEventChannel
+{
+public:
+	/// Construct.
+	GameEventChannel() :
+		sendDepth_(0),
+		removed_(false)
+	{
+	}
+
+	/// Subscribe a member function as receiver.
+	template <class R, void (R::*Method)(const T&)> void Subscribe(R* receiver)
+	{
+		Unsubscribe(receiver);
+		Delegate delegate;
+		delegate.receiver_ = receiver;
+		delegate.function_ = &Thunk<R, Method>;
+		delegates_.Push(delegate);
+	}
+
+	/// Unsubscribe all member functions of a receiver. During a send the receiver is only cleared, and erased when the
+	/// send finishes, so that the receivers after it are still reached.
+	void Unsubscribe(void* receiver)
+	{
+		for (unsigned i = delegates_.Size() - 1; i < delegates_.Size(); --i)
+		{
+			if (delegates_[i].receiver_ != receiver)
+				continue;
+			if (sendDepth_)
+			{
+				delegates_[i].receiver_ = 0;
+				removed_ = true;
+			}
+			else
+				delegates_.Erase(i);
+		}
+	}
+
+	/// Send to all receivers in subscription order. Receivers subscribed during the send get the next one.
+	void Send(const T& event)
+	{
+		unsigned numDelegates = delegates_.Size();
+		++sendDepth_;
+		for (unsigned i = 0; i < numDelegates; ++i)
+		{
+			if (delegates_[i].receiver_)
+				delegates_[i].function_(delegates_[i].receiver_, event);
+		}
+		if (--sendDepth_ == 0 && removed_)
+		{
+			Unsubscribe(0);
+			removed_ = false;
+		}
+	}
+
+	/// Return number of receivers.
+	unsigned GetNumReceivers() const { return delegates_.Size(); }
+
+private:
+	/// Bound receiver.
+	struct Delegate
+	{
+		/// Receiver object.
+		void* receiver_;
+		/// Call thunk.
+		void (*function_)(void*, const T&);
+	};
+
+	/// Call thunk for a receiver type and member function.
+	template <class R, void (R::*Method)(const T&)> static void Thunk(void* receiver, const T& event)
+	{
+		(static_cast<R*>(receiver)->*Method)(event);
+	}
+
+	/// Bound receivers.
+	PODVector<Delegate> delegates_;
+	/// Nested sends in progress.
+	unsigned sendDepth_;
+	/// Receivers cleared during a send flag.
+	bool removed_;
+};
+
+/// Channels for the hot per-frame gameplay events. Engine events are decoded from their VariantMap once at the boundary
+/// and fanned out to game receivers from here.
+class GameEventHub : public Object
+{
+	OBJECT(GameEventHub);
+
+public:
+	/// Construct.
+	GameEventHub(Context* context);
+
+	/// Unsubscribe a receiver from all channels.
+	void UnsubscribeAll(void* receiver);
+	/// Time the typed channel against the VariantMap event path and log the per-event cost.
+	void Benchmark(unsigned iterations);
+
+	/// Physics step channel.
+	GameEventChannel<StepEvent> fixedStep_;
+	/// Coin pickup channel.
+	GameEventChannel<PickupEvent> pickup_;
+	/// Death channel.
+	GameEventChannel<DeathEvent> death_;
+	/// Block entered channel.
+	GameEventChannel<BlockEnteredEvent> blockEntered_;
+};
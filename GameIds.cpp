@@ -0,0 +1,112 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "GameIds.h"
+#include "Log.h"
+#include "Param.h"
+
+const GameId ANIM_RUN("Models/vempire_run.ani");
+const GameId ANIM_ROLL("Models/vempire_roll.ani");
+const GameId ANIM_DEATH("Models/vempire_death.ani");
+const GameId ANIM_JUMP_END("Models/vempire_jmpEnd.ani");
+const GameId ANIM_JUMP_LEFT("Models/vempire_jmpLeft.ani");
+const GameId ANIM_JUMP_LOOP("Models/vempire_jmpLoop.ani");
+const GameId ANIM_JUMP_START("Models/vempire_jmpStart.ani");
+const GameId ANIM_JUMP_RIGHT("Models/vempire_jmpRight.ani");
+const GameId ANIM_ITEM("AnimStackTake 001.ani");
+
+const GameId NODE_PLAYER_MODEL("PlayerModel");
+const GameId NODE_PLAYER_HEAD("Bip001 Head");
+
+/// All game identifiers, for the collision check.
+static const GameId* gameIds[] =
+{
+	&ANIM_RUN,
+	&ANIM_ROLL,
+	&ANIM_DEATH,
+	&ANIM_JUMP_END,
+	&ANIM_JUMP_LEFT,
+	&ANIM_JUMP_LOOP,
+	&ANIM_JUMP_START,
+	&ANIM_JUMP_RIGHT,
+	&ANIM_ITEM,
+	&NODE_PLAYER_MODEL,
+	&NODE_PLAYER_HEAD
+};
+
+/// Node variables and their names, for the collision check.
+static const char* variableNames[] =
+{
+	"In", "Out", "LeftOut", "RightOut", "Point", "Offset", "FitToCoin", "FitToObstacle", "TurnPoint", "IsInPlatform",
+	"IsObstacle", "IsAnimated", "Prefab"
+};
+static const ShortStringHash* variables[] =
+{
+	&GameVariants::P_IN, &GameVariants::P_OUT, &GameVariants::P_LEFTOUT, &GameVariants::P_RIGHTOUT, &GameVariants::P_POINT,
+	&GameVariants::P_OFFSET, &GameVariants::P_FITTOCOIN, &GameVariants::P_FITTOOBSTACLE, &GameVariants::P_TURNPOINT,
+	&GameVariants::P_ISINPLATFORM, &GameVariants::P_ISOBSTACLE, &GameVariants::P_ISANIMATED, &GameVariants::P_PREFAB
+};
+/// Fails to compile if the two tables are not the same length.
+typedef char VariableTablesMatch[sizeof(variableNames) / sizeof(variableNames[0]) == sizeof(variables) / sizeof(variables[0]) ?
+	1 : -1];
+
+const String& GameId::GetString() const
+{
+	if (string_.Empty())
+		string_ = name_;
+	return string_;
+}
+
+bool CheckGameIds()
+{
+	bool unique = true;
+	unsigned numIds = sizeof(gameIds) / sizeof(gameIds[0]);
+	for (unsigned i = 0; i < numIds; ++i)
+	{
+		for (unsigned j = i + 1; j < numIds; ++j)
+		{
+			if (gameIds[i]->GetHash() == gameIds[j]->GetHash())
+			{
+				LOGERROR("Game identifiers " + String(gameIds[i]->GetName()) + " and " + String(gameIds[j]->GetName()) +
+					" have the same hash");
+				unique = false;
+			}
+		}
+	}
+
+	// Node variables use the 16-bit hash, so they are the likelier ones to collide
+	unsigned numVariables = sizeof(variables) / sizeof(variables[0]);
+	for (unsigned i = 0; i < numVariables; ++i)
+	{
+		for (unsigned j = i + 1; j < numVariables; ++j)
+		{
+			if (*variables[i] == *variables[j])
+			{
+				LOGERROR("Node variables " + String(variableNames[i]) + " and " + String(variableNames[j]) + " have the same hash");
+				unique = false;
+			}
+		}
+	}
+
+	return unique;
+}
@@ -0,0 +1,77 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "Str.h"
+#include "StringHash.h"
+
+using namespace Urho3D;
+
+/// Name of a resource or node that the game refers to. The hash is computed once at startup from the literal, without
+/// building a string. The string is only built on first use, for the engine calls that take one.
+class GameId
+{
+public:
+	/// Construct from a name literal.
+	GameId(const char* name) :
+		name_(name),
+		hash_(name)
+	{
+	}
+
+	/// Return the name.
+	const char* GetName() const { return name_; }
+	/// Return the name hash.
+	StringHash GetHash() const { return hash_; }
+	/// Return the name as a string. Built on the first call, so call from the main thread only.
+	const String& GetString() const;
+
+private:
+	/// Name literal.
+	const char* name_;
+	/// Name hash.
+	StringHash hash_;
+	/// Name string, empty until asked for.
+	mutable String string_;
+};
+
+/// Animations of the player model.
+extern const GameId ANIM_RUN;
+extern const GameId ANIM_ROLL;
+extern const GameId ANIM_DEATH;
+extern const GameId ANIM_JUMP_END;
+extern const GameId ANIM_JUMP_LEFT;
+extern const GameId ANIM_JUMP_LOOP;
+extern const GameId ANIM_JUMP_START;
+extern const GameId ANIM_JUMP_RIGHT;
+/// Animation of animated block items.
+extern const GameId ANIM_ITEM;
+
+/// Child node of the player holding the model.
+extern const GameId NODE_PLAYER_MODEL;
+/// Head bone of the player model.
+extern const GameId NODE_PLAYER_HEAD;
+
+/// Log an error for each pair of game identifiers or node variables whose hashes collide. Return true if none do.
+bool CheckGameIds();
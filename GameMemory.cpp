@@ -0,0 +1,96 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "CoreEvents.h"
+#include "GameMemory.h"
+
+#include <cstdlib>
+#include <new>
+
+#ifdef _MSC_VER
+#define GAME_THREAD_LOCAL __declspec(thread)
+#else
+#define GAME_THREAD_LOCAL __thread
+#endif
+
+/// Initial size of the frame arena in bytes.
+static const unsigned FRAME_ARENA_SIZE = 16 * 1024;
+
+/// Allocation scope depth of each thread. Only the main thread opens scopes, so worker and network threads are not counted.
+static GAME_THREAD_LOCAL int scopeDepth = 0;
+/// Heap allocations counted in scopes since the last frame end. Written by the main thread only.
+static unsigned scopedAllocations = 0;
+
+// Count allocations through the global operators, which the engine's containers and strings use as well
+void* operator new(size_t size)
+{
+	if (scopeDepth)
+		++scopedAllocations;
+
+	void* block = malloc(size ? size : 1);
+	if (!block)
+		throw std::bad_alloc();
+	return block;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* block) throw()
+{
+	free(block);
+}
+
+void operator delete[](void* block) throw()
+{
+	free(block);
+}
+
+GameMemory::GameMemory(Context* context) :
+	Object(context),
+	frameArena_(FRAME_ARENA_SIZE),
+	frameAllocations_(0),
+	totalAllocations_(0)
+{
+	SubscribeToEvent(E_ENDFRAME, HANDLER(GameMemory, HandleEndFrame));
+}
+
+void GameMemory::BeginScope()
+{
+	++scopeDepth;
+}
+
+void GameMemory::EndScope()
+{
+	--scopeDepth;
+}
+
+void GameMemory::HandleEndFrame(StringHash eventType, VariantMap& eventData)
+{
+	frameAllocations_ = scopedAllocations;
+	totalAllocations_ += scopedAllocations;
+	scopedAllocations = 0;
+	frameArena_.Reset();
+}
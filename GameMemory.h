@@ -0,0 +1,74 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "Arena.h"
+#include "Object.h"
+
+using namespace Urho3D;
+
+/// Transient memory of the game layer. Holds the frame arena, which is reset at the end of each frame, and counts the heap
+/// allocations the game layer makes on the main thread inside allocation scopes, so that a steady state can be checked to
+/// allocate nothing.
+class GameMemory : public Object
+{
+	OBJECT(GameMemory);
+
+public:
+	/// Construct.
+	GameMemory(Context* context);
+
+	/// Return the frame arena. Its allocations are valid until the end of the frame.
+	Arena& GetFrameArena() { return frameArena_; }
+	/// Return the heap allocations counted in the last frame.
+	unsigned GetFrameAllocations() const { return frameAllocations_; }
+	/// Return the heap allocations counted since the start.
+	unsigned GetTotalAllocations() const { return totalAllocations_; }
+
+	/// Start counting the calling thread's heap allocations. Scopes nest.
+	static void BeginScope();
+	/// Stop counting the calling thread's heap allocations.
+	static void EndScope();
+
+private:
+	/// Handle frame end. Reset the frame arena and latch the allocation count.
+	void HandleEndFrame(StringHash eventType, VariantMap& eventData);
+
+	/// Frame arena.
+	Arena frameArena_;
+	/// Heap allocations of the last frame.
+	unsigned frameAllocations_;
+	/// Heap allocations since the start.
+	unsigned totalAllocations_;
+};
+
+/// Counts the heap allocations of the game code it encloses. Only used on the main thread.
+class AllocationScope
+{
+public:
+	/// Construct and start counting.
+	AllocationScope() { GameMemory::BeginScope(); }
+	/// Destruct and stop counting.
+	~AllocationScope() { GameMemory::EndScope(); }
+};
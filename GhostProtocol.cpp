@@ -0,0 +1,131 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "Deserializer.h"
+#include "GhostProtocol.h"
+
+/// Most steps a batch may claim, to reject garbage before allocating.
+static const unsigned MAX_BATCH_STEPS = 65536;
+
+GhostRecorder::GhostRecorder()
+{
+	Reset();
+}
+
+void GhostRecorder::Reset()
+{
+	runs_.Clear();
+	keyframes_.Clear();
+	step_ = 0;
+	batchStart_ = 0;
+}
+
+void GhostRecorder::Record(unsigned short input, const Vector3& position, float yaw, unsigned checksum)
+{
+	if (!runs_.Empty() && runs_.Back().input_ == input)
+	{
+		++runs_.Back().length_;
+	}
+	else
+	{
+		Run run;
+		run.input_ = input;
+		run.length_ = 1;
+		runs_.Push(run);
+	}
+
+	if (step_ % GHOST_KEYFRAME_STEPS == 0)
+	{
+		GhostKeyframe keyframe;
+		keyframe.step_ = step_;
+		keyframe.position_ = position;
+		keyframe.yaw_ = yaw;
+		keyframe.checksum_ = checksum;
+		keyframes_.Push(keyframe);
+	}
+
+	++step_;
+}
+
+void GhostRecorder::WriteBatch(VectorBuffer& dest)
+{
+	dest.WriteVLE(batchStart_);
+
+	dest.WriteVLE(runs_.Size());
+	for (unsigned i = 0; i < runs_.Size(); ++i)
+	{
+		dest.WriteUShort(runs_[i].input_);
+		dest.WriteVLE(runs_[i].length_);
+	}
+
+	// Keyframe steps are relative to the batch, yaw is quantized to a byte
+	dest.WriteVLE(keyframes_.Size());
+	for (unsigned i = 0; i < keyframes_.Size(); ++i)
+	{
+		const GhostKeyframe& keyframe = keyframes_[i];
+		dest.WriteVLE(keyframe.step_ - batchStart_);
+		dest.WriteVector3(keyframe.position_);
+		float yaw = keyframe.yaw_ - floorf(keyframe.yaw_ / 360.0f) * 360.0f;
+		dest.WriteUByte((unsigned char)((int)(yaw * 256.0f / 360.0f + 0.5f) & 0xff));
+		dest.WriteUInt(keyframe.checksum_);
+	}
+
+	runs_.Clear();
+	keyframes_.Clear();
+	batchStart_ = step_;
+}
+
+bool ReadGhostBatch(Deserializer& source, GhostBatch& batch)
+{
+	batch.firstStep_ = source.ReadVLE();
+	batch.inputs_.Clear();
+	batch.keyframes_.Clear();
+
+	unsigned numRuns = source.ReadVLE();
+	for (unsigned i = 0; i < numRuns; ++i)
+	{
+		unsigned short input = source.ReadUShort();
+		unsigned length = source.ReadVLE();
+		if (source.IsEof() || batch.inputs_.Size() + length > MAX_BATCH_STEPS)
+			return false;
+
+		for (unsigned j = 0; j < length; ++j)
+			batch.inputs_.Push(input);
+	}
+
+	unsigned numKeyframes = source.ReadVLE();
+	for (unsigned i = 0; i < numKeyframes; ++i)
+	{
+		if (source.IsEof())
+			return false;
+
+		GhostKeyframe keyframe;
+		keyframe.step_ = batch.firstStep_ + source.ReadVLE();
+		keyframe.position_ = source.ReadVector3();
+		keyframe.yaw_ = source.ReadUByte() * 360.0f / 256.0f;
+		keyframe.checksum_ = source.ReadUInt();
+		batch.keyframes_.Push(keyframe);
+	}
+
+	return true;
+}
@@ -0,0 +1,126 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "Vector3.h"
+#include "VectorBuffer.h"
+
+using namespace Urho3D;
+
+namespace Urho3D
+{
+	class Deserializer;
+}
+
+/// Ghost messages. Sent by clients without a ghost ID, relayed by the server with the ID of the sending client prepended.
+/// Run started. Server to client: ghost ID.
+static const int MSG_GHOST_START = 0x100;
+/// Batch of steps (see GhostRecorder). Server to client: ghost ID, batch.
+static const int MSG_GHOST_STEPS = 0x101;
+/// Run ended. Client to server: final score. Server to client: ghost ID, final score.
+static const int MSG_GHOST_END = 0x102;
+/// Level seed. Server to client only.
+static const int MSG_GHOST_SEED = 0x103;
+/// Run validated by a race server. Server to client only: claimed score, simulated score, accepted flag.
+static const int MSG_RACE_RESULT = 0x104;
+
+/// Default ghost server port.
+static const unsigned short GHOST_PORT = 2346;
+/// Ghost ID of the best recorded run, replayed by the server to each client starting a run.
+static const unsigned GHOST_BEST_RUN = 0;
+/// Physics steps between position keyframes.
+static const unsigned GHOST_KEYFRAME_STEPS = 15;
+/// Seconds between step batches.
+static const float GHOST_SEND_INTERVAL = 0.25f;
+
+/// Pack the held buttons and the actions of a physics step.
+inline unsigned short PackGhostInput(int buttons, int actions) { return (unsigned short)((buttons & 0xff) | ((actions & 0xff) << 8)); }
+
+/// Position keyframe of a ghost, taken after the step.
+struct GhostKeyframe
+{
+	/// Physics step since the start of the run.
+	unsigned step_;
+	/// World position.
+	Vector3 position_;
+	/// Yaw angle in degrees.
+	float yaw_;
+	/// Checksum of the run's simulation state, which a re-simulation of the inputs must reproduce.
+	unsigned checksum_;
+};
+
+/// Decoded step batch.
+struct GhostBatch
+{
+	/// Step of the first input.
+	unsigned firstStep_;
+	/// Input of each step.
+	PODVector<unsigned short> inputs_;
+	/// Keyframes within the batch.
+	PODVector<GhostKeyframe> keyframes_;
+};
+
+/// Records the input of each physics step run-length encoded, plus a position and checksum keyframe every few steps, and writes
+/// them out in batches.
+/// Inputs change rarely, so a batch of a quarter second is typically a handful of bytes plus one keyframe.
+class GhostRecorder
+{
+public:
+	/// Construct.
+	GhostRecorder();
+
+	/// Start a new run.
+	void Reset();
+	/// Record one physics step.
+	void Record(unsigned short input, const Vector3& position, float yaw, unsigned checksum);
+	/// Write the steps recorded since the last batch and start a new batch.
+	void WriteBatch(VectorBuffer& dest);
+
+	/// Return whether steps have been recorded since the last batch.
+	bool HasData() const { return !runs_.Empty(); }
+	/// Return steps recorded in the run.
+	unsigned GetNumSteps() const { return step_; }
+
+private:
+	/// Input run.
+	struct Run
+	{
+		/// Step input.
+		unsigned short input_;
+		/// Number of steps.
+		unsigned length_;
+	};
+
+	/// Input runs of the batch.
+	PODVector<Run> runs_;
+	/// Keyframes of the batch.
+	PODVector<GhostKeyframe> keyframes_;
+	/// Steps recorded in the run.
+	unsigned step_;
+	/// First step of the batch.
+	unsigned batchStart_;
+};
+
+/// Read a batch written by GhostRecorder. Return false if the data is malformed.
+bool ReadGhostBatch(Deserializer& source, GhostBatch& batch);
@@ -0,0 +1,550 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "AnimatedModel.h"
+#include "AnimationController.h"
+#include "Character.h"
+#include "Connection.h"
+#include "CoreEvents.h"
+#include "DebugHud.h"
+#include "GhostRace.h"
+#include "Log.h"
+#include "Material.h"
+#include "MemoryBuffer.h"
+#include "Model.h"
+#include "Network.h"
+#include "NetworkEvents.h"
+#include "RaceMatch.h"
+#include "ResourceCache.h"
+#include "RunnerLevel.h"
+#include "Scene.h"
+#include "Timer.h"
+
+/// Steps of a claimed best run re-simulated per frame before it may replace the replayed one.
+static const unsigned GHOST_CHECK_STEPS = 120;
+
+GhostTrack::GhostTrack() :
+	next_(0),
+	pending_(false),
+	diverged_(false)
+{
+}
+
+void GhostTrack::Reset(RunnerLevel* level)
+{
+	level_ = level;
+	next_ = 0;
+	pending_ = false;
+	diverged_ = false;
+}
+
+bool GhostTrack::GetNextBlock(int turn, unsigned& block, unsigned& group)
+{
+	if (!level_ || diverged_)
+		return false;
+	if (next_ >= level_->GetTrackSize())
+	{
+		pending_ = true;
+		return false;
+	}
+
+	// A block released before a loaded run has no choices to follow
+	const TrackBlock& entry = level_->GetTrackBlock(next_);
+	if (entry.turn_ != turn || entry.prefab_ == M_MAX_UNSIGNED)
+	{
+		diverged_ = true;
+		return false;
+	}
+
+	block = entry.prefab_;
+	group = entry.group_;
+	++next_;
+	return true;
+}
+
+GhostRace::GhostRace(Context* context) :
+	Object(context),
+	bestScore_(-1),
+	nextGhostID_(GHOST_BEST_RUN),
+	seed_(0),
+	hasSeed_(false),
+	running_(false),
+	sendTimer_(0.0f),
+	bytesSent_(0),
+	rateTimer_(0.0f)
+{
+	SubscribeToEvent(E_CLIENTCONNECTED, HANDLER(GhostRace, HandleClientConnected));
+	SubscribeToEvent(E_CLIENTDISCONNECTED, HANDLER(GhostRace, HandleClientDisconnected));
+	SubscribeToEvent(E_NETWORKMESSAGE, HANDLER(GhostRace, HandleNetworkMessage));
+	SubscribeToEvent(E_UPDATE, HANDLER(GhostRace, HandleUpdate));
+}
+
+void GhostRace::SetScene(Scene* scene)
+{
+	scene_ = scene;
+	ghosts_.Clear();
+}
+
+bool GhostRace::StartServer(unsigned short port)
+{
+	if (!GetSubsystem<Network>()->StartServer(port))
+		return false;
+
+	seed_ = Time::GetSystemTime();
+	hasSeed_ = true;
+	LOGINFO("Ghost server started on port " + String(port));
+	return true;
+}
+
+bool GhostRace::Connect(const String& address, unsigned short port)
+{
+	return GetSubsystem<Network>()->Connect(address, port, 0);
+}
+
+void GhostRace::BeginRun()
+{
+	recorder_.Reset();
+	running_ = true;
+	sendTimer_ = 0.0f;
+
+	// Ghosts are aligned to the elapsed steps of the local run, so they all start over with it
+	for (HashMap<unsigned, Ghost>::Iterator i = ghosts_.Begin(); i != ghosts_.End(); ++i)
+		RestartGhost(i->second_);
+
+	Connection* connection = GetSubsystem<Network>()->GetServerConnection();
+	if (connection)
+	{
+		message_.Clear();
+		connection->SendMessage(MSG_GHOST_START, true, true, message_);
+	}
+}
+
+void GhostRace::RecordStep(unsigned short input, const Vector3& position, float yaw, unsigned checksum)
+{
+	if (running_ && IsConnected())
+		recorder_.Record(input, position, yaw, checksum);
+}
+
+void GhostRace::EndRun(int score)
+{
+	if (!running_)
+		return;
+
+	running_ = false;
+	SendBatch();
+
+	Connection* connection = GetSubsystem<Network>()->GetServerConnection();
+	if (connection)
+	{
+		message_.Clear();
+		message_.WriteInt(score);
+		connection->SendMessage(MSG_GHOST_END, true, true, message_);
+	}
+}
+
+bool GhostRace::IsConnected() const
+{
+	Connection* connection = GetSubsystem<Network>()->GetServerConnection();
+	return connection && connection->IsConnected();
+}
+
+void GhostRace::HandleClientConnected(StringHash eventType, VariantMap& eventData)
+{
+	using namespace ClientConnected;
+
+	Connection* connection = static_cast<Connection*>(eventData[P_CONNECTION].GetPtr());
+	remoteRuns_[connection].id_ = ++nextGhostID_;
+
+	message_.Clear();
+	message_.WriteUInt(seed_);
+	connection->SendMessage(MSG_GHOST_SEED, true, true, message_);
+}
+
+void GhostRace::HandleClientDisconnected(StringHash eventType, VariantMap& eventData)
+{
+	using namespace ClientDisconnected;
+
+	Connection* connection = static_cast<Connection*>(eventData[P_CONNECTION].GetPtr());
+	HashMap<Connection*, RemoteRun>::Iterator it = remoteRuns_.Find(connection);
+	if (it == remoteRuns_.End())
+		return;
+
+	// End the ghost for the others, so that it does not wait for more steps
+	unsigned char score[4] = { 0, 0, 0, 0 };
+	Relay(connection, MSG_GHOST_END, it->second_.id_, score, sizeof score);
+	remoteRuns_.Erase(it);
+}
+
+void GhostRace::HandleNetworkMessage(StringHash eventType, VariantMap& eventData)
+{
+	using namespace NetworkMessage;
+
+	int msgID = eventData[P_MESSAGEID].GetInt();
+	if (msgID < MSG_GHOST_START || msgID > MSG_RACE_RESULT)
+		return;
+
+	Connection* connection = static_cast<Connection*>(eventData[P_CONNECTION].GetPtr());
+	const PODVector<unsigned char>& data = eventData[P_DATA].GetBuffer();
+	if (connection->IsClient())
+		HandleServerMessage(connection, msgID, data);
+	else
+		HandleClientMessage(msgID, data);
+}
+
+void GhostRace::HandleUpdate(StringHash eventType, VariantMap& eventData)
+{
+	using namespace Update;
+
+	float timeStep = eventData[P_TIMESTEP].GetFloat();
+
+	if (running_)
+	{
+		sendTimer_ += timeStep;
+		if (sendTimer_ >= GHOST_SEND_INTERVAL)
+		{
+			sendTimer_ = 0.0f;
+			SendBatch();
+		}
+	}
+
+	UpdateBestRunCheck();
+
+	rateTimer_ += timeStep;
+	if (rateTimer_ >= 1.0f)
+	{
+		DebugHud* debugHud = GetSubsystem<DebugHud>();
+		if (debugHud && IsConnected())
+			debugHud->SetAppStats("Ghost upload", ToString("%.0f B/s", bytesSent_ / rateTimer_));
+		bytesSent_ = 0;
+		rateTimer_ = 0.0f;
+	}
+
+	unsigned step = recorder_.GetNumSteps();
+	for (HashMap<unsigned, Ghost>::Iterator i = ghosts_.Begin(); i != ghosts_.End(); ++i)
+	{
+		Ghost& ghost = i->second_;
+		if (!ghost.node_ || ghost.keyframes_.Empty())
+			continue;
+
+		const PODVector<GhostKeyframe>& keyframes = ghost.keyframes_;
+		while (ghost.cursor_ + 1 < keyframes.Size() && keyframes[ghost.cursor_ + 1].step_ <= step)
+			++ghost.cursor_;
+		ghost.node_->SetEnabled(!ghost.finished_ || step <= keyframes.Back().step_);
+
+		if (SimulateGhost(ghost, step))
+			continue;
+
+		const GhostKeyframe& from = keyframes[ghost.cursor_];
+		Vector3 position = from.position_;
+		float yaw = from.yaw_;
+
+		// Hold the last keyframe when the ghost's data has not arrived yet
+		if (ghost.cursor_ + 1 < keyframes.Size())
+		{
+			const GhostKeyframe& to = keyframes[ghost.cursor_ + 1];
+			float t = Clamp((float)((int)step - (int)from.step_) / (float)(to.step_ - from.step_), 0.0f, 1.0f);
+			float delta = to.yaw_ - from.yaw_;
+			if (delta > 180.0f)
+				delta -= 360.0f;
+			else if (delta < -180.0f)
+				delta += 360.0f;
+			position = from.position_.Lerp(to.position_, t);
+			yaw = from.yaw_ + delta * t;
+		}
+
+		ghost.node_->SetPosition(position);
+		ghost.node_->SetRotation(Quaternion(yaw, Vector3::UP));
+	}
+}
+
+void GhostRace::HandleServerMessage(Connection* connection, int msgID, const PODVector<unsigned char>& data)
+{
+	HashMap<Connection*, RemoteRun>::Iterator it = remoteRuns_.Find(connection);
+	if (it == remoteRuns_.End())
+		return;
+
+	RemoteRun& run = it->second_;
+	const unsigned char* bytes = data.Empty() ? 0 : &data[0];
+
+	switch (msgID)
+	{
+	case MSG_GHOST_START:
+		run.batches_.Clear();
+		Relay(connection, MSG_GHOST_START, run.id_, 0, 0);
+
+		// Replay the best finished run to the runner, to race against at its own pace
+		if (!bestRun_.Empty())
+		{
+			message_.Clear();
+			message_.WriteVLE(GHOST_BEST_RUN);
+			connection->SendMessage(MSG_GHOST_START, true, true, message_);
+
+			for (unsigned i = 0; i < bestRun_.Size(); ++i)
+			{
+				message_.Clear();
+				message_.WriteVLE(GHOST_BEST_RUN);
+				message_.Write(&bestRun_[i][0], bestRun_[i].Size());
+				connection->SendMessage(MSG_GHOST_STEPS, true, true, message_);
+			}
+
+			message_.Clear();
+			message_.WriteVLE(GHOST_BEST_RUN);
+			message_.WriteInt(bestScore_);
+			connection->SendMessage(MSG_GHOST_END, true, true, message_);
+		}
+		break;
+
+	case MSG_GHOST_STEPS:
+		if (data.Empty())
+			break;
+		run.batches_.Push(data);
+		Relay(connection, MSG_GHOST_STEPS, run.id_, bytes, data.Size());
+		break;
+
+	case MSG_GHOST_END:
+		{
+			MemoryBuffer buffer(data);
+			int score = buffer.ReadInt();
+			Relay(connection, MSG_GHOST_END, run.id_, bytes, data.Size());
+
+			if (score > bestScore_ && !run.batches_.Empty())
+				CheckBestRun(run.batches_, score);
+		}
+		break;
+	}
+}
+
+void GhostRace::CheckBestRun(const Vector<PODVector<unsigned char> >& batches, int score)
+{
+	// A claim no higher than the one being checked could not replace it
+	if (candidate_ && candidate_->IsRunning() && score <= candidate_->GetClaimedScore())
+		return;
+
+	// The claimed score is only taken once the inputs re-simulate to it, with every keyframe checksum matching
+	if (!candidate_)
+		candidate_ = new RaceMatch(context_);
+	candidate_->Start(seed_);
+	for (unsigned i = 0; i < batches.Size(); ++i)
+	{
+		MemoryBuffer buffer(batches[i]);
+		GhostBatch batch;
+		if (!ReadGhostBatch(buffer, batch) || !candidate_->AddBatch(batch))
+		{
+			LOGWARNING("Rejected a best run claim of " + String(score) + " with a malformed or out of sequence batch");
+			candidate_.Reset();
+			candidateRun_.Clear();
+			return;
+		}
+	}
+	candidate_->End(score);
+	candidateRun_ = batches;
+}
+
+void GhostRace::UpdateBestRunCheck()
+{
+	if (!candidate_ || !candidate_->IsRunning())
+		return;
+
+	candidate_->Simulate(GHOST_CHECK_STEPS);
+	if (!candidate_->IsFinished())
+		return;
+
+	int score = candidate_->GetClaimedScore();
+	if (candidate_->IsAccepted() && score > bestScore_)
+	{
+		bestScore_ = score;
+		bestRun_ = candidateRun_;
+	}
+	else if (!candidate_->IsAccepted())
+	{
+		LOGWARNING("Rejected a best run claim of " + String(score) + ", the re-simulation scored " +
+			String(candidate_->GetSimulatedScore()) + " with " + String(candidate_->GetNumMismatches()) + " keyframe mismatches");
+	}
+	candidateRun_.Clear();
+}
+
+void GhostRace::HandleClientMessage(int msgID, const PODVector<unsigned char>& data)
+{
+	MemoryBuffer buffer(data);
+
+	if (msgID == MSG_GHOST_SEED)
+	{
+		seed_ = buffer.ReadUInt();
+		hasSeed_ = true;
+		return;
+	}
+
+	if (msgID == MSG_RACE_RESULT)
+	{
+		int claimed = buffer.ReadInt();
+		int simulated = buffer.ReadInt();
+		bool accepted = buffer.ReadBool();
+		LOGINFO("Race server " + String(accepted ? "accepted" : "rejected") + " score " + String(claimed) + " (simulated " +
+			String(simulated) + ")");
+		return;
+	}
+
+	Ghost& ghost = GetGhost(buffer.ReadVLE());
+
+	switch (msgID)
+	{
+	case MSG_GHOST_START:
+		ghost.keyframes_.Clear();
+		ghost.inputs_.Clear();
+		ghost.finished_ = false;
+		RestartGhost(ghost);
+		break;
+
+	case MSG_GHOST_STEPS:
+		{
+			GhostBatch batch;
+			if (!ReadGhostBatch(buffer, batch))
+			{
+				LOGWARNING("Malformed ghost batch");
+				break;
+			}
+
+			// Inputs drive the ghost's simulation, the keyframes check it and place the ghost where it can not be simulated
+			ghost.inputs_.Insert(ghost.inputs_.End(), batch.inputs_);
+			ghost.keyframes_.Insert(ghost.keyframes_.End(), batch.keyframes_);
+		}
+		break;
+
+	case MSG_GHOST_END:
+		ghost.finished_ = true;
+		break;
+	}
+}
+
+void GhostRace::Relay(Connection* except, int msgID, unsigned ghostID, const unsigned char* data, unsigned size)
+{
+	message_.Clear();
+	message_.WriteVLE(ghostID);
+	if (size)
+		message_.Write(data, size);
+
+	Vector<SharedPtr<Connection> > connections = GetSubsystem<Network>()->GetClientConnections();
+	for (unsigned i = 0; i < connections.Size(); ++i)
+	{
+		if (connections[i] != except)
+			connections[i]->SendMessage(msgID, true, true, message_);
+	}
+}
+
+void GhostRace::SendBatch()
+{
+	Connection* connection = GetSubsystem<Network>()->GetServerConnection();
+	if (!connection || !recorder_.HasData())
+		return;
+
+	message_.Clear();
+	recorder_.WriteBatch(message_);
+	connection->SendMessage(MSG_GHOST_STEPS, true, true, message_);
+	bytesSent_ += message_.GetSize();
+}
+
+GhostRace::Ghost& GhostRace::GetGhost(unsigned ghostID)
+{
+	Ghost& ghost = ghosts_[ghostID];
+	if (ghost.node_ || !scene_)
+		return ghost;
+
+	ResourceCache* cache = GetSubsystem<ResourceCache>();
+	ghost.node_ = scene_->CreateChild("Ghost", LOCAL);
+	Node* modelNode = ghost.node_->CreateChild("GhostModel", LOCAL);
+	modelNode->SetScale(Vector3(.4f, .4f, .4f));
+	modelNode->SetRotation(Quaternion(180, Vector3::UP));
+
+	AnimatedModel* model = modelNode->CreateComponent<AnimatedModel>(LOCAL);
+	model->SetModel(cache->GetResource<Model>("Models/vempire.mdl"));
+	model->SetMaterial(cache->GetResource<Material>("Materials/GreenTransparent.xml"));
+	AnimationController* animCtrl = modelNode->CreateComponent<AnimationController>(LOCAL);
+	animCtrl->Play(ANIM_RUN.GetString(), 0, true, 0.0f);
+
+	ghost.node_->SetEnabled(false);
+	return ghost;
+}
+
+void GhostRace::RestartGhost(Ghost& ghost)
+{
+	ghost.cursor_ = 0;
+	ghost.checked_ = 0;
+	ghost.track_.Reset(level_);
+	if (level_)
+		ghost.sim_.Start(&level_->GetSimKit(), &ghost.track_);
+}
+
+bool GhostRace::SimulateGhost(Ghost& ghost, unsigned step)
+{
+	GhostTrack& track = ghost.track_;
+	RunnerSim& sim = ghost.sim_;
+	if (!level_ || track.diverged_ || !track.next_)
+		return false;
+
+	const PODVector<GhostKeyframe>& keyframes = ghost.keyframes_;
+	while (sim.GetStep() < step && sim.GetStep() < ghost.inputs_.Size() && !sim.IsDead())
+	{
+		// On the last block the local level has placed, a step may need the next one. It is taken back if that block is not
+		// there yet, and tried again once the local runner has got further
+		bool atEnd = track.next_ >= level_->GetTrackSize();
+		RunnerSim saved;
+		if (atEnd)
+			saved = sim;
+
+		unsigned short input = ghost.inputs_[sim.GetStep()];
+		sim.Step(input & 0xff, input >> 8);
+		if (track.pending_)
+		{
+			sim = saved;
+			track.pending_ = false;
+			break;
+		}
+
+		// A checksum the simulation does not reproduce, such as from another version, leaves the ghost to its keyframes
+		while (ghost.checked_ < keyframes.Size() && keyframes[ghost.checked_].step_ < sim.GetStep())
+		{
+			const GhostKeyframe& keyframe = keyframes[ghost.checked_++];
+			if (keyframe.step_ + 1 == sim.GetStep() && keyframe.checksum_ != sim.GetChecksum())
+				track.diverged_ = true;
+		}
+		if (track.diverged_)
+			return false;
+	}
+
+	// Held back or out of input, the keyframes know better where the ghost is
+	if (sim.GetStep() < step && !sim.IsDead())
+		return false;
+
+	Vector3 position;
+	Vector3 direction;
+	if (!level_->GetTrackTransform(sim.GetNumBlocks() - 1, sim.GetBlockDistance().ToFloat(), sim.GetLateral().ToFloat(),
+		position, direction))
+		return false;
+
+	position.y_ += sim.GetHeight().ToFloat();
+	Quaternion rotation;
+	rotation.FromLookRotation(direction);
+	ghost.node_->SetPosition(position);
+	ghost.node_->SetRotation(rotation);
+	return true;
+}
@@ -0,0 +1,207 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "GhostProtocol.h"
+#include "HashMap.h"
+#include "Object.h"
+#include "RunnerSim.h"
+
+using namespace Urho3D;
+
+namespace Urho3D
+{
+	class Connection;
+	class Node;
+	class Scene;
+}
+
+class RaceMatch;
+class RunnerLevel;
+
+/// Track of a ghost's simulation: the blocks the local level has placed, as long as the ghost turns the same way as the local
+/// runner did.
+class GhostTrack : public SimTrack
+{
+public:
+	/// Construct.
+	GhostTrack();
+
+	/// Start over on the track of a level.
+	void Reset(RunnerLevel* level);
+	/// Return the next block of the local track if it exists and the turn into it matches.
+	virtual bool GetNextBlock(int turn, unsigned& block, unsigned& group);
+
+	/// Local level.
+	WeakPtr<RunnerLevel> level_;
+	/// Next block of the local track.
+	unsigned next_;
+	/// The ghost asked for a block the local level has not placed yet.
+	bool pending_;
+	/// The ghost turned off the local track, or its checksum did not match.
+	bool diverged_;
+};
+
+/// Ghost racing. Replicates only the level seed and the recorded input and keyframe stream of each run through the network,
+/// and plays the other runners back as ghosts aligned to the local run's elapsed steps. A ghost re-simulates its inputs on the
+/// local track while it follows it, and falls back to its keyframes ahead of the local level or off its track. The server relays live runs between
+/// clients and replays the best finished run to every client that starts a run, once a re-simulation has confirmed its score.
+/// One process can be server and client at once.
+class GhostRace : public Object
+{
+	OBJECT(GhostRace);
+
+public:
+	/// Construct.
+	GhostRace(Context* context);
+
+	/// Set the scene ghosts are shown in.
+	void SetScene(Scene* scene);
+	/// Set the local level, whose track the ghosts are simulated on.
+	void SetLevel(RunnerLevel* level) { level_ = level; }
+	/// Start relaying runs. The level seed of the session is chosen here.
+	bool StartServer(unsigned short port);
+	/// Connect to a server.
+	bool Connect(const String& address, unsigned short port);
+	/// Local run started.
+	void BeginRun();
+	/// Record one physics step of the local run, with the simulation checksum after the step.
+	void RecordStep(unsigned short input, const Vector3& position, float yaw, unsigned checksum);
+	/// Local run ended.
+	void EndRun(int score);
+
+	/// Return whether connected to a server.
+	bool IsConnected() const;
+	/// Return whether the server has sent the level seed.
+	bool HasSeed() const { return hasSeed_; }
+	/// Return the level seed of the session.
+	unsigned GetSeed() const { return seed_; }
+
+private:
+	/// Ghost played back in the local scene.
+	struct Ghost
+	{
+		/// Construct.
+		Ghost() :
+			cursor_(0),
+			checked_(0),
+			finished_(false)
+		{
+		}
+
+		/// Ghost node.
+		SharedPtr<Node> node_;
+		/// Received keyframes.
+		PODVector<GhostKeyframe> keyframes_;
+		/// Received step inputs.
+		PODVector<unsigned short> inputs_;
+		/// Keyframe before the playback position.
+		unsigned cursor_;
+		/// Simulation of the received inputs.
+		RunnerSim sim_;
+		/// Track of the simulation.
+		GhostTrack track_;
+		/// Next keyframe to check against the simulation.
+		unsigned checked_;
+		/// Run ended flag.
+		bool finished_;
+	};
+
+	/// Run of a connected client, kept by the server.
+	struct RemoteRun
+	{
+		/// Construct.
+		RemoteRun() :
+			id_(0)
+		{
+		}
+
+		/// Ghost ID.
+		unsigned id_;
+		/// Step batches of the current run.
+		Vector<PODVector<unsigned char> > batches_;
+	};
+
+	/// Handle a client connecting to the server. Send the seed.
+	void HandleClientConnected(StringHash eventType, VariantMap& eventData);
+	/// Handle a client disconnecting from the server.
+	void HandleClientDisconnected(StringHash eventType, VariantMap& eventData);
+	/// Handle a ghost message.
+	void HandleNetworkMessage(StringHash eventType, VariantMap& eventData);
+	/// Handle update. Send the pending batch and move the ghosts.
+	void HandleUpdate(StringHash eventType, VariantMap& eventData);
+	/// Handle a message from a client.
+	void HandleServerMessage(Connection* connection, int msgID, const PODVector<unsigned char>& data);
+	/// Handle a message from the server.
+	void HandleClientMessage(int msgID, const PODVector<unsigned char>& data);
+	/// Send a message with a ghost ID prepended to all clients except one.
+	void Relay(Connection* except, int msgID, unsigned ghostID, const unsigned char* data, unsigned size);
+	/// Send the pending batch of the local run.
+	void SendBatch();
+	/// Return a ghost, creating its node if needed.
+	Ghost& GetGhost(unsigned ghostID);
+	/// Start a ghost's simulation over on the local track.
+	void RestartGhost(Ghost& ghost);
+	/// Simulate a ghost up to a step of the local run. Return false if it can not be placed from the simulation there.
+	bool SimulateGhost(Ghost& ghost, unsigned step);
+	/// Start re-simulating a finished run whose claimed score would make it the best run.
+	void CheckBestRun(const Vector<PODVector<unsigned char> >& batches, int score);
+	/// Re-simulate a slice of the claimed best run, and replace the best run with it once confirmed.
+	void UpdateBestRunCheck();
+
+	/// Scene.
+	WeakPtr<Scene> scene_;
+	/// Local level.
+	WeakPtr<RunnerLevel> level_;
+	/// Recorder of the local run.
+	GhostRecorder recorder_;
+	/// Ghosts by ID.
+	HashMap<unsigned, Ghost> ghosts_;
+	/// Server side runs by connection.
+	HashMap<Connection*, RemoteRun> remoteRuns_;
+	/// Server side batches of the best finished run.
+	Vector<PODVector<unsigned char> > bestRun_;
+	/// Server side best finished score.
+	int bestScore_;
+	/// Server side re-simulation of a claimed best run.
+	SharedPtr<RaceMatch> candidate_;
+	/// Server side batches of the claimed best run.
+	Vector<PODVector<unsigned char> > candidateRun_;
+	/// Next server side ghost ID.
+	unsigned nextGhostID_;
+	/// Level seed.
+	unsigned seed_;
+	/// Level seed received flag.
+	bool hasSeed_;
+	/// Local run in progress flag.
+	bool running_;
+	/// Time since the last batch was sent.
+	float sendTimer_;
+	/// Bytes sent by the local run in the current second.
+	unsigned bytesSent_;
+	/// Time the bytes are counted over.
+	float rateTimer_;
+	/// Reusable message buffer.
+	VectorBuffer message_;
+};
@@ -0,0 +1,81 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "HudCounter.h"
+#include "Text.h"
+
+#include <cstdio>
+
+HudCounter::HudCounter() :
+	format_("%d"),
+	value_(0),
+	valid_(false),
+	pending_(false),
+	numUpdates_(0)
+{
+	buffer_[0] = 0;
+	// Reserve once so that later updates reuse the same storage.
+	string_.Reserve(HUD_COUNTER_CHARS);
+}
+
+void HudCounter::SetText(Text* text, const char* format)
+{
+	text_ = text;
+	format_ = format;
+	valid_ = false;
+}
+
+bool HudCounter::SetValue(int value)
+{
+	return Format(value) && Apply();
+}
+
+bool HudCounter::Format(int value)
+{
+	if (valid_ && value == value_)
+		return false;
+
+	value_ = value;
+	valid_ = true;
+
+	// A 32-bit integer needs at most 11 characters, the formats used here leave room for that.
+	sprintf(buffer_, format_, value);
+	pending_ = true;
+	return true;
+}
+
+bool HudCounter::Apply()
+{
+	if (!pending_ || !text_)
+		return false;
+
+	pending_ = false;
+	string_ = buffer_;
+	text_->SetText(string_);
+	++numUpdates_;
+	return true;
+}
+
+Text* HudCounter::GetText() const
+{
+	return text_;
+}
@@ -0,0 +1,81 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "Ptr.h"
+#include "Str.h"
+
+using namespace Urho3D;
+
+namespace Urho3D
+{
+	class Text;
+}
+
+/// Capacity of the counter text buffer, including the terminator.
+static const unsigned HUD_COUNTER_CHARS = 32;
+
+/// Numeric HUD counter. Formats into a fixed buffer and touches the Text element only when the value changes.
+class HudCounter
+{
+public:
+	/// Construct.
+	HudCounter();
+
+	/// Set the text element and the printf format with one integer conversion, for example "Score %d".
+	void SetText(Text* text, const char* format);
+	/// Set the value. Return true if the text element had to be updated.
+	bool SetValue(int value);
+	/// Format a value into the buffer without touching the text element, so it can run on a worker thread. Return true if
+	/// the value changed.
+	bool Format(int value);
+	/// Pass the last formatted value to the text element. Return true if the text element had to be updated.
+	bool Apply();
+	/// Force the next SetValue to update the text element.
+	void Invalidate() { valid_ = false; }
+
+	/// Return the text element.
+	Text* GetText() const;
+	/// Return the current value.
+	int GetValue() const { return value_; }
+	/// Return how many times the text element has been updated.
+	unsigned GetNumUpdates() const { return numUpdates_; }
+
+private:
+	/// Text element.
+	WeakPtr<Text> text_;
+	/// Format string.
+	const char* format_;
+	/// Formatting buffer.
+	char buffer_[HUD_COUNTER_CHARS];
+	/// Text passed to the element. Kept so that its capacity is reused.
+	String string_;
+	/// Displayed value.
+	int value_;
+	/// Displayed value valid flag.
+	bool valid_;
+	/// Formatted value not yet passed to the text element flag.
+	bool pending_;
+	/// Number of text element updates.
+	unsigned numUpdates_;
+};
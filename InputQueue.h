@@ -0,0 +1,119 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "Vector2.h"
+
+#include <SDL/SDL_atomic.h>
+
+using namespace Urho3D;
+
+enum InputEventType
+{
+	INPUT_TOUCH_BEGIN = 0,
+	INPUT_TOUCH_MOVE,
+	INPUT_TOUCH_END
+};
+
+/// Raw input sample, stamped with the SDL tick count at the time it was received.
+struct InputEvent
+{
+	/// Construct undefined.
+	InputEvent()
+	{
+	}
+
+	/// Construct with values.
+	InputEvent(InputEventType type, int touchID, const IntVector2& position, unsigned timestamp) :
+		type_(type),
+		touchID_(touchID),
+		position_(position),
+		timestamp_(timestamp)
+	{
+	}
+
+	/// Event type.
+	InputEventType type_;
+	/// Touch (finger) ID.
+	int touchID_;
+	/// Screen position.
+	IntVector2 position_;
+	/// SDL ticks in milliseconds.
+	unsigned timestamp_;
+};
+
+/// Fixed-size lock-free ring buffer for a single producer and a single consumer. Capacity must be a power of two.
+template <class T, unsigned Capacity> class InputRing
+{
+public:
+	/// Construct empty.
+	InputRing() :
+		head_(0),
+		tail_(0)
+	{
+	}
+
+	/// Push an item from the producer side. Return false and drop the item if the ring is full.
+	bool Push(const T& item)
+	{
+		unsigned head = head_;
+		if (head - tail_ >= Capacity)
+			return false;
+
+		items_[head & (Capacity - 1)] = item;
+		// Make the item visible before publishing the new head.
+		SDL_MemoryBarrierRelease();
+		head_ = head + 1;
+		return true;
+	}
+
+	/// Pop an item from the consumer side. Return false if the ring is empty.
+	bool Pop(T& item)
+	{
+		unsigned tail = tail_;
+		if (tail == head_)
+			return false;
+
+		SDL_MemoryBarrierAcquire();
+		item = items_[tail & (Capacity - 1)];
+		SDL_CompilerBarrier();
+		tail_ = tail + 1;
+		return true;
+	}
+
+	/// Discard all items. Only safe to call from the consumer side.
+	void Clear() { tail_ = head_; }
+
+	/// Return number of queued items.
+	unsigned Size() const { return head_ - tail_; }
+	/// Return whether the ring is empty.
+	bool Empty() const { return head_ == tail_; }
+
+private:
+	/// Item storage.
+	T items_[Capacity];
+	/// Write position, only modified by the producer.
+	volatile unsigned head_;
+	/// Read position, only modified by the consumer.
+	volatile unsigned tail_;
+};
@@ -0,0 +1,228 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "CoreEvents.h"
+#include "DebugHud.h"
+#include "Engine.h"
+#include "File.h"
+#include "GraphicsEvents.h"
+#include "InputEvents.h"
+#include "LatencyTracer.h"
+#include "Log.h"
+
+#include <SDL/SDL_timer.h>
+
+static const char* stageNames[] =
+{
+	"Total",
+	"Controls",
+	"Impulse",
+	"Render"
+};
+
+LatencyHistogram::LatencyHistogram()
+{
+	Clear();
+}
+
+void LatencyHistogram::Add(unsigned ms)
+{
+	unsigned bucket = ms / LATENCY_BUCKET_MS;
+	if (bucket >= LATENCY_BUCKETS)
+		bucket = LATENCY_BUCKETS - 1;
+
+	++buckets_[bucket];
+	++count_;
+	sum_ += ms;
+	if (ms > max_)
+		max_ = ms;
+}
+
+void LatencyHistogram::Clear()
+{
+	for (unsigned i = 0; i < LATENCY_BUCKETS; ++i)
+		buckets_[i] = 0;
+
+	count_ = 0;
+	sum_ = 0;
+	max_ = 0;
+}
+
+unsigned LatencyHistogram::GetPercentile(float fraction) const
+{
+	if (!count_)
+		return 0;
+
+	unsigned target = (unsigned)(fraction * (float)count_);
+	unsigned accumulated = 0;
+	for (unsigned i = 0; i < LATENCY_BUCKETS; ++i)
+	{
+		accumulated += buckets_[i];
+		if (accumulated > target)
+			return (i + 1) * LATENCY_BUCKET_MS;
+	}
+
+	return max_;
+}
+
+LatencyTracer::LatencyTracer(Context* context) :
+	Object(context),
+	hudTimer_(0.0f)
+{
+	Clear();
+
+	SubscribeToEvent(E_KEYDOWN, HANDLER(LatencyTracer, HandleKeyDown));
+	SubscribeToEvent(E_UPDATE, HANDLER(LatencyTracer, HandleUpdate));
+
+	// Without graphics there is no rendering event, the end of the frame is the closest equivalent.
+	Engine* engine = GetSubsystem<Engine>();
+	if (engine && engine->IsHeadless())
+		SubscribeToEvent(E_ENDFRAME, HANDLER(LatencyTracer, HandleEndRendering));
+	else
+		SubscribeToEvent(E_ENDRENDERING, HANDLER(LatencyTracer, HandleEndRendering));
+}
+
+void LatencyTracer::MapKey(int key, int control)
+{
+	keys_[key] = control;
+}
+
+void LatencyTracer::BeginInput(int control, unsigned timestamp)
+{
+	Trace* trace = GetTrace(control);
+	if (!trace)
+		return;
+
+	// A new press of the same control supersedes an unfinished trace.
+	trace->stamps_[LATENCY_INPUT] = timestamp;
+	trace->next_ = LATENCY_CONTROLS;
+	trace->active_ = true;
+}
+
+void LatencyTracer::Mark(int control, LatencyStage stage)
+{
+	Trace* trace = GetTrace(control);
+	if (!trace || !trace->active_ || trace->next_ != (unsigned)stage)
+		return;
+
+	trace->stamps_[stage] = SDL_GetTicks();
+	++trace->next_;
+}
+
+void LatencyTracer::Clear()
+{
+	for (unsigned i = 0; i < MAX_TRACED_CONTROLS; ++i)
+	{
+		traces_[i].next_ = LATENCY_INPUT;
+		traces_[i].active_ = false;
+	}
+
+	for (unsigned i = 0; i < MAX_LATENCY_STAGES; ++i)
+		histograms_[i].Clear();
+}
+
+bool LatencyTracer::SaveHistograms(const String& fileName) const
+{
+	File file(context_);
+	if (!file.Open(fileName, FILE_WRITE))
+		return false;
+
+	String header = "BucketMs";
+	for (unsigned i = 0; i < MAX_LATENCY_STAGES; ++i)
+		header += "," + String(stageNames[i]);
+	file.WriteLine(header);
+
+	for (unsigned bucket = 0; bucket < LATENCY_BUCKETS; ++bucket)
+	{
+		String line(bucket * LATENCY_BUCKET_MS);
+		for (unsigned i = 0; i < MAX_LATENCY_STAGES; ++i)
+			line += "," + String(histograms_[i].buckets_[bucket]);
+		file.WriteLine(line);
+	}
+
+	LOGINFO("Saved input latency histograms to " + fileName);
+	return true;
+}
+
+LatencyTracer::Trace* LatencyTracer::GetTrace(int control)
+{
+	for (unsigned i = 0; i < MAX_TRACED_CONTROLS; ++i)
+	{
+		if (control & (1 << i))
+			return &traces_[i];
+	}
+
+	return 0;
+}
+
+void LatencyTracer::HandleKeyDown(StringHash eventType, VariantMap& eventData)
+{
+	using namespace KeyDown;
+
+	if (eventData[P_REPEAT].GetBool())
+		return;
+
+	HashMap<int, int>::ConstIterator it = keys_.Find(eventData[P_KEY].GetInt());
+	if (it != keys_.End())
+		BeginInput(it->second_, SDL_GetTicks());
+}
+
+void LatencyTracer::HandleEndRendering(StringHash eventType, VariantMap& eventData)
+{
+	unsigned now = SDL_GetTicks();
+
+	for (unsigned i = 0; i < MAX_TRACED_CONTROLS; ++i)
+	{
+		Trace& trace = traces_[i];
+		if (!trace.active_ || trace.next_ != LATENCY_RENDER)
+			continue;
+
+		trace.stamps_[LATENCY_RENDER] = now;
+		for (unsigned stage = LATENCY_CONTROLS; stage < MAX_LATENCY_STAGES; ++stage)
+			histograms_[stage].Add(trace.stamps_[stage] - trace.stamps_[stage - 1]);
+		histograms_[LATENCY_INPUT].Add(now - trace.stamps_[LATENCY_INPUT]);
+		trace.active_ = false;
+	}
+}
+
+void LatencyTracer::HandleUpdate(StringHash eventType, VariantMap& eventData)
+{
+	using namespace Update;
+
+	// Refresh twice a second to keep string building off the per-frame path.
+	hudTimer_ += eventData[P_TIMESTEP].GetFloat();
+	if (hudTimer_ < 0.5f)
+		return;
+	hudTimer_ = 0.0f;
+
+	DebugHud* debugHud = GetSubsystem<DebugHud>();
+	if (!debugHud)
+		return;
+
+	for (unsigned i = 0; i < MAX_LATENCY_STAGES; ++i)
+	{
+		const LatencyHistogram& histogram = histograms_[i];
+		debugHud->SetAppStats("Latency " + String(stageNames[i]), ToString("avg %.1f p50 %u p95 %u max %u ms (%u)",
+			histogram.GetAverage(), histogram.GetPercentile(0.5f), histogram.GetPercentile(0.95f), histogram.max_,
+			histogram.count_));
+	}
+}
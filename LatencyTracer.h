@@ -0,0 +1,128 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "HashMap.h"
+#include "Object.h"
+
+using namespace Urho3D;
+
+/// Points an input passes through on its way to the screen.
+enum LatencyStage
+{
+	/// Input event received from SDL.
+	LATENCY_INPUT = 0,
+	/// Written into the character controls.
+	LATENCY_CONTROLS,
+	/// Acted upon by the character fixed update (impulse applied.)
+	LATENCY_IMPULSE,
+	/// First frame submitted after the impulse.
+	LATENCY_RENDER,
+	MAX_LATENCY_STAGES
+};
+
+/// Number of histogram buckets.
+static const unsigned LATENCY_BUCKETS = 50;
+/// Width of one histogram bucket in milliseconds. The last bucket collects everything above.
+static const unsigned LATENCY_BUCKET_MS = 4;
+/// Number of control bits traced.
+static const unsigned MAX_TRACED_CONTROLS = 8;
+
+/// Latency histogram in milliseconds.
+struct LatencyHistogram
+{
+	/// Construct empty.
+	LatencyHistogram();
+
+	/// Add a sample.
+	void Add(unsigned ms);
+	/// Reset all samples.
+	void Clear();
+	/// Return the sample value at the given fraction (0-1) of the distribution, in bucket resolution.
+	unsigned GetPercentile(float fraction) const;
+	/// Return the average.
+	float GetAverage() const { return count_ ? (float)sum_ / (float)count_ : 0.0f; }
+
+	/// Bucket counts.
+	unsigned buckets_[LATENCY_BUCKETS];
+	/// Number of samples.
+	unsigned count_;
+	/// Sum of samples.
+	unsigned sum_;
+	/// Largest sample.
+	unsigned max_;
+};
+
+/// End-to-end input latency tracer. Follows each traced control from the SDL event to the first rendered frame after the character reacted.
+class LatencyTracer : public Object
+{
+	OBJECT(LatencyTracer);
+
+public:
+	/// Construct.
+	LatencyTracer(Context* context);
+
+	/// Map a key to the control bit it drives, so that key presses get traced.
+	void MapKey(int key, int control);
+	/// Start a trace for a control with the SDL tick count of the input event.
+	void BeginInput(int control, unsigned timestamp);
+	/// Record that a traced control passed a stage.
+	void Mark(int control, LatencyStage stage);
+	/// Drop all traces and histograms.
+	void Clear();
+	/// Write the histograms as CSV text.
+	bool SaveHistograms(const String& fileName) const;
+
+	/// Return the histogram from the previous stage to the given stage, or from input to render for LATENCY_INPUT.
+	const LatencyHistogram& GetHistogram(LatencyStage stage) const { return histograms_[stage]; }
+
+private:
+	/// In-flight trace of one control.
+	struct Trace
+	{
+		/// SDL ticks at each stage.
+		unsigned stamps_[MAX_LATENCY_STAGES];
+		/// Next stage expected.
+		unsigned next_;
+		/// Trace in flight flag.
+		bool active_;
+	};
+
+	/// Return the trace slot of a control bit, or 0 if not traced.
+	Trace* GetTrace(int control);
+	/// Handle key down. Start traces for mapped keys.
+	void HandleKeyDown(StringHash eventType, VariantMap& eventData);
+	/// Handle frame submission. Complete traces that reached the impulse stage.
+	void HandleEndRendering(StringHash eventType, VariantMap& eventData);
+	/// Handle update. Refresh the debug HUD statistics.
+	void HandleUpdate(StringHash eventType, VariantMap& eventData);
+
+	/// Traces indexed by control bit.
+	Trace traces_[MAX_TRACED_CONTROLS];
+	/// Per-stage histograms. Index 0 holds the total.
+	LatencyHistogram histograms_[MAX_LATENCY_STAGES];
+	/// Key to control bit mapping.
+	HashMap<int, int> keys_;
+	/// Time since the debug HUD statistics were refreshed.
+	float hudTimer_;
+};
@@ -0,0 +1,230 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "CoreEvents.h"
+#include "File.h"
+#include "FileSystem.h"
+#include "Leaderboard.h"
+#include "Log.h"
+#include "Network.h"
+#include "Random.h"
+#include "StringUtils.h"
+#include "Timer.h"
+
+/// Most results posted in one request.
+static const unsigned MAX_BATCH_RESULTS = 16;
+/// Most results kept while the server is unreachable.
+static const unsigned MAX_PENDING_RESULTS = 256;
+/// Seconds a first result waits for others to join its batch.
+static const float BATCH_DELAY = 2.0f;
+/// Seconds before the first retry. Doubles with each further failure.
+static const float RETRY_BASE_DELAY = 1.0f;
+/// Longest retry delay in seconds.
+static const float RETRY_MAX_DELAY = 120.0f;
+/// Seconds after which a request is given up.
+static const float REQUEST_TIMEOUT = 15.0f;
+
+Leaderboard::Leaderboard(Context* context) :
+	Object(context),
+	numSending_(0),
+	failures_(0),
+	waitTimer_(0.0f),
+	requestTimer_(0.0f),
+	highScore_(0),
+	serverBest_(-1),
+	dirty_(false)
+{
+	SubscribeToEvent(E_UPDATE, HANDLER(Leaderboard, HandleUpdate));
+}
+
+void Leaderboard::Load(const String& fileName)
+{
+	fileName_ = fileName;
+
+	File file(context_);
+	if (GetSubsystem<FileSystem>()->FileExists(fileName) && file.Open(fileName, FILE_READ) && file.ReadFileID() == "ARLB")
+	{
+		playerID_ = file.ReadString();
+		highScore_ = file.ReadInt();
+		unsigned numPending = file.ReadVLE();
+		for (unsigned i = 0; i < numPending && !file.IsEof(); ++i)
+		{
+			RunResult result;
+			result.score_ = file.ReadInt();
+			result.distance_ = file.ReadInt();
+			result.coins_ = file.ReadInt();
+			pending_.Push(result);
+		}
+	}
+
+	if (playerID_.Empty())
+	{
+		playerID_ = ToString("%04x%04x%08x", Rand(), Rand(), Time::GetSystemTime());
+		dirty_ = true;
+	}
+}
+
+bool Leaderboard::Save()
+{
+	if (!dirty_ || fileName_.Empty())
+		return true;
+
+	File file(context_);
+	if (!file.Open(fileName_, FILE_WRITE))
+		return false;
+
+	file.WriteFileID("ARLB");
+	file.WriteString(playerID_);
+	file.WriteInt(highScore_);
+	file.WriteVLE(pending_.Size());
+	for (unsigned i = 0; i < pending_.Size(); ++i)
+	{
+		file.WriteInt(pending_[i].score_);
+		file.WriteInt(pending_[i].distance_);
+		file.WriteInt(pending_[i].coins_);
+	}
+
+	dirty_ = false;
+	return true;
+}
+
+void Leaderboard::SetURL(const String& url)
+{
+	url_ = url;
+}
+
+bool Leaderboard::Submit(const RunResult& result)
+{
+	// A first result waits a moment, so that quick restarts end up in one request
+	if (pending_.Empty() && !failures_)
+		waitTimer_ = BATCH_DELAY;
+
+	if (pending_.Size() < MAX_PENDING_RESULTS)
+		pending_.Push(result);
+	dirty_ = true;
+
+	if (result.score_ <= highScore_)
+		return false;
+
+	highScore_ = result.score_;
+	return true;
+}
+
+void Leaderboard::HandleUpdate(StringHash eventType, VariantMap& eventData)
+{
+	using namespace Update;
+
+	float timeStep = eventData[P_TIMESTEP].GetFloat();
+
+	for (unsigned i = abandoned_.Size() - 1; i < abandoned_.Size(); --i)
+	{
+		HttpRequestState state = abandoned_[i]->GetState();
+		if (state == HTTP_ERROR || state == HTTP_CLOSED)
+			abandoned_.Erase(i);
+	}
+
+	if (request_)
+	{
+		HttpRequestState state = request_->GetState();
+		if (state == HTTP_ERROR)
+		{
+			LOGWARNING("Leaderboard request failed: " + request_->GetError());
+			EndRequest(false);
+			return;
+		}
+
+		// Read only what has arrived, a larger read would block until more data comes in
+		unsigned available = request_->GetAvailableSize();
+		if (available)
+		{
+			unsigned start = response_.Length();
+			response_.Resize(start + available);
+			response_.Resize(start + request_->Read(&response_[start], available));
+		}
+
+		if (state == HTTP_CLOSED)
+		{
+			EndRequest(response_.StartsWith("OK"));
+		}
+		else if ((requestTimer_ += timeStep) > REQUEST_TIMEOUT)
+		{
+			LOGWARNING("Leaderboard request timed out");
+			abandoned_.Push(request_);
+			EndRequest(false);
+		}
+		return;
+	}
+
+	if (url_.Empty() || pending_.Empty())
+		return;
+
+	waitTimer_ -= timeStep;
+	if (waitTimer_ <= 0.0f)
+		BeginRequest();
+}
+
+void Leaderboard::BeginRequest()
+{
+	// One line per result after the player ID
+	numSending_ = Min((int)pending_.Size(), (int)MAX_BATCH_RESULTS);
+	String body = playerID_ + "\n";
+	for (unsigned i = 0; i < numSending_; ++i)
+		body += String(pending_[i].score_) + " " + String(pending_[i].distance_) + " " + String(pending_[i].coins_) + "\n";
+
+	Vector<String> headers;
+	headers.Push("Content-Type: text/plain");
+	response_.Clear();
+	requestTimer_ = 0.0f;
+	// The connection is made on the request's own thread
+	request_ = GetSubsystem<Network>()->MakeHttpRequest(url_, "POST", headers, body);
+	if (!request_)
+		EndRequest(false);
+}
+
+void Leaderboard::EndRequest(bool success)
+{
+	if (success)
+	{
+		// The server answers "OK <best score>"
+		Vector<String> words = response_.Split(' ');
+		if (words.Size() > 1)
+			serverBest_ = ToInt(words[1].Trimmed());
+
+		pending_.Erase(0, numSending_);
+		failures_ = 0;
+		waitTimer_ = 0.0f;
+		dirty_ = true;
+	}
+	else
+	{
+		// Jitter keeps clients that failed together from retrying together
+		++failures_;
+		float delay = Min(RETRY_BASE_DELAY * (float)(1 << Min((int)failures_ - 1, 16)), RETRY_MAX_DELAY);
+		waitTimer_ = delay * Random(0.5f, 1.0f);
+		LOGINFO(ToString("Leaderboard retry in %.1f s, %u results pending", waitTimer_, pending_.Size()));
+	}
+
+	request_.Reset();
+	response_.Clear();
+	numSending_ = 0;
+}
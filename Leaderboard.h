@@ -0,0 +1,107 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "HttpRequest.h"
+#include "Object.h"
+
+using namespace Urho3D;
+
+/// Finished run as reported to the leaderboard.
+struct RunResult
+{
+	/// Score.
+	int score_;
+	/// Distance run.
+	int distance_;
+	/// Coins picked up.
+	int coins_;
+};
+
+/// Leaderboard client. Keeps the local high score and queues run results, which are posted in batches by the engine's
+/// HTTP requests on their own threads. Failed batches are retried with exponential backoff. The game loop only polls the
+/// request state and reads bytes already received, and the queue is written to disk only when asked to.
+class Leaderboard : public Object
+{
+	OBJECT(Leaderboard);
+
+public:
+	/// Construct.
+	Leaderboard(Context* context);
+
+	/// Load the player ID, high score and unsent results from a file. A missing file starts a new player.
+	void Load(const String& fileName);
+	/// Write the player ID, high score and unsent results back, if they changed.
+	bool Save();
+	/// Set the URL results are posted to. Empty keeps the results local.
+	void SetURL(const String& url);
+	/// Queue a run result. Return true if it is a new local high score.
+	bool Submit(const RunResult& result);
+
+	/// Return the local high score.
+	int GetHighScore() const { return highScore_; }
+	/// Return the best score reported by the server, or -1 if none has been received.
+	int GetServerBest() const { return serverBest_; }
+	/// Return number of results not yet accepted by the server.
+	unsigned GetNumPending() const { return pending_.Size(); }
+	/// Return whether a batch is in flight.
+	bool IsSubmitting() const { return request_.NotNull(); }
+
+private:
+	/// Handle update. Start, poll and complete requests.
+	void HandleUpdate(StringHash eventType, VariantMap& eventData);
+	/// Post the oldest results.
+	void BeginRequest();
+	/// Complete the request in flight. Drop the sent results on success, schedule a retry otherwise.
+	void EndRequest(bool success);
+
+	/// File name.
+	String fileName_;
+	/// Server URL.
+	String url_;
+	/// Player ID sent with each batch.
+	String playerID_;
+	/// Results not yet accepted by the server, oldest first.
+	PODVector<RunResult> pending_;
+	/// Request in flight.
+	SharedPtr<HttpRequest> request_;
+	/// Timed out requests, kept until their threads finish so that releasing them does not wait.
+	Vector<SharedPtr<HttpRequest> > abandoned_;
+	/// Response received so far.
+	String response_;
+	/// Results in the request in flight.
+	unsigned numSending_;
+	/// Consecutive failures.
+	unsigned failures_;
+	/// Time until the next request may start.
+	float waitTimer_;
+	/// Time the request in flight has taken.
+	float requestTimer_;
+	/// Local high score.
+	int highScore_;
+	/// Best score reported by the server.
+	int serverBest_;
+	/// Changed since loaded or saved flag.
+	bool dirty_;
+};
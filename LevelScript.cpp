@@ -0,0 +1,198 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "LevelScript.h"
+#include "FileSystem.h"
+#include "Log.h"
+#include "LuaFunction.h"
+#include "ResourceCache.h"
+
+#ifdef ENABLE_ANGELSCRIPT
+#include "Script.h"
+#include "ScriptFile.h"
+#include <AngelScript/angelscript.h>
+#endif
+
+#ifdef ENABLE_LUA
+#include "LuaScript.h"
+#endif
+
+LevelScript::LevelScript(Context* context) :
+	Object(context),
+	scriptFunction_(0),
+	scriptContext_(0),
+	numCalls_(0),
+	callTime_(0)
+{
+}
+
+LevelScript::~LevelScript()
+{
+	Clear();
+}
+
+bool LevelScript::Load(const String& fileName)
+{
+	Clear();
+	String extension = GetExtension(fileName);
+
+#ifdef ENABLE_ANGELSCRIPT
+	if (extension == ".as")
+	{
+		scriptFile_ = GetSubsystem<ResourceCache>()->GetResource<ScriptFile>(fileName);
+		if (scriptFile_)
+			scriptFunction_ = scriptFile_->GetFunction("void ChooseBlocks(uint, uint, uint, uint, VectorBuffer&)");
+		if (!scriptFunction_)
+		{
+			LOGERROR("Level script " + fileName + " has no ChooseBlocks function");
+			scriptFile_.Reset();
+			return false;
+		}
+		scriptContext_ = GetSubsystem<Script>()->GetScriptEngine()->CreateContext();
+	}
+#endif
+
+#ifdef ENABLE_LUA
+	if (extension == ".lua")
+	{
+		LuaScript* luaScript = GetSubsystem<LuaScript>();
+		if (luaScript->ExecuteFile(fileName))
+			luaFunction_ = luaScript->GetFunction("ChooseBlocks", true);
+		if (!luaFunction_)
+		{
+			LOGERROR("Level script " + fileName + " has no ChooseBlocks function");
+			return false;
+		}
+	}
+#endif
+
+	if (!IsLoaded())
+	{
+		LOGERROR("Level script " + fileName + " is not in a supported script language");
+		return false;
+	}
+
+	// Room for the largest batch up front, so the script's writes never grow the buffer
+	output_.Resize(LEVEL_SCRIPT_BATCH * sizeof(BlockChoice));
+	output_.Clear();
+	fileName_ = fileName;
+	loadTimer_.Reset();
+	LOGINFO("Level script " + fileName + " loaded");
+	return true;
+}
+
+void LevelScript::Clear()
+{
+	fileName_.Clear();
+#ifdef ENABLE_ANGELSCRIPT
+	if (scriptContext_)
+		scriptContext_->Release();
+#endif
+	scriptContext_ = 0;
+	scriptFile_.Reset();
+	scriptFunction_ = 0;
+	luaFunction_.Reset();
+	numCalls_ = 0;
+	callTime_ = 0;
+}
+
+unsigned LevelScript::ChooseBlocks(unsigned firstBlock, unsigned count, unsigned numPrefabs, unsigned seed,
+	PODVector<BlockChoice>& choices)
+{
+	if (!IsLoaded() || !count || !numPrefabs)
+		return 0;
+
+	HiresTimer callTimer;
+	output_.Clear();
+	bool success = scriptFunction_ ? CallAngelScript(firstBlock, count, numPrefabs, seed) :
+		CallLua(firstBlock, count, numPrefabs, seed);
+	callTime_ += callTimer.GetUSec(false);
+	++numCalls_;
+
+	if (!success)
+	{
+		// A broken script would fail on every batch, fall back to the built-in rules for the rest of the session
+		LOGERROR("Level script " + fileName_ + " failed, using the built-in block choice");
+		Clear();
+		return 0;
+	}
+
+	unsigned numChoices = Min((int)(output_.GetSize() / sizeof(BlockChoice)), (int)count);
+	const unsigned char* data = output_.GetData();
+	for (unsigned i = 0; i < numChoices; ++i)
+	{
+		BlockChoice choice;
+		choice.block_ = (unsigned char)(data[i * 2] % numPrefabs);
+		choice.group_ = data[i * 2 + 1];
+		choices.Push(choice);
+	}
+
+	return numChoices;
+}
+
+bool LevelScript::IsLoaded() const
+{
+	return scriptFunction_ || luaFunction_;
+}
+
+float LevelScript::GetTimeShare() const
+{
+	long long elapsed = loadTimer_.GetUSec(false);
+	return elapsed > 0 ? (float)callTime_ / (float)elapsed : 0.0f;
+}
+
+bool LevelScript::CallAngelScript(unsigned firstBlock, unsigned count, unsigned numPrefabs, unsigned seed)
+{
+#ifdef ENABLE_ANGELSCRIPT
+	// Use an own context rather than ScriptFile::Execute, which passes the arguments in a VariantVector
+	if (scriptContext_->Prepare(scriptFunction_) < 0)
+		return false;
+
+	scriptContext_->SetArgDWord(0, firstBlock);
+	scriptContext_->SetArgDWord(1, count);
+	scriptContext_->SetArgDWord(2, numPrefabs);
+	scriptContext_->SetArgDWord(3, seed);
+	scriptContext_->SetArgAddress(4, &output_);
+	return scriptContext_->Execute() == asEXECUTION_FINISHED;
+#else
+	return false;
+#endif
+}
+
+bool LevelScript::CallLua(unsigned firstBlock, unsigned count, unsigned numPrefabs, unsigned seed)
+{
+#ifdef ENABLE_LUA
+	LuaFunction* function = luaFunction_;
+	if (!function || !function->BeginCall())
+		return false;
+
+	function->PushInt((int)firstBlock);
+	function->PushInt((int)count);
+	function->PushInt((int)numPrefabs);
+	function->PushInt((int)(seed & 0x7fffffff));
+	function->PushUserType(output_, "VectorBuffer");
+	return function->EndCall();
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,113 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "Timer.h"
+#include "Object.h"
+#include "VectorBuffer.h"
+
+using namespace Urho3D;
+
+namespace Urho3D
+{
+	class LuaFunction;
+	class ScriptFile;
+}
+
+class asIScriptContext;
+class asIScriptFunction;
+
+/// Number of block choices asked from the level script at once.
+static const unsigned LEVEL_SCRIPT_BATCH = 16;
+
+/// One block choice of the level script.
+struct BlockChoice
+{
+	/// Block prefab index, taken modulo the number of prefabs.
+	unsigned char block_;
+	/// Item group index, taken modulo the number of groups of the block.
+	unsigned char group_;
+};
+
+/// Block selection and difficulty rules of the level generator in AngelScript (.as) or Lua (.lua). The script defines
+///
+///     ChooseBlocks(firstBlock, count, numPrefabs, seed, choices)
+///
+/// and writes up to count block and group index pairs with choices.WriteUByte(). One call covers a whole batch, so the
+/// script's own loop stays inside the script (and on the LuaJIT trace) instead of crossing into C++ per decision. The
+/// arguments are plain integers and the output buffer is reused, so a call does not allocate once the buffer has grown.
+class LevelScript : public Object
+{
+	OBJECT(LevelScript);
+
+public:
+	/// Construct.
+	LevelScript(Context* context);
+	/// Destruct.
+	virtual ~LevelScript();
+
+	/// Load a script file and look up its ChooseBlocks function. Return false if the language is not compiled in or
+	/// the function is missing.
+	bool Load(const String& fileName);
+	/// Forget the script.
+	void Clear();
+	/// Ask the script for the choices of the next blocks, appended to choices. Return the number of choices made.
+	unsigned ChooseBlocks(unsigned firstBlock, unsigned count, unsigned numPrefabs, unsigned seed, PODVector<BlockChoice>& choices);
+
+	/// Return whether a script is loaded.
+	bool IsLoaded() const;
+	/// Return the loaded script file name.
+	const String& GetFileName() const { return fileName_; }
+	/// Return the number of script calls since loading.
+	unsigned GetNumCalls() const { return numCalls_; }
+	/// Return the time spent in the script since loading in microseconds.
+	long long GetCallTime() const { return callTime_; }
+	/// Return the share of the time since loading spent in the script.
+	float GetTimeShare() const;
+
+private:
+	/// Call the AngelScript function. Return false on script error.
+	bool CallAngelScript(unsigned firstBlock, unsigned count, unsigned numPrefabs, unsigned seed);
+	/// Call the Lua function. Return false on script error.
+	bool CallLua(unsigned firstBlock, unsigned count, unsigned numPrefabs, unsigned seed);
+
+	/// Script file name.
+	String fileName_;
+	/// AngelScript file.
+	SharedPtr<ScriptFile> scriptFile_;
+	/// AngelScript function.
+	asIScriptFunction* scriptFunction_;
+	/// AngelScript context the function is executed in.
+	asIScriptContext* scriptContext_;
+	/// Lua function.
+	WeakPtr<LuaFunction> luaFunction_;
+	/// Choices written by the script.
+	VectorBuffer output_;
+	/// Time since loading. Reading a timer is not const.
+	mutable HiresTimer loadTimer_;
+	/// Script calls since loading.
+	unsigned numCalls_;
+	/// Time spent in the script since loading in microseconds.
+	long long callTime_;
+};
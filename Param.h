@@ -15,4 +15,5 @@ namespace GameVariants
 	PARAM(P_ISINPLATFORM, IsInPlatform);
 	PARAM(P_ISOBSTACLE, IsObstacle);
 	PARAM(P_ISANIMATED, IsAnimated);
+	PARAM(P_PREFAB, Prefab);
 }
@@ -0,0 +1,290 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "BlockPool.h"
+#include "Camera.h"
+#include "CoreEvents.h"
+#include "DebugRenderer.h"
+#include "Font.h"
+#include "GameMemory.h"
+#include "Graphics.h"
+#include "PerfOverlay.h"
+#include "PhysicsEvents.h"
+#include "PhysicsWorld.h"
+#include "Renderer.h"
+#include "ResourceCache.h"
+#include "Scene.h"
+#include "StringUtils.h"
+#include "Text.h"
+#include "UI.h"
+
+/// Graph names and units for the labels.
+static const char* graphNames[] =
+{
+	"Frame %.1f ms",
+	"Physics %.2f ms",
+	"Streaming %.2f ms",
+	"Rivals %.2f ms",
+	"Frame jobs %.2f ms",
+	"Blocks %.0f",
+	"Coins %.0f",
+	"Drawables %.0f",
+	"Pooled %.0f",
+	"Allocated %.0f",
+	"Memory %.1f MB",
+	"Game allocs %.0f"
+};
+
+/// Smallest full scale of each graph, so that a flat graph does not fill the panel with noise.
+static const float graphMinScales[] =
+{
+	33.3f, 4.0f, 4.0f, 2.0f, 2.0f, 10.0f, 50.0f, 100.0f, 10.0f, 10.0f, 64.0f, 10.0f
+};
+
+/// Graph colors.
+static const Color graphColors[] =
+{
+	Color(1.0f, 1.0f, 1.0f),
+	Color(0.3f, 0.8f, 1.0f),
+	Color(1.0f, 0.6f, 0.2f),
+	Color(0.4f, 0.6f, 1.0f),
+	Color(1.0f, 0.4f, 0.4f),
+	Color(0.6f, 1.0f, 0.4f),
+	Color(1.0f, 0.9f, 0.2f),
+	Color(0.9f, 0.5f, 1.0f),
+	Color(0.5f, 0.9f, 0.9f),
+	Color(1.0f, 0.4f, 0.4f),
+	Color(0.7f, 0.7f, 1.0f),
+	Color(1.0f, 0.7f, 0.7f)
+};
+
+/// Panel layout in normalized screen coordinates.
+static const float PANEL_LEFT = 0.62f;
+static const float PANEL_WIDTH = 0.36f;
+static const float PANEL_TOP = 0.08f;
+static const float PANEL_HEIGHT = 0.86f;
+static const float GRAPH_SPACING = PANEL_HEIGHT / MAX_PERF_GRAPHS;
+static const float GRAPH_HEIGHT = GRAPH_SPACING * 0.85f;
+/// Frame time budget drawn on the frame graph.
+static const float FRAME_BUDGET_MS = 1000.0f / 60.0f;
+/// Label refresh interval in seconds.
+static const float LABEL_INTERVAL = 0.5f;
+
+PerfOverlay::PerfOverlay(Context* context) :
+	Object(context),
+	head_(0),
+	labelTimer_(0.0f),
+	drawTime_(0),
+	visible_(false)
+{
+	for (unsigned i = 0; i < MAX_PERF_GRAPHS; ++i)
+	{
+		current_[i] = 0.0f;
+		for (unsigned j = 0; j < PERF_HISTORY; ++j)
+			history_[i][j] = 0.0f;
+	}
+
+	SubscribeToEvent(E_BEGINFRAME, HANDLER(PerfOverlay, HandleBeginFrame));
+	SubscribeToEvent(E_POSTRENDERUPDATE, HANDLER(PerfOverlay, HandlePostRenderUpdate));
+}
+
+void PerfOverlay::SetScene(Scene* scene, Camera* camera)
+{
+	if (scene_)
+	{
+		PhysicsWorld* world = scene_->GetComponent<PhysicsWorld>();
+		UnsubscribeFromEvent(world, E_PHYSICSPRESTEP);
+		UnsubscribeFromEvent(world, E_PHYSICSPOSTSTEP);
+	}
+
+	scene_ = scene;
+	camera_ = camera;
+
+	// Subscribe before the game does, so that the step time includes the character logic run from the pre-step
+	if (scene_)
+	{
+		PhysicsWorld* world = scene_->GetComponent<PhysicsWorld>();
+		SubscribeToEvent(world, E_PHYSICSPRESTEP, HANDLER(PerfOverlay, HandlePhysicsPreStep));
+		SubscribeToEvent(world, E_PHYSICSPOSTSTEP, HANDLER(PerfOverlay, HandlePhysicsPostStep));
+	}
+}
+
+void PerfOverlay::SetBlockPool(BlockPool* pool)
+{
+	pool_ = pool;
+}
+
+void PerfOverlay::SetVisible(bool enable)
+{
+	visible_ = enable;
+
+	if (visible_ && !labels_[0])
+		CreateLabels();
+
+	for (unsigned i = 0; i < MAX_PERF_GRAPHS; ++i)
+	{
+		if (labels_[i])
+			labels_[i]->SetVisible(visible_);
+	}
+
+	if (visible_)
+		UpdateLabels();
+}
+
+void PerfOverlay::HandleBeginFrame(StringHash eventType, VariantMap& eventData)
+{
+	current_[PERF_FRAME] = (float)frameTimer_.GetUSec(true) * 0.001f;
+
+	if (pool_)
+	{
+		current_[PERF_BLOCKS] = (float)pool_->GetNumActive();
+		current_[PERF_COINS] = (float)pool_->GetNumLiveCoins();
+		current_[PERF_POOLED] = (float)pool_->GetNumPooled();
+		current_[PERF_ALLOCATED] = (float)pool_->GetNumInstantiated();
+	}
+	Renderer* renderer = GetSubsystem<Renderer>();
+	current_[PERF_DRAWABLES] = renderer ? (float)renderer->GetNumGeometries() : 0.0f;
+	current_[PERF_MEMORY] = (float)GetSubsystem<ResourceCache>()->GetTotalMemoryUse() / (1024.0f * 1024.0f);
+	GameMemory* memory = GetSubsystem<GameMemory>();
+	current_[PERF_HEAP] = memory ? (float)memory->GetFrameAllocations() : 0.0f;
+
+	for (unsigned i = 0; i < MAX_PERF_GRAPHS; ++i)
+	{
+		history_[i][head_] = current_[i];
+		current_[i] = 0.0f;
+	}
+	head_ = (head_ + 1) % PERF_HISTORY;
+
+	if (!visible_)
+		return;
+
+	// Text layout is not free, so the numbers follow at a readable rate instead of every frame
+	labelTimer_ += GetValue(PERF_FRAME) * 0.001f;
+	if (labelTimer_ >= LABEL_INTERVAL)
+	{
+		labelTimer_ = 0.0f;
+		UpdateLabels();
+	}
+}
+
+void PerfOverlay::HandlePhysicsPreStep(StringHash eventType, VariantMap& eventData)
+{
+	stepTimer_.Reset();
+}
+
+void PerfOverlay::HandlePhysicsPostStep(StringHash eventType, VariantMap& eventData)
+{
+	AddTime(PERF_PHYSICS, stepTimer_.GetUSec(false));
+}
+
+void PerfOverlay::HandlePostRenderUpdate(StringHash eventType, VariantMap& eventData)
+{
+	if (!visible_ || !scene_ || !camera_)
+		return;
+
+	DebugRenderer* debug = scene_->GetComponent<DebugRenderer>();
+	if (!debug)
+		return;
+
+	HiresTimer drawTimer;
+
+	// A plane at constant view depth maps affinely to the screen, so three points give every screen position
+	float depth = camera_->GetNearClip() * 2.0f;
+	Vector3 origin = camera_->ScreenToWorldPoint(Vector3(0.0f, 0.0f, depth));
+	Vector3 right = camera_->ScreenToWorldPoint(Vector3(1.0f, 0.0f, depth)) - origin;
+	Vector3 down = camera_->ScreenToWorldPoint(Vector3(0.0f, 1.0f, depth)) - origin;
+
+	unsigned frameColor = Color(0.4f, 0.4f, 0.4f).ToUInt();
+	unsigned budgetColor = Color(0.8f, 0.2f, 0.2f).ToUInt();
+	float step = PANEL_WIDTH / (float)(PERF_HISTORY - 1);
+
+	for (unsigned i = 0; i < MAX_PERF_GRAPHS; ++i)
+	{
+		const float* samples = history_[i];
+		float bottom = PANEL_TOP + i * GRAPH_SPACING + GRAPH_HEIGHT;
+
+		float scale = graphMinScales[i];
+		for (unsigned j = 0; j < PERF_HISTORY; ++j)
+			scale = Max(scale, samples[j]);
+		float unit = GRAPH_HEIGHT / scale;
+
+		Vector3 bottomLeft = origin + right * PANEL_LEFT + down * bottom;
+		Vector3 width = right * PANEL_WIDTH;
+		Vector3 height = down * -GRAPH_HEIGHT;
+		debug->AddLine(bottomLeft, bottomLeft + width, frameColor, false);
+		debug->AddLine(bottomLeft + height, bottomLeft + height + width, frameColor, false);
+		debug->AddLine(bottomLeft, bottomLeft + height, frameColor, false);
+		debug->AddLine(bottomLeft + width, bottomLeft + width + height, frameColor, false);
+
+		if (i == PERF_FRAME)
+		{
+			Vector3 budget = bottomLeft - down * (FRAME_BUDGET_MS * unit);
+			debug->AddLine(budget, budget + width, budgetColor, false);
+		}
+
+		// Oldest sample on the left
+		unsigned color = graphColors[i].ToUInt();
+		Vector3 last = bottomLeft - down * (samples[head_] * unit);
+		for (unsigned j = 1; j < PERF_HISTORY; ++j)
+		{
+			float value = samples[(head_ + j) % PERF_HISTORY];
+			Vector3 next = bottomLeft + right * (j * step) - down * (value * unit);
+			debug->AddLine(last, next, color, false);
+			last = next;
+		}
+	}
+
+	drawTime_ = drawTimer.GetUSec(false);
+}
+
+void PerfOverlay::CreateLabels()
+{
+	Font* font = GetSubsystem<ResourceCache>()->GetResource<Font>("Fonts/Anonymous Pro.ttf");
+	UIElement* root = GetSubsystem<UI>()->GetRoot();
+
+	for (unsigned i = 0; i < MAX_PERF_GRAPHS; ++i)
+	{
+		labels_[i] = root->CreateChild<Text>();
+		labels_[i]->SetFont(font, 10);
+		labels_[i]->SetColor(graphColors[i]);
+		labels_[i]->SetPriority(100);
+		labels_[i]->SetVisible(false);
+	}
+}
+
+void PerfOverlay::UpdateLabels()
+{
+	Graphics* graphics = GetSubsystem<Graphics>();
+	int width = graphics->GetWidth();
+	int height = graphics->GetHeight();
+
+	for (unsigned i = 0; i < MAX_PERF_GRAPHS; ++i)
+	{
+		String text = ToString(graphNames[i], GetValue((PerfGraph)i));
+		if (i == PERF_FRAME)
+			text += ToString(" (overlay %d us)", (int)drawTime_);
+
+		labels_[i]->SetText(text);
+		labels_[i]->SetPosition((int)((PANEL_LEFT + 0.005f) * width), (int)((PANEL_TOP + i * GRAPH_SPACING + 0.005f) * height));
+	}
+}
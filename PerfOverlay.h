@@ -0,0 +1,139 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "Color.h"
+#include "Object.h"
+#include "Timer.h"
+
+using namespace Urho3D;
+
+namespace Urho3D
+{
+	class Camera;
+	class Scene;
+	class Text;
+}
+
+class BlockPool;
+
+/// Graphed quantities.
+enum PerfGraph
+{
+	/// Frame time in milliseconds.
+	PERF_FRAME = 0,
+	/// Physics step time in milliseconds, summed over the steps of the frame.
+	PERF_PHYSICS,
+	/// Level streaming (path update, block creation and release) time in milliseconds.
+	PERF_STREAMING,
+	/// Rival crowd update time in milliseconds.
+	PERF_RIVALS,
+	/// Main thread time of the post-update frame jobs in milliseconds.
+	PERF_JOBS,
+	/// Active blocks.
+	PERF_BLOCKS,
+	/// Coins left in the active blocks.
+	PERF_COINS,
+	/// Geometries drawn.
+	PERF_DRAWABLES,
+	/// Blocks waiting in the pool.
+	PERF_POOLED,
+	/// Blocks instantiated from XML.
+	PERF_ALLOCATED,
+	/// Resource memory in megabytes.
+	PERF_MEMORY,
+	/// Heap allocations of the game layer in the frame.
+	PERF_HEAP,
+	MAX_PERF_GRAPHS
+};
+
+/// Number of frames graphed.
+static const unsigned PERF_HISTORY = 128;
+
+/// Game performance overlay. Keeps the last frames of each quantity in ring buffers and graphs them with debug lines in screen space.
+class PerfOverlay : public Object
+{
+	OBJECT(PerfOverlay);
+
+public:
+	/// Construct.
+	PerfOverlay(Context* context);
+
+	/// Set the scene and camera to draw with. The scene needs a DebugRenderer.
+	void SetScene(Scene* scene, Camera* camera);
+	/// Set the block pool whose counts are graphed.
+	void SetBlockPool(BlockPool* pool);
+	/// Show or hide.
+	void SetVisible(bool enable);
+	/// Toggle visibility.
+	void Toggle() { SetVisible(!visible_); }
+	/// Add time to a timed graph for the current frame.
+	void AddTime(PerfGraph graph, long long usec) { current_[graph] += (float)usec * 0.001f; }
+
+	/// Return whether visible.
+	bool IsVisible() const { return visible_; }
+	/// Return the latest completed sample of a graph.
+	float GetValue(PerfGraph graph) const { return history_[graph][(head_ + PERF_HISTORY - 1) % PERF_HISTORY]; }
+	/// Return the time the overlay spent drawing in the last frame, in microseconds.
+	long long GetDrawTime() const { return drawTime_; }
+
+private:
+	/// Handle frame begin. Complete the previous frame's samples.
+	void HandleBeginFrame(StringHash eventType, VariantMap& eventData);
+	/// Handle physics pre-step. Start timing the step.
+	void HandlePhysicsPreStep(StringHash eventType, VariantMap& eventData);
+	/// Handle physics post-step. Stop timing the step.
+	void HandlePhysicsPostStep(StringHash eventType, VariantMap& eventData);
+	/// Handle post-render update. Draw the graphs.
+	void HandlePostRenderUpdate(StringHash eventType, VariantMap& eventData);
+	/// Create the label texts.
+	void CreateLabels();
+	/// Refresh the label texts.
+	void UpdateLabels();
+
+	/// Scene.
+	WeakPtr<Scene> scene_;
+	/// Camera.
+	WeakPtr<Camera> camera_;
+	/// Block pool.
+	WeakPtr<BlockPool> pool_;
+	/// Graph labels.
+	SharedPtr<Text> labels_[MAX_PERF_GRAPHS];
+	/// Sample rings.
+	float history_[MAX_PERF_GRAPHS][PERF_HISTORY];
+	/// Samples of the frame in progress.
+	float current_[MAX_PERF_GRAPHS];
+	/// Ring write position.
+	unsigned head_;
+	/// Frame timer.
+	HiresTimer frameTimer_;
+	/// Physics step timer.
+	HiresTimer stepTimer_;
+	/// Time since the labels were refreshed.
+	float labelTimer_;
+	/// Time spent drawing in the last frame.
+	long long drawTime_;
+	/// Visible flag.
+	bool visible_;
+};
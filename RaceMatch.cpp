@@ -0,0 +1,174 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "Character.h"
+#include "GameEvents.h"
+#include "Octree.h"
+#include "PhysicsEvents.h"
+#include "PhysicsWorld.h"
+#include "RaceMatch.h"
+#include "RunnerLevel.h"
+#include "Scene.h"
+
+RaceMatch::RaceMatch(Context* context) :
+	Object(context),
+	scene_(new Scene(context)),
+	events_(new GameEventHub(context)),
+	level_(new RunnerLevel(context)),
+	keyframeCursor_(0),
+	inputStart_(0),
+	step_(0),
+	numMismatches_(0),
+	claimedScore_(0),
+	seed_(0),
+	running_(false),
+	ended_(false),
+	finished_(false)
+{
+	// Only the physics the game logic needs. Without interpolation each scene update of one step length runs exactly one step
+	scene_->CreateComponent<Octree>();
+	PhysicsWorld* world = scene_->CreateComponent<PhysicsWorld>();
+	world->SetInterpolation(false);
+	timeStep_ = 1.0f / (float)world->GetFps();
+	// The server steps each match itself
+	scene_->SetUpdateEnabled(false);
+
+	level_->SetScene(scene_);
+	character_ = level_->CreateCharacter();
+	// Matches share the process, collisions and steps of one character must not reach the others
+	character_->SetEventHub(events_);
+
+	SubscribeToEvent(world, E_PHYSICSPRESTEP, HANDLER(RaceMatch, HandlePhysicsPreStep));
+}
+
+RaceMatch::~RaceMatch()
+{
+	// The character unsubscribes from the event hub when it is destroyed, so the scene goes first
+	scene_.Reset();
+}
+
+void RaceMatch::Start(unsigned seed)
+{
+	inputs_.Clear();
+	keyframes_.Clear();
+	keyframeCursor_ = 0;
+	inputStart_ = 0;
+	step_ = 0;
+	numMismatches_ = 0;
+	claimedScore_ = 0;
+	seed_ = seed;
+	running_ = true;
+	ended_ = false;
+	finished_ = false;
+
+	level_->Start(character_, seed);
+}
+
+bool RaceMatch::AddBatch(const GhostBatch& batch)
+{
+	if (!running_ || ended_ || batch.firstStep_ != inputStart_ + inputs_.Size())
+		return false;
+
+	inputs_.Insert(inputs_.End(), batch.inputs_);
+	keyframes_.Insert(keyframes_.End(), batch.keyframes_);
+	return true;
+}
+
+void RaceMatch::End(int claimedScore)
+{
+	if (!running_)
+		return;
+
+	claimedScore_ = claimedScore;
+	ended_ = true;
+}
+
+unsigned RaceMatch::Simulate(unsigned maxSteps)
+{
+	unsigned simulated = 0;
+
+	while (running_ && simulated < maxSteps && step_ < inputStart_ + inputs_.Size() && !character_->IsDead())
+	{
+		// The level streams and the character steers in the pre-step, as in the game
+		scene_->Update(timeStep_);
+		++simulated;
+	}
+
+	// Simulated inputs and checked keyframes are dropped, so a run holds only what has arrived ahead of the simulation
+	if (step_ > inputStart_)
+	{
+		inputs_.Erase(0, step_ - inputStart_);
+		inputStart_ = step_;
+	}
+	if (keyframeCursor_)
+	{
+		keyframes_.Erase(0, keyframeCursor_);
+		keyframeCursor_ = 0;
+	}
+
+	// A simulated death ends the run even if the client kept sending input
+	if (running_ && (character_->IsDead() || (ended_ && inputs_.Empty())))
+	{
+		running_ = false;
+		finished_ = true;
+	}
+
+	return simulated;
+}
+
+bool RaceMatch::IsAccepted() const
+{
+	return finished_ && !numMismatches_ && claimedScore_ == GetSimulatedScore();
+}
+
+int RaceMatch::GetSimulatedScore() const
+{
+	return character_ ? character_->GetScore() : 0;
+}
+
+void RaceMatch::HandlePhysicsPreStep(StringHash eventType, VariantMap& eventData)
+{
+	if (step_ >= inputStart_ + inputs_.Size() || character_->IsDead())
+		return;
+
+	// The recorded held buttons replace the game's per-frame controls, the recorded actions are queued like key presses
+	unsigned short input = inputs_[step_ - inputStart_];
+	character_->controls_.buttons_ = input & 0xff;
+	character_->QueueActions(input >> 8);
+
+	level_->Update();
+
+	StepEvent step;
+	step.timeStep_ = timeStep_;
+	events_->fixedStep_.Send(step);
+
+	// The client took its keyframes after the step
+	unsigned checksum = character_->GetSim().GetChecksum();
+	while (keyframeCursor_ < keyframes_.Size() && keyframes_[keyframeCursor_].step_ <= step_)
+	{
+		if (keyframes_[keyframeCursor_].step_ == step_ && keyframes_[keyframeCursor_].checksum_ != checksum)
+			++numMismatches_;
+		++keyframeCursor_;
+	}
+	++step_;
+}
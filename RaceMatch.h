@@ -0,0 +1,117 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "GhostProtocol.h"
+#include "Object.h"
+
+using namespace Urho3D;
+
+namespace Urho3D
+{
+	class Scene;
+}
+
+class Character;
+class GameEventHub;
+class RunnerLevel;
+
+/// One run re-simulated by the race server. Has its own scene, physics world, event hub, level and seed, and advances only
+/// as far as the input stream of the client has arrived. The character runs the same fixed point simulation as the client's,
+/// so the checksum of each keyframe and the claimed score must match exactly.
+class RaceMatch : public Object
+{
+	OBJECT(RaceMatch);
+
+public:
+	/// Construct. Create the scene and the character.
+	RaceMatch(Context* context);
+	/// Destruct.
+	virtual ~RaceMatch();
+
+	/// Start a run on the level of a seed. Drops the input of the previous run.
+	void Start(unsigned seed);
+	/// Queue the inputs and keyframes of a batch. Return false if the batch does not continue the run.
+	bool AddBatch(const GhostBatch& batch);
+	/// Mark the input stream complete with the score the client claims.
+	void End(int claimedScore);
+	/// Simulate up to a number of physics steps with the queued input. Return the number of steps simulated.
+	unsigned Simulate(unsigned maxSteps);
+
+	/// Return whether a run is in progress.
+	bool IsRunning() const { return running_; }
+	/// Return whether the run has been validated.
+	bool IsFinished() const { return finished_; }
+	/// Return whether the run was accepted. Valid once finished.
+	bool IsAccepted() const;
+	/// Return the number of queued steps not yet simulated.
+	unsigned GetNumPendingSteps() const { return inputStart_ + inputs_.Size() - step_; }
+	/// Return the number of steps simulated in the run.
+	unsigned GetStep() const { return step_; }
+	/// Return the score of the simulated character.
+	int GetSimulatedScore() const;
+	/// Return the score claimed by the client.
+	int GetClaimedScore() const { return claimedScore_; }
+	/// Return the number of keyframes whose checksum did not match the simulation.
+	unsigned GetNumMismatches() const { return numMismatches_; }
+	/// Return the level seed.
+	unsigned GetSeed() const { return seed_; }
+
+private:
+	/// Handle physics pre-step of the match's world. Apply the step's input, run the character and check the step's keyframe.
+	void HandlePhysicsPreStep(StringHash eventType, VariantMap& eventData);
+
+	/// Scene.
+	SharedPtr<Scene> scene_;
+	/// Gameplay event channels of the match.
+	SharedPtr<GameEventHub> events_;
+	/// Level.
+	SharedPtr<RunnerLevel> level_;
+	/// Simulated character.
+	WeakPtr<Character> character_;
+	/// Inputs of the run not yet simulated.
+	PODVector<unsigned short> inputs_;
+	/// Claimed keyframes of the run not yet checked.
+	PODVector<GhostKeyframe> keyframes_;
+	/// Next keyframe to check.
+	unsigned keyframeCursor_;
+	/// Step of the first queued input.
+	unsigned inputStart_;
+	/// Steps simulated.
+	unsigned step_;
+	/// Physics step length.
+	float timeStep_;
+	/// Keyframes that did not match.
+	unsigned numMismatches_;
+	/// Claimed score.
+	int claimedScore_;
+	/// Level seed.
+	unsigned seed_;
+	/// Run in progress flag.
+	bool running_;
+	/// Input stream complete flag.
+	bool ended_;
+	/// Run validated flag.
+	bool finished_;
+};
@@ -0,0 +1,315 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "Character.h"
+#include "Connection.h"
+#include "CoreEvents.h"
+#include "Engine.h"
+#include "GameIds.h"
+#include "Log.h"
+#include "MemoryBuffer.h"
+#include "Network.h"
+#include "NetworkEvents.h"
+#include "Octree.h"
+#include "PhysicsWorld.h"
+#include "ProcessUtils.h"
+#include "RaceMatch.h"
+#include "RaceServer.h"
+#include "Random.h"
+#include "RunnerLevel.h"
+#include "RunnerSim.h"
+#include "Scene.h"
+#include "StringUtils.h"
+#include "Timer.h"
+
+#include "DebugNew.h"
+
+/// Simulation time the matches may take per frame, in microseconds. Matches not reached continue next frame.
+static const long long SLICE_BUDGET_USEC = 12000;
+/// Most steps one match may catch up per frame, so that one client sending a large backlog does not starve the others.
+static const unsigned MAX_CATCHUP_STEPS = 32;
+/// Steps of input queued for a bot at a time.
+static const unsigned BOT_BATCH_STEPS = 15;
+/// Longest bot run in steps, three minutes at the default physics rate.
+static const unsigned BOT_MAX_STEPS = 10800;
+/// Seconds between statistics lines.
+static const float STATS_INTERVAL = 5.0f;
+
+DEFINE_APPLICATION_MAIN(RaceServer)
+
+RaceServer::RaceServer(Context* context) :
+	Application(context),
+	cursor_(0),
+	numSteps_(0),
+	numRuns_(0),
+	simTime_(0),
+	statsTimer_(0.0f)
+{
+	Character::RegisterObject(context);
+}
+
+void RaceServer::Setup()
+{
+	engineParameters_["LogName"] = GetTypeName() + ".log";
+	engineParameters_["Headless"] = true;
+	engineParameters_["Sound"] = false;
+}
+
+void RaceServer::Start()
+{
+	SetRandomSeed(Time::GetSystemTime());
+	CheckGameIds();
+
+	unsigned short port = GHOST_PORT;
+	unsigned numBots = 0;
+	unsigned numChecksumSeeds = 0;
+	const Vector<String>& arguments = GetArguments();
+	for (unsigned i = 0; i + 1 < arguments.Size(); ++i)
+	{
+		if (arguments[i] == "-port")
+			port = (unsigned short)ToUInt(arguments[++i]);
+		else if (arguments[i] == "-bench")
+			numBots = ToUInt(arguments[++i]);
+		else if (arguments[i] == "-checksum")
+			numChecksumSeeds = ToUInt(arguments[++i]);
+	}
+
+	if (numChecksumSeeds)
+	{
+		RunChecksum(numChecksumSeeds, arguments.Contains("-kit"));
+		return;
+	}
+
+	if (!GetSubsystem<Network>()->StartServer(port))
+	{
+		ErrorExit("Could not listen on port " + String(port));
+		return;
+	}
+	LOGINFO("Race server started on port " + String(port));
+
+	for (unsigned i = 0; i < numBots; ++i)
+		bots_.Push(SharedPtr<RaceMatch>(new RaceMatch(context_)));
+	if (numBots)
+		LOGINFO("Running " + String(numBots) + " bot matches");
+
+	SubscribeToEvent(E_CLIENTCONNECTED, HANDLER(RaceServer, HandleClientConnected));
+	SubscribeToEvent(E_CLIENTDISCONNECTED, HANDLER(RaceServer, HandleClientDisconnected));
+	SubscribeToEvent(E_NETWORKMESSAGE, HANDLER(RaceServer, HandleNetworkMessage));
+	SubscribeToEvent(E_UPDATE, HANDLER(RaceServer, HandleUpdate));
+}
+
+void RaceServer::Stop()
+{
+	clients_.Clear();
+	seeds_.Clear();
+	bots_.Clear();
+}
+
+void RaceServer::HandleClientConnected(StringHash eventType, VariantMap& eventData)
+{
+	using namespace ClientConnected;
+
+	Connection* connection = static_cast<Connection*>(eventData[P_CONNECTION].GetPtr());
+	clients_[connection] = new RaceMatch(context_);
+	unsigned seed = ((unsigned)Rand() << 16) ^ (unsigned)Rand();
+	seeds_[connection] = seed;
+
+	// The client generates its level from the same seed, every run of the connection uses it
+	message_.Clear();
+	message_.WriteUInt(seed);
+	connection->SendMessage(MSG_GHOST_SEED, true, true, message_);
+}
+
+void RaceServer::HandleClientDisconnected(StringHash eventType, VariantMap& eventData)
+{
+	using namespace ClientDisconnected;
+
+	Connection* connection = static_cast<Connection*>(eventData[P_CONNECTION].GetPtr());
+	clients_.Erase(connection);
+	seeds_.Erase(connection);
+}
+
+void RaceServer::HandleNetworkMessage(StringHash eventType, VariantMap& eventData)
+{
+	using namespace NetworkMessage;
+
+	Connection* connection = static_cast<Connection*>(eventData[P_CONNECTION].GetPtr());
+	HashMap<Connection*, SharedPtr<RaceMatch> >::Iterator it = clients_.Find(connection);
+	if (it == clients_.End())
+		return;
+
+	RaceMatch* match = it->second_;
+	MemoryBuffer buffer(eventData[P_DATA].GetBuffer());
+
+	switch (eventData[P_MESSAGEID].GetInt())
+	{
+	case MSG_GHOST_START:
+		match->Start(seeds_[connection]);
+		break;
+
+	case MSG_GHOST_STEPS:
+		{
+			GhostBatch batch;
+			if (!ReadGhostBatch(buffer, batch) || !match->AddBatch(batch))
+				LOGWARNING("Dropped an out of sequence or malformed step batch from " + connection->ToString());
+		}
+		break;
+
+	case MSG_GHOST_END:
+		match->End(buffer.ReadInt());
+		break;
+	}
+}
+
+void RaceServer::HandleUpdate(StringHash eventType, VariantMap& eventData)
+{
+	using namespace Update;
+
+	schedule_.Clear();
+	owners_.Clear();
+	for (HashMap<Connection*, SharedPtr<RaceMatch> >::Iterator i = clients_.Begin(); i != clients_.End(); ++i)
+	{
+		if (i->second_->IsRunning())
+		{
+			schedule_.Push(i->second_);
+			owners_.Push(i->first_);
+		}
+	}
+	for (unsigned i = 0; i < bots_.Size(); ++i)
+	{
+		FeedBot(bots_[i]);
+		schedule_.Push(bots_[i]);
+		owners_.Push(0);
+	}
+
+	// Step the matches round-robin from where the previous frame ran out of budget
+	HiresTimer sliceTimer;
+	unsigned count = schedule_.Size();
+	for (unsigned n = 0; n < count; ++n)
+	{
+		unsigned index = (cursor_ + n) % count;
+		RaceMatch* match = schedule_[index];
+		bool wasRunning = match->IsRunning();
+		numSteps_ += match->Simulate(MAX_CATCHUP_STEPS);
+
+		if (wasRunning && match->IsFinished())
+		{
+			++numRuns_;
+			if (owners_[index])
+				SendResult(owners_[index], match);
+		}
+
+		if (sliceTimer.GetUSec(false) > SLICE_BUDGET_USEC)
+		{
+			cursor_ = index + 1;
+			break;
+		}
+	}
+	simTime_ += sliceTimer.GetUSec(false);
+
+	statsTimer_ += eventData[P_TIMESTEP].GetFloat();
+	if (statsTimer_ < STATS_INTERVAL)
+		return;
+
+	// A match in real time takes 60 steps a second at the default physics rate, which gives the matches one core can keep up with
+	float usecPerStep = numSteps_ ? (float)simTime_ / (float)numSteps_ : 0.0f;
+	float capacity = usecPerStep > 0.0f ? 1000000.0f / (usecPerStep * 60.0f) : 0.0f;
+	LOGINFO(ToString("%u clients, %u bots: %.0f steps/s, %.1f us/step, %u runs, capacity %.0f real-time matches per core",
+		clients_.Size(), bots_.Size(), numSteps_ / statsTimer_, usecPerStep, numRuns_, capacity));
+	numSteps_ = 0;
+	numRuns_ = 0;
+	simTime_ = 0;
+	statsTimer_ = 0.0f;
+}
+
+void RaceServer::FeedBot(RaceMatch* match)
+{
+	if (!match->IsRunning())
+	{
+		match->Start(((unsigned)Rand() << 16) ^ (unsigned)Rand());
+		return;
+	}
+
+	if (match->GetNumPendingSteps())
+		return;
+
+	if (match->GetStep() >= BOT_MAX_STEPS)
+	{
+		match->End(0);
+		return;
+	}
+
+	// Run forward and change lane, jump or roll now and then, like a careless player
+	GhostBatch batch;
+	batch.firstStep_ = match->GetStep();
+	for (unsigned i = 0; i < BOT_BATCH_STEPS; ++i)
+	{
+		int actions = 0;
+		if (Rand() % 40 == 0)
+			actions = CTRL_BACK << (Rand() % 4);
+		batch.inputs_.Push(PackGhostInput(CTRL_FORWARD, actions));
+	}
+	match->AddBatch(batch);
+}
+
+void RaceServer::RunChecksum(unsigned numSeeds, bool prefabKit)
+{
+	SimKit kit;
+	if (prefabKit)
+	{
+		SharedPtr<Scene> scene(new Scene(context_));
+		scene->CreateComponent<Octree>();
+		scene->CreateComponent<PhysicsWorld>();
+		SharedPtr<RunnerLevel> level(new RunnerLevel(context_));
+		level->SetScene(scene);
+		level->CreateSimKit(kit);
+	}
+	else
+		kit.CreateDefault();
+
+	HiresTimer timer;
+	SimBatchResult result = RunSimBatch(kit, 1, numSeeds, SIM_REFERENCE_STEPS);
+	float ms = timer.GetUSec(false) * 0.001f;
+	LOGINFO(ToString("Checksum %08X over %u seeds of a %u block kit: %u steps in %.1f ms, %u deaths, average score %.1f",
+		result.checksum_, numSeeds, kit.GetNumBlocks(), result.numSteps_, ms, result.numDeaths_,
+		(float)result.totalScore_ / (float)numSeeds));
+
+	// The reference is for the built-in kit, the prefab kit can only be compared between builds by hand
+	if (!prefabKit && numSeeds == SIM_REFERENCE_SEEDS && result.checksum_ != SIM_REFERENCE_CHECKSUM)
+		ErrorExit(ToString("Checksum mismatch, the reference is %08X", SIM_REFERENCE_CHECKSUM));
+	else
+		engine_->Exit();
+}
+
+void RaceServer::SendResult(Connection* connection, RaceMatch* match)
+{
+	message_.Clear();
+	message_.WriteInt(match->GetClaimedScore());
+	message_.WriteInt(match->GetSimulatedScore());
+	message_.WriteBool(match->IsAccepted());
+	connection->SendMessage(MSG_RACE_RESULT, true, true, message_);
+
+	LOGINFO(connection->ToString() + (match->IsAccepted() ? " accepted" : " rejected") + ": claimed " +
+		String(match->GetClaimedScore()) + ", simulated " + String(match->GetSimulatedScore()) + ", " +
+		String(match->GetNumMismatches()) + " mismatched keyframes over " + String(match->GetStep()) + " steps");
+}
@@ -0,0 +1,96 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "Application.h"
+#include "HashMap.h"
+#include "VectorBuffer.h"
+
+using namespace Urho3D;
+
+namespace Urho3D
+{
+	class Connection;
+}
+
+class RaceMatch;
+
+/// Headless race server. Validates the runs of connected clients by re-simulating their input streams, one match with its own
+/// scene, physics and seed per client. Matches are stepped round-robin within a time budget per frame. With -bench <count> it
+/// also runs bot matches flat out and logs the simulation cost, to size how many matches a core can keep in real time. With
+/// -checksum <seeds> it runs the deterministic simulation core over that many seeds instead, logs the folded checksum and exits,
+/// failing if the built-in kit does not give the reference checksum. Add -kit to use the block prefabs instead.
+class RaceServer : public Application
+{
+	OBJECT(RaceServer);
+
+public:
+	/// Construct.
+	RaceServer(Context* context);
+
+	/// Setup before engine initialization. Run headless without sound.
+	virtual void Setup();
+	/// Start listening and create the bot matches.
+	virtual void Start();
+	/// Drop all matches.
+	virtual void Stop();
+
+private:
+	/// Handle a client connecting. Create its match and send the seed.
+	void HandleClientConnected(StringHash eventType, VariantMap& eventData);
+	/// Handle a client disconnecting. Drop its match.
+	void HandleClientDisconnected(StringHash eventType, VariantMap& eventData);
+	/// Handle a run message from a client.
+	void HandleNetworkMessage(StringHash eventType, VariantMap& eventData);
+	/// Handle update. Step the matches and log statistics.
+	void HandleUpdate(StringHash eventType, VariantMap& eventData);
+	/// Queue input for a bot match, restarting it when its run is over.
+	void FeedBot(RaceMatch* match);
+	/// Run bot runs of the deterministic simulation over a number of seeds, log the checksum and exit.
+	void RunChecksum(unsigned numSeeds, bool prefabKit);
+	/// Send the validation result of a finished run to its client.
+	void SendResult(Connection* connection, RaceMatch* match);
+
+	/// Matches of the connected clients.
+	HashMap<Connection*, SharedPtr<RaceMatch> > clients_;
+	/// Level seed of each connected client.
+	HashMap<Connection*, unsigned> seeds_;
+	/// Bot matches.
+	Vector<SharedPtr<RaceMatch> > bots_;
+	/// Matches to step in the current frame, and the connection of each (null for bots.)
+	PODVector<RaceMatch*> schedule_;
+	PODVector<Connection*> owners_;
+	/// Round-robin position in the schedule.
+	unsigned cursor_;
+	/// Steps simulated since the statistics were logged.
+	unsigned numSteps_;
+	/// Runs finished since the statistics were logged.
+	unsigned numRuns_;
+	/// Simulation time since the statistics were logged, in microseconds.
+	long long simTime_;
+	/// Time since the statistics were logged.
+	float statsTimer_;
+	/// Reusable message buffer.
+	VectorBuffer message_;
+};
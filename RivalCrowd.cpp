@@ -0,0 +1,513 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "AnimatedModel.h"
+#include "Animation.h"
+#include "AnimationState.h"
+#include "Character.h"
+#include "Geometry.h"
+#include "IndexBuffer.h"
+#include "Log.h"
+#include "Material.h"
+#include "Model.h"
+#include "ResourceCache.h"
+#include "RivalCrowd.h"
+#include "RunnerLevel.h"
+#include "Scene.h"
+#include "StaticModelGroup.h"
+#include "Timer.h"
+#include "VertexBuffer.h"
+
+#include <cstring>
+
+/// Distance between lanes.
+static const float RIVAL_LANE_WIDTH = 1.2f;
+/// Height of the path points above the floor.
+static const float RIVAL_PATH_HEIGHT = 0.5f;
+/// Model scale, the same as the player's.
+static const float RIVAL_SCALE = 0.4f;
+/// Running speed range, around the player's top speed.
+static const float RIVAL_MIN_SPEED = 5.5f;
+static const float RIVAL_MAX_SPEED = 7.5f;
+/// Sideways speed when changing lane.
+static const float RIVAL_LANE_SPEED = 6.0f;
+/// Take-off speed of a jump and gravity.
+static const float RIVAL_JUMP_SPEED = 5.0f;
+static const float RIVAL_GRAVITY = 9.81f;
+/// Lane changes and jumps per second of each rival.
+static const float RIVAL_LANE_RATE = 0.4f;
+static const float RIVAL_JUMP_RATE = 0.2f;
+/// Run cycles per meter, matching the player's run animation speed.
+static const float RIVAL_CYCLES_PER_METER = 0.3f;
+/// Rivals this far behind the player come back ahead of it, up to the second distance.
+static const float RIVAL_RESPAWN_BEHIND = 40.0f;
+static const float RIVAL_RESPAWN_AHEAD = 40.0f;
+/// Slack kept to the end of the known track, where rivals wait for the next blocks.
+static const float RIVAL_TRACK_MARGIN = 2.0f;
+/// Track points behind the player and every rival that are dropped at once.
+static const unsigned RIVAL_TRIM_POINTS = 64;
+
+RivalCrowd::RivalCrowd(Context* context) :
+	Object(context),
+	trackStart_(0),
+	playerSegment_(0),
+	playerDistance_(0.0f),
+	timeStep_(0.0f)
+{
+}
+
+RivalCrowd::~RivalCrowd()
+{
+	Clear();
+	if (crowdNode_)
+		crowdNode_->Remove();
+}
+
+void RivalCrowd::SetLevel(Scene* scene, RunnerLevel* level, Character* character)
+{
+	Clear();
+	if (scene != scene_)
+	{
+		if (crowdNode_)
+			crowdNode_->Remove();
+		poses_.Clear();
+	}
+
+	scene_ = scene;
+	level_ = level;
+	character_ = character;
+}
+
+void RivalCrowd::SetNumRivals(unsigned count)
+{
+	if (!scene_)
+		return;
+	if (poses_.Empty() && count && !CreatePoses())
+		return;
+
+	UpdateTrack();
+
+	// Removing from the back keeps the arrays dense
+	while (nodes_.Size() > count)
+	{
+		Node* node = nodes_.Back();
+		poses_[shownPose_.Back()]->RemoveInstanceNode(node);
+		node->Remove();
+		nodes_.Pop();
+		shownPose_.Pop();
+	}
+
+	unsigned oldCount = distance_.Size();
+	distance_.Resize(count);
+	speed_.Resize(count);
+	lateral_.Resize(count);
+	targetLateral_.Resize(count);
+	height_.Resize(count);
+	verticalSpeed_.Resize(count);
+	phase_.Resize(count);
+	segment_.Resize(count);
+	random_.Resize(count);
+	position_.Resize(count);
+	yaw_.Resize(count);
+	pose_.Resize(count);
+
+	for (unsigned i = oldCount; i < count; ++i)
+	{
+		random_[i] = i * 2654435761u + 1;
+		phase_[i] = (float)Rand(i) / 32768.0f;
+		Spawn(i, playerDistance_ + (float)(Rand(i) % 40) - 10.0f);
+
+		Node* node = crowdNode_->CreateChild("Rival", LOCAL);
+		poses_[0]->AddInstanceNode(node);
+		nodes_.Push(node);
+		shownPose_.Push(0);
+	}
+}
+
+bool RivalCrowd::BeginUpdate(float timeStep)
+{
+	if (nodes_.Empty() || !level_ || !character_)
+		return false;
+
+	UpdateTrack();
+	if (track_.Size() < 2)
+		return false;
+
+	unsigned count = nodes_.Size();
+	for (unsigned i = 0; i < count; ++i)
+	{
+		if (distance_[i] < playerDistance_ - RIVAL_RESPAWN_BEHIND)
+			Spawn(i, playerDistance_ + RIVAL_RESPAWN_AHEAD * (0.5f + (float)Rand(i) / 65536.0f));
+	}
+
+	timeStep_ = timeStep;
+	return true;
+}
+
+void RivalCrowd::ApplyNodes(unsigned first, unsigned last)
+{
+	// Scene nodes are not thread-safe, they are written on the main thread. A node changes group only when its pose changes
+	for (unsigned i = first; i < last; ++i)
+	{
+		Node* node = nodes_[i];
+		node->SetTransform(position_[i], Quaternion(yaw_[i] + 180.0f, Vector3::UP), RIVAL_SCALE);
+		if (pose_[i] != shownPose_[i])
+		{
+			poses_[shownPose_[i]]->RemoveInstanceNode(node);
+			poses_[pose_[i]]->AddInstanceNode(node);
+			shownPose_[i] = pose_[i];
+		}
+	}
+}
+
+void RivalCrowd::Clear()
+{
+	// The nodes are gone already if the scene was destroyed first
+	for (unsigned i = 0; crowdNode_ && i < nodes_.Size(); ++i)
+	{
+		poses_[shownPose_[i]]->RemoveInstanceNode(nodes_[i]);
+		nodes_[i]->Remove();
+	}
+
+	nodes_.Clear();
+	shownPose_.Clear();
+	distance_.Clear();
+	speed_.Clear();
+	lateral_.Clear();
+	targetLateral_.Clear();
+	height_.Clear();
+	verticalSpeed_.Clear();
+	phase_.Clear();
+	segment_.Clear();
+	random_.Clear();
+	position_.Clear();
+	yaw_.Clear();
+	pose_.Clear();
+	track_.Clear();
+	trackDistance_.Clear();
+	trackStart_ = 0;
+	playerSegment_ = 0;
+	playerDistance_ = 0.0f;
+}
+
+bool RivalCrowd::CreatePoses()
+{
+	ResourceCache* cache = GetSubsystem<ResourceCache>();
+	Model* model = cache->GetResource<Model>("Models/vempire.mdl");
+	Material* material = cache->GetResource<Material>("Materials/Vempire.xml");
+	if (!model || !material)
+		return false;
+
+	// Pose a temporary rig with each frame and bake it
+	Node* rigNode = scene_->CreateChild("RivalRig", LOCAL);
+	AnimatedModel* rig = rigNode->CreateComponent<AnimatedModel>();
+	rig->SetModel(model);
+
+	Vector<SharedPtr<Model> > baked;
+	for (unsigned i = 0; i <= RIVAL_JUMP_POSE; ++i)
+	{
+		Animation* animation = cache->GetResource<Animation>((i < RIVAL_RUN_POSES ? ANIM_RUN : ANIM_JUMP_LOOP).GetString());
+		if (!animation)
+			break;
+
+		rig->RemoveAllAnimationStates();
+		AnimationState* state = rig->AddAnimationState(animation);
+		state->SetWeight(1.0f);
+		state->SetTime(i < RIVAL_RUN_POSES ? animation->GetLength() * (float)i / (float)RIVAL_RUN_POSES : 0.0f);
+		state->Apply();
+
+		SharedPtr<Model> pose = BakePose(model, rig);
+		if (!pose)
+			break;
+		baked.Push(pose);
+	}
+	rigNode->Remove();
+
+	if (baked.Size() != RIVAL_JUMP_POSE + 1)
+	{
+		LOGERROR("Could not bake the rival poses");
+		return false;
+	}
+
+	// Tinted so that rivals stand apart from the player
+	SharedPtr<Material> rivalMaterial = material->Clone();
+	rivalMaterial->SetShaderParameter("MatDiffColor", Color(0.6f, 0.7f, 1.0f));
+
+	crowdNode_ = scene_->CreateChild("Rivals", LOCAL);
+	for (unsigned i = 0; i < baked.Size(); ++i)
+	{
+		StaticModelGroup* group = crowdNode_->CreateComponent<StaticModelGroup>();
+		group->SetModel(baked[i]);
+		group->SetMaterial(rivalMaterial);
+		poses_.Push(group);
+	}
+
+	return true;
+}
+
+SharedPtr<Model> RivalCrowd::BakePose(Model* source, AnimatedModel* rig)
+{
+	// Skin matrices relative to the model node
+	Skeleton& skeleton = rig->GetSkeleton();
+	Matrix3x4 toModel = rig->GetNode()->GetWorldTransform().Inverse();
+	PODVector<Matrix3x4> skinMatrices(skeleton.GetNumBones());
+	for (unsigned i = 0; i < skeleton.GetNumBones(); ++i)
+	{
+		Bone* bone = skeleton.GetBone(i);
+		skinMatrices[i] = bone->node_ ? toModel * bone->node_->GetWorldTransform() * bone->offsetMatrix_ : Matrix3x4::IDENTITY;
+	}
+
+	// The blend elements come last in a vertex, so dropping them keeps the offsets of the others
+	const Vector<SharedPtr<VertexBuffer> >& sourceBuffers = source->GetVertexBuffers();
+	Vector<SharedPtr<VertexBuffer> > buffers;
+	Vector<SharedArrayPtr<unsigned char> > data;
+	for (unsigned i = 0; i < sourceBuffers.Size(); ++i)
+	{
+		VertexBuffer* sourceBuffer = sourceBuffers[i];
+		if (!sourceBuffer->GetShadowData())
+			return SharedPtr<Model>();
+
+		SharedPtr<VertexBuffer> buffer(new VertexBuffer(context_));
+		buffer->SetShadowed(true);
+		buffer->SetSize(sourceBuffer->GetVertexCount(), sourceBuffer->GetElementMask() & ~(MASK_BLENDWEIGHTS | MASK_BLENDINDICES));
+		buffers.Push(buffer);
+		data.Push(SharedArrayPtr<unsigned char>(new unsigned char[buffer->GetVertexCount() * buffer->GetVertexSize()]));
+	}
+
+	SharedPtr<Model> model(new Model(context_));
+	BoundingBox box;
+	const Vector<PODVector<unsigned> >& boneMappings = source->GetGeometryBoneMappings();
+	model->SetNumGeometries(source->GetNumGeometries());
+
+	for (unsigned i = 0; i < source->GetNumGeometries(); ++i)
+	{
+		model->SetNumGeometryLodLevels(i, source->GetNumGeometryLodLevels(i));
+		// Blend indices are local to the geometry when the skeleton was split for the shader
+		const PODVector<unsigned>* mapping = i < boneMappings.Size() && boneMappings[i].Size() ? &boneMappings[i] : 0;
+
+		for (unsigned j = 0; j < source->GetNumGeometryLodLevels(i); ++j)
+		{
+			Geometry* sourceGeometry = source->GetGeometry(i, j);
+			VertexBuffer* sourceBuffer = sourceGeometry->GetVertexBuffer(0);
+			unsigned bufferIndex = sourceBuffers.Find(SharedPtr<VertexBuffer>(sourceBuffer)) - sourceBuffers.Begin();
+			if (bufferIndex >= buffers.Size())
+				continue;
+
+			VertexBuffer* buffer = buffers[bufferIndex];
+			unsigned sourceSize = sourceBuffer->GetVertexSize();
+			unsigned size = buffer->GetVertexSize();
+			unsigned mask = sourceBuffer->GetElementMask();
+			unsigned weightOffset = sourceBuffer->GetElementOffset(ELEMENT_BLENDWEIGHTS);
+			unsigned indexOffset = sourceBuffer->GetElementOffset(ELEMENT_BLENDINDICES);
+			unsigned normalOffset = sourceBuffer->GetElementOffset(ELEMENT_NORMAL);
+			unsigned tangentOffset = sourceBuffer->GetElementOffset(ELEMENT_TANGENT);
+
+			for (unsigned v = sourceGeometry->GetVertexStart(); v < sourceGeometry->GetVertexStart() +
+				sourceGeometry->GetVertexCount(); ++v)
+			{
+				const unsigned char* src = sourceBuffer->GetShadowData() + v * sourceSize;
+				unsigned char* dest = data[bufferIndex].Get() + v * size;
+				memcpy(dest, src, size);
+				if (!(mask & MASK_BLENDWEIGHTS) || !(mask & MASK_BLENDINDICES))
+					continue;
+
+				const float* weights = reinterpret_cast<const float*>(src + weightOffset);
+				const unsigned char* indices = src + indexOffset;
+				Matrix3x4 skin = Matrix3x4::ZERO;
+				for (unsigned k = 0; k < 4; ++k)
+				{
+					unsigned bone = mapping ? (*mapping)[indices[k]] : indices[k];
+					if (weights[k] > 0.0f && bone < skinMatrices.Size())
+						skin = skin + skinMatrices[bone] * weights[k];
+				}
+
+				Vector3& position = *reinterpret_cast<Vector3*>(dest);
+				position = skin * position;
+				box.Merge(position);
+				Matrix3 rotation = skin.ToMatrix3();
+				if (mask & MASK_NORMAL)
+				{
+					Vector3& normal = *reinterpret_cast<Vector3*>(dest + normalOffset);
+					normal = (rotation * normal).Normalized();
+				}
+				if (mask & MASK_TANGENT)
+				{
+					Vector3& tangent = *reinterpret_cast<Vector3*>(dest + tangentOffset);
+					tangent = (rotation * tangent).Normalized();
+				}
+			}
+
+			SharedPtr<Geometry> geometry(new Geometry(context_));
+			geometry->SetVertexBuffer(0, buffer, buffer->GetElementMask());
+			geometry->SetIndexBuffer(sourceGeometry->GetIndexBuffer());
+			geometry->SetDrawRange(sourceGeometry->GetPrimitiveType(), sourceGeometry->GetIndexStart(),
+				sourceGeometry->GetIndexCount(), sourceGeometry->GetVertexStart(), sourceGeometry->GetVertexCount(), false);
+			geometry->SetLodDistance(sourceGeometry->GetLodDistance());
+			model->SetGeometry(i, j, geometry);
+		}
+	}
+
+	for (unsigned i = 0; i < buffers.Size(); ++i)
+		buffers[i]->SetData(data[i].Get());
+
+	model->SetVertexBuffers(buffers, PODVector<unsigned>(), PODVector<unsigned>());
+	model->SetIndexBuffers(source->GetIndexBuffers());
+	model->SetBoundingBox(box.defined_ ? box : source->GetBoundingBox());
+	return model;
+}
+
+void RivalCrowd::UpdateTrack()
+{
+	if (!level_)
+		return;
+
+	// The level drops the points of the blocks it has released. A track ending before the copy means the level started
+	// over, and one starting past the copy's end that the copy fell behind while there were no rivals
+	const PODVector<Vector3>& points = level_->GetTrackPoints();
+	unsigned pointsStart = level_->GetTrackPointsStart();
+	unsigned copyEnd = trackStart_ + track_.Size();
+	if (pointsStart + points.Size() < copyEnd || pointsStart > copyEnd)
+	{
+		track_.Clear();
+		trackDistance_.Clear();
+		trackStart_ = pointsStart;
+		playerSegment_ = 0;
+		playerDistance_ = 0.0f;
+		for (unsigned i = 0; i < segment_.Size(); ++i)
+			Spawn(i, (float)(Rand(i) % 30));
+	}
+
+	for (unsigned i = trackStart_ + track_.Size() - pointsStart; i < points.Size(); ++i)
+	{
+		trackDistance_.Push(track_.Size() ? trackDistance_.Back() + (points[i] - track_.Back()).Length() : 0.0f);
+		track_.Push(points[i]);
+	}
+
+	if (track_.Size() < 2 || !character_)
+		return;
+
+	// The player's segment only moves forward, to where its projection lies within the segment
+	Vector3 position = character_->GetNode()->GetWorldPosition();
+	float t = 0.0f;
+	for (;;)
+	{
+		const Vector3& start = track_[playerSegment_];
+		Vector3 segment = track_[playerSegment_ + 1] - start;
+		float lengthSquared = segment.LengthSquared();
+		t = lengthSquared > 0.0f ? (position - start).DotProduct(segment) / lengthSquared : 1.0f;
+		if (t <= 1.0f || playerSegment_ + 2 >= track_.Size())
+			break;
+		++playerSegment_;
+	}
+
+	float length = trackDistance_[playerSegment_ + 1] - trackDistance_[playerSegment_];
+	playerDistance_ = trackDistance_[playerSegment_] + Clamp(t, 0.0f, 1.0f) * length;
+
+	// Points behind both the player and the rearmost rival are dropped in batches. Distances stay measured from the start
+	unsigned rearmost = playerSegment_;
+	for (unsigned i = 0; i < segment_.Size(); ++i)
+		rearmost = segment_[i] < rearmost ? segment_[i] : rearmost;
+	if (rearmost >= RIVAL_TRIM_POINTS)
+	{
+		track_.Erase(0, rearmost);
+		trackDistance_.Erase(0, rearmost);
+		trackStart_ += rearmost;
+		playerSegment_ -= rearmost;
+		for (unsigned i = 0; i < segment_.Size(); ++i)
+			segment_[i] -= rearmost;
+	}
+}
+
+void RivalCrowd::Spawn(unsigned index, float distance)
+{
+	distance_[index] = Max(distance, 0.0f);
+	speed_[index] = RIVAL_MIN_SPEED + (RIVAL_MAX_SPEED - RIVAL_MIN_SPEED) * (float)Rand(index) / 32767.0f;
+	lateral_[index] = targetLateral_[index] = (float)(Rand(index) % 3 - 1) * RIVAL_LANE_WIDTH;
+	height_[index] = 0.0f;
+	verticalSpeed_[index] = 0.0f;
+	// The segment search only moves forward
+	segment_[index] = 0;
+}
+
+void RivalCrowd::Simulate(unsigned first, unsigned last)
+{
+	float timeStep = timeStep_;
+	unsigned numPoints = track_.Size();
+	float trackEnd = trackDistance_.Back() - RIVAL_TRACK_MARGIN;
+	int laneThreshold = (int)(RIVAL_LANE_RATE * timeStep * 32768.0f);
+	int jumpThreshold = laneThreshold + (int)(RIVAL_JUMP_RATE * timeStep * 32768.0f);
+
+	for (unsigned i = first; i < last; ++i)
+	{
+		bool onGround = height_[i] <= 0.0f && verticalSpeed_[i] <= 0.0f;
+		int random = Rand(i);
+		if (random < laneThreshold)
+			targetLateral_[i] = (float)(random % 3 - 1) * RIVAL_LANE_WIDTH;
+		else if (random < jumpThreshold && onGround)
+			verticalSpeed_[i] = RIVAL_JUMP_SPEED;
+
+		// Rivals at the end of the known track wait there for the next blocks
+		float speed = Clamp(trackEnd - distance_[i], 0.0f, speed_[i]);
+		distance_[i] += speed * timeStep;
+		phase_[i] += speed * RIVAL_CYCLES_PER_METER * timeStep;
+		phase_[i] -= floorf(phase_[i]);
+
+		float lateralStep = RIVAL_LANE_SPEED * timeStep;
+		lateral_[i] += Clamp(targetLateral_[i] - lateral_[i], -lateralStep, lateralStep);
+
+		if (!onGround || verticalSpeed_[i] > 0.0f)
+		{
+			verticalSpeed_[i] -= RIVAL_GRAVITY * timeStep;
+			height_[i] += verticalSpeed_[i] * timeStep;
+			if (height_[i] <= 0.0f)
+			{
+				height_[i] = 0.0f;
+				verticalSpeed_[i] = 0.0f;
+			}
+		}
+
+		unsigned segment = segment_[i];
+		while (segment + 2 < numPoints && trackDistance_[segment + 1] < distance_[i])
+			++segment;
+		segment_[i] = segment;
+
+		const Vector3& start = track_[segment];
+		Vector3 delta = track_[segment + 1] - start;
+		float length = trackDistance_[segment + 1] - trackDistance_[segment];
+		Vector3 direction = length > 0.0f ? delta / length : Vector3::FORWARD;
+		float t = length > 0.0f ? Clamp((distance_[i] - trackDistance_[segment]) / length, 0.0f, 1.0f) : 0.0f;
+		Vector3 right(direction.z_, 0.0f, -direction.x_);
+
+		position_[i] = start + delta * t + right * lateral_[i] + Vector3::UP * (height_[i] - RIVAL_PATH_HEIGHT);
+		yaw_[i] = Atan2(direction.x_, direction.z_);
+		pose_[i] = height_[i] > 0.0f ? (unsigned char)RIVAL_JUMP_POSE :
+			(unsigned char)((unsigned)(phase_[i] * RIVAL_RUN_POSES) % RIVAL_RUN_POSES);
+	}
+}
+
+int RivalCrowd::Rand(unsigned index)
+{
+	unsigned& seed = random_[index];
+	seed = seed * 214013 + 2531011;
+	return (seed >> 16) & 32767;
+}
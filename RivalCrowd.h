@@ -0,0 +1,136 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "Object.h"
+#include "Vector3.h"
+
+using namespace Urho3D;
+
+namespace Urho3D
+{
+	class AnimatedModel;
+	class Model;
+	class Node;
+	class Scene;
+	class StaticModelGroup;
+}
+
+class Character;
+class RunnerLevel;
+
+/// Run cycle poses rivals are drawn with.
+static const unsigned RIVAL_RUN_POSES = 8;
+/// Pose index of airborne rivals, after the run poses.
+static const unsigned RIVAL_JUMP_POSE = RIVAL_RUN_POSES;
+/// Rivals simulated per work item.
+static const unsigned RIVAL_CHUNK_SIZE = 32;
+
+/// Crowd of AI rivals running the player's track. Rival state is kept as structure of arrays and advanced in one batch per
+/// frame, which a frame job graph splits into work items for the worker threads. Rivals have no physics or logic component, only a scene node: the run
+/// cycle is baked on the CPU into a few static pose models once, and each pose is drawn as one instanced StaticModelGroup.
+class RivalCrowd : public Object
+{
+	OBJECT(RivalCrowd);
+
+public:
+	/// Construct.
+	RivalCrowd(Context* context);
+	/// Destruct. Remove the rival nodes.
+	virtual ~RivalCrowd();
+
+	/// Set the scene, level and player the rivals run with. Removes all rivals.
+	void SetLevel(Scene* scene, RunnerLevel* level, Character* character);
+	/// Set the number of rivals. New rivals start around the player.
+	void SetNumRivals(unsigned count);
+	/// Follow the track and respawn rivals left behind before a frame's simulation. Return false if there is nothing to simulate.
+	bool BeginUpdate(float timeStep);
+	/// Advance a range of rivals. Touches only their own array elements and reads the track, so ranges can run in parallel.
+	void Simulate(unsigned first, unsigned last);
+	/// Move the nodes of a range of simulated rivals. Main thread only.
+	void ApplyNodes(unsigned first, unsigned last);
+	/// Remove all rivals.
+	void Clear();
+
+	/// Return number of rivals.
+	unsigned GetNumRivals() const { return nodes_.Size(); }
+
+private:
+	/// Bake the pose models and create their instance groups. Return false if the model has no CPU-side data.
+	bool CreatePoses();
+	/// Return a model with the posed rig's skinning applied to the vertices.
+	SharedPtr<Model> BakePose(Model* source, AnimatedModel* rig);
+	/// Copy the track points added by the level, find the player on the track, and drop the points everyone has passed.
+	void UpdateTrack();
+	/// Place a rival at a distance along the track with a random lane and speed.
+	void Spawn(unsigned index, float distance);
+	/// Return the next random number of a rival, 0-32767.
+	int Rand(unsigned index);
+
+	/// Scene.
+	WeakPtr<Scene> scene_;
+	/// Level whose track is run.
+	WeakPtr<RunnerLevel> level_;
+	/// Player.
+	WeakPtr<Character> character_;
+	/// Node holding the pose groups.
+	WeakPtr<Node> crowdNode_;
+	/// Instance group of each pose.
+	PODVector<StaticModelGroup*> poses_;
+	/// Track center points and the distance along the track of each.
+	PODVector<Vector3> track_;
+	PODVector<float> trackDistance_;
+	/// Number of the level's track points before the first one copied.
+	unsigned trackStart_;
+	/// Track segment and distance of the player.
+	unsigned playerSegment_;
+	float playerDistance_;
+	/// Time step of the update in progress.
+	float timeStep_;
+
+	/// Distance along the track.
+	PODVector<float> distance_;
+	/// Running speed.
+	PODVector<float> speed_;
+	/// Sideways offset from the center path, and the offset of the lane being moved to.
+	PODVector<float> lateral_;
+	PODVector<float> targetLateral_;
+	/// Height above the track and vertical speed.
+	PODVector<float> height_;
+	PODVector<float> verticalSpeed_;
+	/// Run cycle position, 0-1.
+	PODVector<float> phase_;
+	/// Track segment, advanced incrementally.
+	PODVector<unsigned> segment_;
+	/// Random state.
+	PODVector<unsigned> random_;
+	/// World position and yaw computed by the update.
+	PODVector<Vector3> position_;
+	PODVector<float> yaw_;
+	/// Pose computed by the update, and the pose group the node is in.
+	PODVector<unsigned char> pose_;
+	PODVector<unsigned char> shownPose_;
+	/// Instance nodes.
+	PODVector<Node*> nodes_;
+};
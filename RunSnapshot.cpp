@@ -0,0 +1,135 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "Character.h"
+#include "File.h"
+#include "FileSystem.h"
+#include "MemoryBuffer.h"
+#include "RunnerLevel.h"
+#include "RunSnapshot.h"
+
+#include <cstdio>
+
+/// Snapshot format version. Snapshots of other versions are ignored.
+static const unsigned short SNAPSHOT_VERSION = 3;
+
+void RunSnapshot::Writer::ThreadFunction()
+{
+	String nativeName = GetNativePath(fileName_);
+	if (data_.Empty())
+	{
+		remove(nativeName.CString());
+		return;
+	}
+
+	// Write to a temporary file first, so that a process killed mid-write does not leave half a snapshot behind
+	String tempName = nativeName + ".tmp";
+	FILE* file = fopen(tempName.CString(), "wb");
+	if (!file)
+		return;
+
+	bool written = fwrite(&data_[0], data_.Size(), 1, file) == 1;
+	fclose(file);
+	if (written)
+	{
+		// The previous snapshot stays until the new one is complete. Windows does not rename over an existing file
+		remove(nativeName.CString());
+		rename(tempName.CString(), nativeName.CString());
+	}
+	else
+		remove(tempName.CString());
+}
+
+RunSnapshot::RunSnapshot(Context* context) :
+	Object(context),
+	onDisk_(false)
+{
+}
+
+RunSnapshot::~RunSnapshot()
+{
+	writer_.Stop();
+}
+
+void RunSnapshot::Capture(RunnerLevel* level, Character* character)
+{
+	data_.Clear();
+	data_.WriteFileID("ARSN");
+	data_.WriteUShort(SNAPSHOT_VERSION);
+	level->SaveRun(data_);
+	character->SaveRun(data_);
+}
+
+void RunSnapshot::SaveAsync(const String& fileName)
+{
+	if (data_.GetSize())
+	{
+		StartWriter(fileName, data_.GetBuffer());
+		onDisk_ = true;
+	}
+}
+
+void RunSnapshot::DiscardAsync(const String& fileName)
+{
+	if (onDisk_)
+	{
+		StartWriter(fileName, PODVector<unsigned char>());
+		onDisk_ = false;
+	}
+}
+
+bool RunSnapshot::Load(const String& fileName)
+{
+	data_.Clear();
+	if (!GetSubsystem<FileSystem>()->FileExists(fileName))
+		return false;
+
+	File file(context_, fileName, FILE_READ);
+	if (!file.IsOpen() || file.ReadFileID() != "ARSN" || file.ReadUShort() != SNAPSHOT_VERSION)
+		return false;
+
+	file.Seek(0);
+	data_.SetData(file, file.GetSize());
+	onDisk_ = true;
+	return true;
+}
+
+bool RunSnapshot::Restore(RunnerLevel* level, Character* character)
+{
+	if (!data_.GetSize())
+		return false;
+
+	MemoryBuffer source(data_.GetBuffer());
+	if (source.ReadFileID() != "ARSN" || source.ReadUShort() != SNAPSHOT_VERSION)
+		return false;
+
+	return level->LoadRun(source, character) && character->LoadRun(source, level);
+}
+
+void RunSnapshot::StartWriter(const String& fileName, const PODVector<unsigned char>& data)
+{
+	writer_.Stop();
+	writer_.fileName_ = fileName;
+	writer_.data_ = data;
+	writer_.Run();
+}
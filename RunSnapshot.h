@@ -0,0 +1,85 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "Object.h"
+#include "Thread.h"
+#include "VectorBuffer.h"
+
+using namespace Urho3D;
+
+class Character;
+class RunnerLevel;
+
+/// Snapshot of a run in progress, to resume it after the application was sent to the background. Holds the level's random
+/// state and block chain, the enabled state of each block's nodes and the character's kinematic, gameplay, path and
+/// animation state in a few kilobytes. Capturing only serializes into memory, the file is written on a thread of its own.
+class RunSnapshot : public Object
+{
+	OBJECT(RunSnapshot);
+
+public:
+	/// Construct.
+	RunSnapshot(Context* context);
+	/// Destruct. Waits for a pending file write.
+	virtual ~RunSnapshot();
+
+	/// Capture the run of a level and its character.
+	void Capture(RunnerLevel* level, Character* character);
+	/// Write the captured snapshot to a file in the background.
+	void SaveAsync(const String& fileName);
+	/// Delete the snapshot file in the background, so that an ended run is not resumed. Does nothing if none was written or loaded.
+	void DiscardAsync(const String& fileName);
+	/// Read a snapshot file. Return false if it is missing or not a snapshot.
+	bool Load(const String& fileName);
+	/// Rebuild the captured run. Blocks come from the level's pool or the cached prefabs. Return false if the data is malformed.
+	bool Restore(RunnerLevel* level, Character* character);
+
+	/// Return size of the captured snapshot in bytes.
+	unsigned GetSize() const { return data_.GetSize(); }
+
+private:
+	/// Background file writer.
+	class Writer : public Thread
+	{
+	public:
+		/// Write the data to the file, or delete the file if there is no data.
+		virtual void ThreadFunction();
+
+		/// File name.
+		String fileName_;
+		/// Data to write.
+		PODVector<unsigned char> data_;
+	};
+
+	/// Start the writer on a file. Waits for the previous write first.
+	void StartWriter(const String& fileName, const PODVector<unsigned char>& data);
+
+	/// Captured snapshot.
+	VectorBuffer data_;
+	/// File writer.
+	Writer writer_;
+	/// Snapshot file written or loaded flag.
+	bool onDisk_;
+};
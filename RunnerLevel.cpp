@@ -0,0 +1,949 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "AnimatedModel.h"
+#include "AnimationController.h"
+#include "BlockPool.h"
+#include "Character.h"
+#include "DebugLayer.h"
+#include "Deserializer.h"
+#include "Log.h"
+#include "Material.h"
+#include "Model.h"
+#include "Param.h"
+#include "PhysicsWorld.h"
+#include "Random.h"
+#include "Ray.h"
+#include "ResourceCache.h"
+#include "RigidBody.h"
+#include "RunnerLevel.h"
+#include "Scene.h"
+#include "Serializer.h"
+#include "XMLFile.h"
+
+#include <cassert>
+
+/// Grid block geometry is rounded to for the simulation, in steps per meter.
+static const int SIM_KIT_STEPS = 16;
+/// Height above the path from which an obstacle is rolled under rather than jumped over.
+static const float SIM_KIT_OVERHEAD = 1.2f;
+
+/// Append the world positions of a path's points.
+static void AppendPath(Node* path, PODVector<Vector3>& points)
+{
+	for (unsigned i = 0; path && i < path->GetNumChildren(); ++i)
+		points.Push(path->GetChild(i)->GetWorldPosition());
+}
+
+/// Return the length of a path on the ground plane.
+static float GetPathLength(const PODVector<Vector3>& points)
+{
+	float length = 0.0f;
+	for (unsigned i = 0; i + 1 < points.Size(); ++i)
+	{
+		Vector3 segment = points[i + 1] - points[i];
+		segment.y_ = 0.0f;
+		length += segment.Length();
+	}
+	return length;
+}
+
+/// Return the squared distance of a position to a path on the ground plane, and the distance along the path of the closest point.
+static float ProjectOnPath(const PODVector<Vector3>& points, const Vector3& position, float& along)
+{
+	Vector3 flat(position.x_, 0.0f, position.z_);
+	float best = M_INFINITY;
+	float start = 0.0f;
+	along = 0.0f;
+
+	for (unsigned i = 0; i + 1 < points.Size(); ++i)
+	{
+		Vector3 segment = points[i + 1] - points[i];
+		float length = segment.Length();
+		float t = length > 0.0f ? Clamp((flat - points[i]).DotProduct(segment) / (length * length), 0.0f, 1.0f) : 0.0f;
+		float distance = (points[i] + segment * t - flat).LengthSquared();
+		if (distance < best)
+		{
+			best = distance;
+			along = start + t * length;
+		}
+		start += length;
+	}
+
+	return best;
+}
+
+RunnerLevel::RunnerLevel(Context* context) :
+	Object(context),
+	pool_(new BlockPool(context)),
+	nextTrackBlock_(0),
+	numReleased_(0),
+	junction_(0),
+	trackPointsStart_(0),
+	lookahead_(3)
+{
+	LoadBlockNames();
+}
+
+void RunnerLevel::SetScene(Scene* scene)
+{
+	ClearBranches(false);
+	ClearTrack();
+	pool_->SetScene(scene);
+	scene_ = scene;
+}
+
+void RunnerLevel::SetDebugLayer(DebugLayer* debugLayer)
+{
+	debugLayer_ = debugLayer;
+}
+
+void RunnerLevel::SetLookahead(int blocks)
+{
+	lookahead_ = Max(blocks, 1);
+}
+
+void RunnerLevel::SetScript(LevelScript* script)
+{
+	script_ = script;
+	generator_.choices_.Clear();
+	generator_.nextChoice_ = 0;
+}
+
+Character* RunnerLevel::CreateCharacter()
+{
+	if (!scene_)
+		return 0;
+
+	ResourceCache* cache = GetSubsystem<ResourceCache>();
+	// Create root node of player
+	Node* objectNode = scene_->CreateChild("Player");
+	objectNode->SetPosition(Vector3(0.0f, 40.0f, 0.0f));
+	// Create model node
+	Node* modelNode = objectNode->CreateChild(NODE_PLAYER_MODEL.GetString());
+	modelNode->SetScale(Vector3(.4f, .4f, .4f));
+	modelNode->SetRotation(Quaternion(180, Vector3::UP));
+	// Create the rendering component + animation controller
+	AnimatedModel* object = modelNode->CreateComponent<AnimatedModel>();
+	object->SetModel(cache->GetResource<Model>("Models/vempire.mdl"));
+	object->SetMaterial(cache->GetResource<Material>("Materials/Vempire.xml"));
+	object->SetCastShadows(true);
+	modelNode->CreateComponent<AnimationController>();
+
+	// Set the head bone for manual control
+	object->GetSkeleton().GetBone(NODE_PLAYER_HEAD.GetHash())->animated_ = false;
+
+	// Create the character logic component, which runs the simulation and places the node on the track. It has no physics
+	// body: pickups and hits are decided by the simulation
+	Character* character = objectNode->CreateComponent<Character>();
+	return character;
+}
+
+void RunnerLevel::Start(Character* character, unsigned seed)
+{
+	// Blocks of the previous run go back to the pool, the first blocks below take them from there instead of loading XML
+	ClearBranches();
+	pool_->ReleaseAll();
+	ClearTrack();
+	character_ = character;
+
+	// The kit only depends on the prefabs
+	if (!kit_.GetNumBlocks())
+		CreateSimKit(kit_);
+
+	generator_ = LevelGenerator();
+	generator_.outPosition_ = Vector3(0.0f, 0.0f, -2.0f);
+	generator_.outRotation_ = Quaternion(90, Vector3(1, 0, 0));
+	generator_.seed_ = seed;
+
+	CreateBlocks();
+	character_->StartRun(this);
+}
+
+bool RunnerLevel::Update()
+{
+	if (!character_ || character_->IsDead())
+		return false;
+
+	// The branches past the junction ahead are built a block per frame, so that the turn does not instantiate any
+	bool changed = PrepareBranches();
+
+	// Blocks the character has left go back to the pool. After a turn it runs the junction's exit first, below zero
+	const RunnerSim& sim = character_->GetSim();
+	unsigned current = sim.GetNumBlocks() - 1;
+	unsigned passed = (sim.GetBlockDistance().GetRaw() >= 0 || !current) ? current : current - 1;
+	// Their center path points are freed too, only the choices stay for ghosts following the track
+	unsigned trimmed = 0;
+	for (; numReleased_ < passed && numReleased_ < track_.Size(); ++numReleased_)
+	{
+		TrackBlock& entry = track_[numReleased_];
+		if (entry.block_)
+			pool_->Release(entry.block_);
+		entry.block_ = 0;
+		trimmed += entry.points_.Size();
+		entry.points_.Clear();
+		entry.points_.Compact();
+		changed = true;
+	}
+	if (trimmed)
+	{
+		trackPoints_.Erase(0, trimmed);
+		trackPointsStart_ += trimmed;
+	}
+
+	// The next blocks are generated once the character has entered the last one. A junction waits for the turn
+	if (nextTrackBlock_ >= track_.Size() && !junction_)
+	{
+		CreateBlocks();
+		changed = true;
+	}
+
+	return changed;
+}
+
+void RunnerLevel::Reset()
+{
+	ClearBranches(false);
+	pool_->Reset();
+	ClearTrack();
+	generator_.choices_.Clear();
+	generator_.nextChoice_ = 0;
+	generator_.numBlocks_ = 0;
+}
+
+void RunnerLevel::SaveRun(Serializer& dest) const
+{
+	dest.WriteUInt(generator_.seed_);
+	dest.WriteVLE(generator_.numBlocks_);
+	dest.WriteVector3(generator_.outPosition_);
+	dest.WriteQuaternion(generator_.outRotation_);
+
+	// Blocks are written by prefab index and In node transform. Chosen groups and picked coins are in the enabled flags of
+	// the block's nodes, which come in the same order from every instance of a prefab. The branches past the junction are
+	// left out, the loaded run prepares them again from the same state
+	PODVector<Node*> active;
+	const PODVector<Node*>& blocks = pool_->GetActiveBlocks();
+	for (PODVector<Node*>::ConstIterator i = blocks.Begin(); i != blocks.End(); ++i)
+	{
+		if (!branches_[0].blocks_.Contains(*i) && !branches_[1].blocks_.Contains(*i))
+			active.Push(*i);
+	}
+
+	PODVector<Node*> children;
+	dest.WriteVLE(active.Size());
+	for (unsigned i = 0; i < active.Size(); ++i)
+	{
+		Node* block = active[i];
+		Node* inNode = pool_->GetAnchors(block)->Get(ANCHOR_IN);
+		dest.WriteVLE(blockNames_.Find(block->GetVar(GameVariants::P_PREFAB).GetString()) - blockNames_.Begin());
+		dest.WriteQuaternion(block->GetRotation());
+		dest.WriteVector3(inNode->GetWorldPosition());
+		dest.WriteQuaternion(inNode->GetWorldRotation());
+
+		block->GetChildren(children, true);
+		dest.WriteVLE(children.Size());
+		unsigned char bits = 0;
+		for (unsigned j = 0; j < children.Size(); ++j)
+		{
+			if (children[j]->IsEnabled())
+				bits |= 1 << (j & 7);
+			if ((j & 7) == 7 || j == children.Size() - 1)
+			{
+				dest.WriteUByte(bits);
+				bits = 0;
+			}
+		}
+	}
+
+	// The track from the first block not released yet, with its active block. The released ones are only counted, with
+	// the points they had
+	dest.WriteVLE(numReleased_);
+	dest.WriteVLE(trackPointsStart_);
+	dest.WriteVLE(track_.Size() - numReleased_);
+	for (unsigned i = numReleased_; i < track_.Size(); ++i)
+	{
+		const TrackBlock& entry = track_[i];
+		dest.WriteVLE(entry.block_ ? (unsigned)(active.Find(entry.block_) - active.Begin()) + 1 : 0);
+		dest.WriteVLE(entry.prefab_);
+		dest.WriteVLE(entry.group_ + 1);
+		dest.WriteInt(entry.turn_);
+		dest.WriteFloat(entry.start_);
+		dest.WriteVLE(entry.points_.Size());
+		for (unsigned j = 0; j < entry.points_.Size(); ++j)
+			dest.WriteVector3(entry.points_[j]);
+	}
+	dest.WriteVLE(nextTrackBlock_);
+}
+
+bool RunnerLevel::LoadRun(Deserializer& source, Character* character)
+{
+	ClearBranches();
+	pool_->ReleaseAll();
+	ClearTrack();
+	character_ = character;
+
+	if (!kit_.GetNumBlocks())
+		CreateSimKit(kit_);
+
+	generator_ = LevelGenerator();
+	generator_.seed_ = source.ReadUInt();
+	generator_.numBlocks_ = source.ReadVLE();
+	generator_.outPosition_ = source.ReadVector3();
+	generator_.outRotation_ = source.ReadQuaternion();
+
+	PODVector<Node*> children;
+	unsigned numActive = source.ReadVLE();
+	for (unsigned i = 0; i < numActive; ++i)
+	{
+		unsigned prefab = source.ReadVLE();
+		Quaternion rotation = source.ReadQuaternion();
+		Vector3 inPosition = source.ReadVector3();
+		Quaternion inRotation = source.ReadQuaternion();
+		if (source.IsEof() || prefab >= blockNames_.Size())
+			return false;
+
+		Node* block = pool_->Acquire(blockNames_[prefab], rotation);
+		if (!block)
+			return false;
+		Node* inNode = pool_->GetAnchors(block)->Get(ANCHOR_IN);
+		inNode->SetWorldPosition(inPosition);
+		inNode->SetWorldRotation(inRotation);
+
+		block->GetChildren(children, true);
+		unsigned numChildren = source.ReadVLE();
+		if (numChildren != children.Size())
+			return false;
+
+		unsigned char bits = 0;
+		for (unsigned j = 0; j < numChildren; ++j)
+		{
+			if ((j & 7) == 0)
+				bits = source.ReadUByte();
+			Node* child = children[j];
+			child->SetEnabled((bits & (1 << (j & 7))) != 0);
+
+			if (child->IsEnabled() && child->GetVar(GameVariants::P_ISANIMATED).GetBool())
+			{
+				AnimationController* aCtrl = child->GetOrCreateComponent<AnimationController>();
+				aCtrl->Play(ANIM_ITEM.GetString(), 0, true, 0.0f);
+			}
+		}
+	}
+
+	// Released blocks keep their place in the track, but not their choices
+	numReleased_ = source.ReadVLE();
+	trackPointsStart_ = source.ReadVLE();
+	if (source.IsEof())
+		return false;
+	TrackBlock released;
+	released.block_ = 0;
+	released.prefab_ = M_MAX_UNSIGNED;
+	released.group_ = M_MAX_UNSIGNED;
+	released.turn_ = 0;
+	released.start_ = 0.0f;
+	track_.Reserve(numReleased_);
+	for (unsigned i = 0; i < numReleased_; ++i)
+		track_.Push(released);
+
+	const PODVector<Node*>& active = pool_->GetActiveBlocks();
+	unsigned numTrack = source.ReadVLE();
+	for (unsigned i = 0; i < numTrack; ++i)
+	{
+		TrackBlock entry;
+		unsigned index = source.ReadVLE();
+		entry.prefab_ = source.ReadVLE();
+		entry.group_ = source.ReadVLE() - 1;
+		entry.turn_ = source.ReadInt();
+		entry.start_ = source.ReadFloat();
+		unsigned numPoints = source.ReadVLE();
+		if (source.IsEof() || index > active.Size() || entry.prefab_ >= kit_.GetNumBlocks())
+			return false;
+		entry.block_ = index ? active[index - 1] : 0;
+		entry.points_.Resize(numPoints);
+		for (unsigned j = 0; j < numPoints; ++j)
+			entry.points_[j] = source.ReadVector3();
+
+		track_.Push(entry);
+		trackPoints_.Push(entry.points_);
+	}
+	nextTrackBlock_ = source.ReadVLE();
+	if (nextTrackBlock_ < numReleased_ || nextTrackBlock_ > track_.Size())
+		return false;
+
+	if (!track_.Empty() && track_.Back().block_ && track_.Back().block_->GetVar(GameVariants::P_OUT).GetInt() >= 2)
+		StartBranches(track_.Back().block_);
+
+	return true;
+}
+
+void RunnerLevel::CreateSimKit(SimKit& kit)
+{
+	kit.Clear();
+	if (!scene_)
+		return;
+
+	static const CharacterSide laneSides[] = { LEFT_SIDE, CENTER_SIDE, RIGHT_SIDE };
+
+	for (unsigned i = 0; i < blockNames_.Size(); ++i)
+	{
+		// Blocks stay at their prefab index, a prefab that can not be described gets an empty block the track never uses
+		SimBlock simBlock;
+		Node* block = pool_->Acquire(blockNames_[i], Quaternion::IDENTITY);
+		if (!block)
+		{
+			LOGWARNING("Block " + blockNames_[i] + " could not be loaded for the simulation kit");
+			kit.AddBlock(simBlock);
+			continue;
+		}
+
+		// Lane paths on the ground plane, left to right. A corner continues along its Out path, which the level's track
+		// follows the same way
+		const BlockAnchors* anchors = pool_->GetAnchors(block);
+		int outs = block->GetVar(GameVariants::P_OUT).GetInt();
+		PODVector<Vector3> lanes[3];
+		float pathHeight = 0.0f;
+		for (unsigned j = 0; j < 3; ++j)
+		{
+			for (unsigned exit = ANCHOR_IN; exit <= (outs == 1 ? (unsigned)ANCHOR_OUT : (unsigned)ANCHOR_IN); ++exit)
+			{
+				Node* path = anchors->GetPath(laneSides[j], exit);
+				for (unsigned k = 0; path && k < path->GetNumChildren(); ++k)
+				{
+					Vector3 point = path->GetChild(k)->GetWorldPosition();
+					pathHeight = point.y_;
+					point.y_ = 0.0f;
+					lanes[j].Push(point);
+				}
+			}
+		}
+		if (lanes[1].Size() < 2)
+		{
+			LOGWARNING("Block " + blockNames_[i] + " has no center path, left empty in the simulation kit");
+			kit.AddBlock(simBlock);
+			pool_->Release(block);
+			continue;
+		}
+
+		// Geometry is rounded once here, the simulation itself never touches floating point
+		simBlock.length_ = Fixed::Quantize(GetPathLength(lanes[1]), SIM_KIT_STEPS);
+		if (outs >= 2)
+		{
+			simBlock.leftOut_ = block->GetVar(GameVariants::P_LEFTOUT).GetBool();
+			simBlock.rightOut_ = block->GetVar(GameVariants::P_RIGHTOUT).GetBool();
+
+			// An exit runs from the end of the center lane along the exit's center path
+			for (unsigned j = 0; j < 2; ++j)
+			{
+				PODVector<Vector3> exitPoints;
+				exitPoints.Push(lanes[1].Back());
+				AppendPath(anchors->GetPath(CENTER_SIDE, ANCHOR_OUTL + j), exitPoints);
+				simBlock.exitLength_[j] = Fixed::Quantize(GetPathLength(exitPoints), SIM_KIT_STEPS);
+			}
+		}
+
+		Node* groups = anchors->Get(ANCHOR_GROUPS);
+		unsigned numGroups = groups ? groups->GetNumChildren() : 0;
+		simBlock.groups_.Resize(numGroups);
+		for (unsigned j = 0; j < numGroups; ++j)
+		{
+			Node* group = groups->GetChild(j);
+			for (unsigned k = 0; k < group->GetNumChildren(); ++k)
+			{
+				Node* item = group->GetChild(k);
+				const Variant& points = item->GetVar(GameVariants::P_POINT);
+				bool obstacle = !item->GetVar(GameVariants::P_ISOBSTACLE).IsEmpty();
+				if (points.IsEmpty() && !obstacle)
+					continue;
+
+				// The item is in the lane of the closest path, at the distance of its closest point on the center path
+				Vector3 position = item->GetWorldPosition();
+				float along = 0.0f;
+				float laneDistance = M_INFINITY;
+				int lane = 0;
+				for (unsigned l = 0; l < 3; ++l)
+				{
+					float distance = ProjectOnPath(lanes[l], position, along);
+					if (distance < laneDistance)
+					{
+						laneDistance = distance;
+						lane = (int)l - 1;
+					}
+				}
+				ProjectOnPath(lanes[1], position, along);
+
+				SimFeatureType type = SIM_COIN;
+				if (obstacle)
+					type = position.y_ - pathHeight > SIM_KIT_OVERHEAD ? SIM_HIGH_OBSTACLE : SIM_LOW_OBSTACLE;
+				simBlock.groups_[j].Push(SimFeature(type, lane, Fixed::Quantize(along, SIM_KIT_STEPS), points.GetInt(), k));
+			}
+		}
+
+		kit.AddBlock(simBlock);
+		pool_->Release(block);
+	}
+}
+
+void RunnerLevel::LoadBlockNames()
+{
+	ResourceCache* cache = GetSubsystem<ResourceCache>();
+	if (cache->Exists("Data/RunnerGameKit_Scene.cfg"))
+	{
+		XMLFile* kitConfig = cache->GetResource<XMLFile>("Data/RunnerGameKit_Scene.cfg");
+		if (kitConfig->GetRoot())
+		{
+			// Load all block properties from Scene.cfg file
+			XMLElement rootElement = kitConfig->GetRoot();
+			assert(rootElement.HasChild("block"));
+			XMLElement blockElement = rootElement.GetChild("block");
+			// Traverse all Block nodes
+			for (XMLElement blockElement = rootElement.GetChild(); !blockElement.IsNull(); blockElement = blockElement.GetNext())
+			{
+				String blockName = blockElement.GetAttribute("name");
+				blockNames_.Push("Objects/" + blockName + ".xml");
+			}
+		}
+	}
+	else
+	{
+		blockNames_.Push("Objects/Block1.xml");
+		//blockNames_.Push("Objects/Block2.xml");
+		//blockNames_.Push("Objects/Block3.xml");
+		//blockNames_.Push("Objects/Block4.xml");
+		blockNames_.Push("Objects/Block5.xml");
+		blockNames_.Push("Objects/Block6.xml");
+	}
+}
+
+void RunnerLevel::CreateBlocks()
+{
+	PODVector<Node*> created;
+	GenerateBlocks(generator_, lookahead_, created);
+	AddToTrack(created, 0);
+
+	if (!created.Empty() && created.Back()->GetVar(GameVariants::P_OUT).GetInt() >= 2)
+		StartBranches(created.Back());
+}
+
+void RunnerLevel::AddToTrack(const PODVector<Node*>& blocks, int turn)
+{
+	for (unsigned i = 0; i < blocks.Size(); ++i)
+	{
+		Node* block = blocks[i];
+		const BlockAnchors* anchors = pool_->GetAnchors(block);
+		TrackBlock entry;
+		entry.block_ = block;
+		entry.prefab_ = blockNames_.Find(block->GetVar(GameVariants::P_PREFAB).GetString()) - blockNames_.Begin();
+		entry.group_ = M_MAX_UNSIGNED;
+		entry.turn_ = i ? 0 : turn;
+		entry.start_ = 0.0f;
+
+		Node* groups = anchors->Get(ANCHOR_GROUPS);
+		for (unsigned j = 0; groups && j < groups->GetNumChildren(); ++j)
+		{
+			if (groups->GetChild(j)->IsEnabled())
+			{
+				entry.group_ = j;
+				break;
+			}
+		}
+
+		// The first block past a turn starts with the junction's exit, which the simulation runs below zero
+		if (entry.turn_ && !track_.Empty() && track_.Back().block_ && !track_.Back().points_.Empty())
+		{
+			const TrackBlock& junction = track_.Back();
+			entry.points_.Push(junction.points_.Back());
+			AppendPath(pool_->GetAnchors(junction.block_)->GetPath(CENTER_SIDE, turn < 0 ? ANCHOR_OUTL : ANCHOR_OUTR),
+				entry.points_);
+			if (junction.prefab_ < kit_.GetNumBlocks())
+				entry.start_ = -kit_.GetBlock(junction.prefab_).exitLength_[turn > 0 ? 1 : 0].ToFloat();
+		}
+
+		AppendPath(anchors->GetPath(CENTER_SIDE, ANCHOR_IN), entry.points_);
+		if (block->GetVar(GameVariants::P_OUT).GetInt() == 1)
+			AppendPath(anchors->GetPath(CENTER_SIDE, ANCHOR_OUT), entry.points_);
+
+		track_.Push(entry);
+		trackPoints_.Push(entry.points_);
+	}
+}
+
+void RunnerLevel::ClearTrack()
+{
+	track_.Clear();
+	trackPoints_.Clear();
+	trackPointsStart_ = 0;
+	nextTrackBlock_ = 0;
+	numReleased_ = 0;
+}
+
+void RunnerLevel::GenerateBlocks(LevelGenerator& generator, int count, PODVector<Node*>& dest)
+{
+	int cnt = count;
+	int maxRecursive = 30;
+	bool retry = false;
+	bool drawProbes = debugLayer_ && debugLayer_->IsVisible();
+
+	// Block choices come from the level's own seed, other users of the random generator do not shift them
+	unsigned savedSeed = GetRandomSeed();
+	SetRandomSeed(generator.seed_);
+
+	if (drawProbes)
+		debugLayer_->BeginSet("Probes");
+
+	while (cnt > 0)
+	{
+		Vector3 blockPos = generator.outPosition_;
+		Quaternion blockRot = generator.outRotation_;
+
+		// Initial transform has been given from out node.
+		unsigned int rnd;
+		int group;
+		NextChoice(generator, retry, rnd, group);
+		// Set the starting platform.
+		if (generator.numBlocks_ == 0)
+			rnd = 0;
+
+		Node* blockNode = pool_->Acquire(blockNames_[rnd], blockRot);
+		const BlockAnchors* anchors = pool_->GetAnchors(blockNode);
+		int outs = blockNode->GetVar(GameVariants::P_OUT).GetInt();
+
+		// And, then set actual transform of this block to get offset In node.
+		Node* inNode = anchors->Get(ANCHOR_IN);
+		inNode->SetWorldPosition(blockPos);
+		inNode->SetWorldRotation(generator.outRotation_);
+		//Vector3 offset = inNode->GetPosition();//inNode->GetVar(GameVarirants::P_OFFSET).GetVector3();
+		//Vector3 trans = inNode->GetWorldRotation() * offset;
+		//blockNode->Translate(-trans/*trans*/);
+
+		// Check obstacles before creating coins to prevent cycling path.
+		unsigned exit = ANCHOR_OUT;
+		int twoWay = 1;
+		// If the path is two way turned.
+		if (outs >= 2)
+		{
+			exit = ANCHOR_OUTR;
+			twoWay++;
+		}
+
+		bool accepted = true;
+		Node* outNode = anchors->GetExit(exit);
+
+		while (twoWay > 0)
+		{
+			Vector3 outDir = outNode->GetWorldRotation() * Vector3::LEFT;
+			Vector3 origin = outNode->GetWorldPosition();
+			Ray ray(origin, outDir);
+			PhysicsRaycastResult result;
+
+			PhysicsWorld* world = scene_->GetComponent<PhysicsWorld>();
+			world->RaycastSingle(result, ray, 20.0f, FLOOR_COLLISION_MASK);
+			if (drawProbes)
+				debugLayer_->AddLine(origin, origin + outDir * 20.0f, result.body_ ? Color::RED : Color::GREEN);
+
+			if (result.body_)
+			{
+				if (maxRecursive == 0)
+					assert(false);
+
+				pool_->Release(blockNode);
+				maxRecursive--;
+				accepted = false;
+				break;
+			}
+			else
+			{
+				maxRecursive = 30;
+			}
+
+			// We tried first way as the right exit, then will be trying other way as the left exit.
+			if (outs >= 2)
+				exit = ANCHOR_OUTL;
+
+			twoWay--;
+		}
+
+		// If this created is not accepted then continue.
+		retry = !accepted;
+		if (!accepted)
+			continue;
+
+		// Choose group randomly unless the script chose one.
+		Node* groups = anchors->Get(ANCHOR_GROUPS);
+		int numChildren = groups->GetNumChildren();
+		if (group >= 0 && numChildren > 0)
+			rnd = static_cast<unsigned int>(group % numChildren);
+		else
+			rnd = static_cast<unsigned int>(Random(numChildren));
+		for (unsigned int i = 0; i < groups->GetNumChildren(); i++)
+		{
+			Node* groupNode = groups->GetChild(i);
+			if (i == rnd)
+			{
+				for (unsigned int itemIndex = 0; itemIndex < groupNode->GetNumChildren(); itemIndex++)
+				{
+					Node* itemNode = groupNode->GetChild(itemIndex);
+					bool isAnimated = itemNode->GetVar(GameVariants::P_ISANIMATED).GetBool();
+					if (isAnimated)
+					{
+						AnimationController* aCtrl = itemNode->GetOrCreateComponent<AnimationController>();
+						aCtrl->Play(ANIM_ITEM.GetString(), 0, true, 0.2f);
+					}
+				}
+
+				continue;
+			}
+
+			groupNode->SetEnabled(false, true);
+		}
+
+		cnt--;
+		generator.numBlocks_++;
+		dest.Push(blockNode);
+
+		// If the last block is the straight then,
+		// Go ahead creating the block until the last block is turned one.
+		if (cnt == 0 && outs == 0)
+		{
+			// TODO: You should check the length of straight path.
+			//cnt++;
+		}
+
+		// If the block is the last one that has two way turned, then set the cnt is zero.
+		if (outs >= 2)
+			cnt = 0;
+
+		generator.outPosition_ = outNode->GetWorldPosition();
+		generator.outRotation_ = outNode->GetWorldRotation();
+	}
+
+	generator.seed_ = GetRandomSeed();
+	SetRandomSeed(savedSeed);
+
+	if (drawProbes)
+		debugLayer_->EndSet();
+}
+
+void RunnerLevel::StartBranches(Node* junction)
+{
+	junction_ = junction;
+
+	for (unsigned i = 0; i < 2; ++i)
+	{
+		// Both branches continue from the same state, so the blocks past a turn are the same whichever way it goes
+		LevelBranch& branch = branches_[i];
+		branch.generator_ = generator_;
+		branch.blocks_.Clear();
+		branch.complete_ = false;
+
+		Node* outNode = pool_->GetAnchors(junction)->GetExit(ANCHOR_OUTL + i);
+		if (!outNode)
+		{
+			branch.complete_ = true;
+			continue;
+		}
+		branch.generator_.outPosition_ = outNode->GetWorldPosition();
+		branch.generator_.outRotation_ = outNode->GetWorldRotation();
+	}
+}
+
+bool RunnerLevel::PrepareBranches()
+{
+	if (!junction_)
+		return false;
+
+	// The branch with fewer blocks goes next, so that both are about as far along when the character turns
+	LevelBranch* branch = 0;
+	for (unsigned i = 0; i < 2; ++i)
+	{
+		if (!branches_[i].complete_ && (!branch || branches_[i].blocks_.Size() < branch->blocks_.Size()))
+			branch = &branches_[i];
+	}
+	if (!branch)
+		return false;
+
+	GrowBranch(*branch);
+	return true;
+}
+
+void RunnerLevel::GrowBranch(LevelBranch& branch)
+{
+	// The other branch may lie across this one's way. Its bodies are out of the world while the probes run, so that a branch
+	// depends only on the seed and the turn, not on how far the other one has been prepared
+	LevelBranch& other = &branch == &branches_[0] ? branches_[1] : branches_[0];
+	PODVector<RigidBody*> hidden;
+	for (PODVector<Node*>::ConstIterator i = other.blocks_.Begin(); i != other.blocks_.End(); ++i)
+	{
+		PODVector<RigidBody*> bodies;
+		(*i)->GetComponents(bodies, true);
+		for (PODVector<RigidBody*>::ConstIterator j = bodies.Begin(); j != bodies.End(); ++j)
+		{
+			if ((*j)->IsEnabled())
+			{
+				(*j)->SetEnabled(false);
+				hidden.Push(*j);
+			}
+		}
+	}
+
+	unsigned numBlocks = branch.blocks_.Size();
+	GenerateBlocks(branch.generator_, 1, branch.blocks_);
+
+	for (PODVector<RigidBody*>::ConstIterator i = hidden.Begin(); i != hidden.End(); ++i)
+		(*i)->SetEnabled(true);
+
+	// A branch ends at the lookahead like the blocks before the junction, or at a junction of its own
+	if (branch.blocks_.Size() == numBlocks || branch.blocks_.Size() >= (unsigned)lookahead_ ||
+		branch.blocks_.Back()->GetVar(GameVariants::P_OUT).GetInt() >= 2)
+		branch.complete_ = true;
+}
+
+void RunnerLevel::CommitBranch(unsigned exit)
+{
+	LevelBranch& taken = branches_[exit == ANCHOR_OUTL ? 0 : 1];
+	LevelBranch& other = branches_[exit == ANCHOR_OUTL ? 1 : 0];
+
+	// The other branch goes back to the pool before the taken one is finished, so that its blocks do not stop the probes
+	for (PODVector<Node*>::ConstIterator i = other.blocks_.Begin(); i != other.blocks_.End(); ++i)
+		pool_->Release(*i);
+	other.blocks_.Clear();
+	other.complete_ = true;
+
+	// A turn taken before the branch was prepared finishes it here
+	while (!taken.complete_)
+		GrowBranch(taken);
+
+	junction_ = 0;
+	generator_ = taken.generator_;
+	AddToTrack(taken.blocks_, exit == ANCHOR_OUTL ? -1 : 1);
+
+	Node* last = taken.blocks_.Empty() ? 0 : taken.blocks_.Back();
+	taken.blocks_.Clear();
+	if (last && last->GetVar(GameVariants::P_OUT).GetInt() >= 2)
+		StartBranches(last);
+}
+
+void RunnerLevel::ClearBranches(bool release)
+{
+	for (unsigned i = 0; i < 2; ++i)
+	{
+		for (PODVector<Node*>::ConstIterator j = branches_[i].blocks_.Begin(); release && j != branches_[i].blocks_.End(); ++j)
+			pool_->Release(*j);
+		branches_[i].blocks_.Clear();
+		branches_[i].complete_ = false;
+	}
+
+	junction_ = 0;
+}
+
+void RunnerLevel::NextChoice(LevelGenerator& generator, bool retry, unsigned& block, int& group)
+{
+	unsigned numPrefabs = blockNames_.Size();
+
+	// A choice the probes rejected is retried with a random block, so a script can not stall the generator
+	if (script_ && script_->IsLoaded() && !retry)
+	{
+		if (generator.nextChoice_ >= generator.choices_.Size())
+		{
+			// The script's seed comes from the level's generator, so a seeded run gets the same scripted blocks again
+			generator.choices_.Clear();
+			generator.nextChoice_ = 0;
+			script_->ChooseBlocks(generator.numBlocks_, LEVEL_SCRIPT_BATCH, numPrefabs, static_cast<unsigned int>(Rand()),
+				generator.choices_);
+		}
+		if (generator.nextChoice_ < generator.choices_.Size())
+		{
+			const BlockChoice& choice = generator.choices_[generator.nextChoice_++];
+			block = choice.block_;
+			group = choice.group_;
+			return;
+		}
+	}
+
+	block = static_cast<unsigned int>(Random((int)numPrefabs));
+	group = -1;
+}
+
+bool RunnerLevel::GetNextBlock(int turn, unsigned& block, unsigned& group)
+{
+	// The track ends at a junction until the character turns into one of its branches
+	if (nextTrackBlock_ >= track_.Size())
+	{
+		if (junction_)
+		{
+			if (!turn)
+				return false;
+			CommitBranch(turn < 0 ? ANCHOR_OUTL : ANCHOR_OUTR);
+		}
+		else
+			CreateBlocks();
+	}
+	if (nextTrackBlock_ >= track_.Size())
+		return false;
+
+	const TrackBlock& entry = track_[nextTrackBlock_++];
+	block = entry.prefab_;
+	group = entry.group_;
+	return true;
+}
+
+bool RunnerLevel::GetTrackTransform(unsigned index, float distance, float lateral, Vector3& position, Vector3& direction) const
+{
+	if (index >= track_.Size() || track_[index].points_.Empty())
+		return false;
+
+	// Walk the center lane on the ground plane like the kit measured it, and step sideways from it
+	const PODVector<Vector3>& points = track_[index].points_;
+	float remaining = distance - track_[index].start_;
+	position = points[0];
+	direction = Vector3::FORWARD;
+	for (unsigned i = 0; i + 1 < points.Size(); ++i)
+	{
+		Vector3 segment = points[i + 1] - points[i];
+		Vector3 flat(segment.x_, 0.0f, segment.z_);
+		float length = flat.Length();
+		if (length < M_EPSILON)
+			continue;
+		direction = flat / length;
+		if (remaining <= length || i + 2 == points.Size())
+		{
+			position = points[i] + segment * (Max(remaining, 0.0f) / length);
+			break;
+		}
+		remaining -= length;
+		position = points[i + 1];
+	}
+
+	position += Vector3::UP.CrossProduct(direction) * lateral;
+	return true;
+}
+
+Node* RunnerLevel::GetTrackItem(unsigned index, unsigned item) const
+{
+	if (index >= track_.Size() || !track_[index].block_)
+		return 0;
+
+	const TrackBlock& entry = track_[index];
+	Node* groups = pool_->GetAnchors(entry.block_)->Get(ANCHOR_GROUPS);
+	Node* group = groups && entry.group_ < groups->GetNumChildren() ? groups->GetChild(entry.group_) : 0;
+	return group && item < group->GetNumChildren() ? group->GetChild(item) : 0;
+}
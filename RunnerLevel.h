@@ -0,0 +1,226 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "LevelScript.h"
+#include "Object.h"
+#include "Quaternion.h"
+#include "RunnerSim.h"
+
+using namespace Urho3D;
+
+namespace Urho3D
+{
+	class Deserializer;
+	class Node;
+	class Scene;
+	class Serializer;
+}
+
+class BlockPool;
+class Character;
+class DebugLayer;
+
+/// Block generation state: where the next block attaches, the random state and the script's choice batch. Each branch past a
+/// junction is generated from its own copy.
+struct LevelGenerator
+{
+	/// Construct.
+	LevelGenerator() :
+		numBlocks_(0),
+		seed_(1),
+		nextChoice_(0)
+	{
+	}
+
+	/// Transform the next block is attached to.
+	Vector3 outPosition_;
+	Quaternion outRotation_;
+	/// Blocks generated since the start.
+	unsigned numBlocks_;
+	/// Random seed state.
+	unsigned seed_;
+	/// Block choices of the last script batch.
+	PODVector<BlockChoice> choices_;
+	/// Next block choice to use.
+	unsigned nextChoice_;
+};
+
+/// Blocks generated speculatively past one exit of a junction, before the character has turned.
+struct LevelBranch
+{
+	/// Construct.
+	LevelBranch() :
+		complete_(false)
+	{
+	}
+
+	/// Generation state after the branch's blocks.
+	LevelGenerator generator_;
+	/// Blocks of the branch in order.
+	PODVector<Node*> blocks_;
+	/// Whether the branch has reached the lookahead or a junction of its own.
+	bool complete_;
+};
+
+/// Placed block on the character's track, with the world points its simulated distance maps to.
+struct TrackBlock
+{
+	/// Block node. Goes back to the pool once the character has passed it, and the points are freed.
+	Node* block_;
+	/// Prefab index, which is also the block's index in the simulation kit. M_MAX_UNSIGNED for a block released before the
+	/// run was loaded, whose choices are not kept.
+	unsigned prefab_;
+	/// Chosen item group, or M_MAX_UNSIGNED if the block has none.
+	unsigned group_;
+	/// Turn into the block, -1 left, 1 right, 0 straight on.
+	int turn_;
+	/// Center lane points, starting with the exit of the junction before the block if it follows a turn.
+	PODVector<Vector3> points_;
+	/// Simulated distance of the first point, below zero by the length of the junction exit.
+	float start_;
+};
+
+/// Endless level of one runner. Streams blocks ahead of the character from its own block pool and random seed, so several
+/// levels can be generated side by side in one process without affecting each other's block choices. The placed blocks are
+/// the track of the character's simulation, which asks for the next block as it runs off the current one.
+class RunnerLevel : public Object, public SimTrack
+{
+	OBJECT(RunnerLevel);
+
+public:
+	/// Construct.
+	RunnerLevel(Context* context);
+
+	/// Set the scene blocks are created into. Drops all blocks.
+	void SetScene(Scene* scene);
+	/// Set the debug layer the ray probes are drawn into. Optional.
+	void SetDebugLayer(DebugLayer* debugLayer);
+	/// Set the number of blocks generated ahead of the character.
+	void SetLookahead(int blocks);
+	/// Set the script that chooses the blocks, or null to use the built-in random choice.
+	void SetScript(LevelScript* script);
+	/// Create the player node with its model and character component.
+	Character* CreateCharacter();
+	/// Release all blocks, generate the first ones from a seed and start the character's run on them.
+	void Start(Character* character, unsigned seed);
+	/// Release the blocks the character has passed, generate new blocks when it has entered the last one, and prepare a
+	/// block of the branches past the junction ahead. Return true if anything changed.
+	bool Update();
+	/// Forget all blocks and remove the pooled ones. Call when the blocks have been removed from the scene otherwise.
+	void Reset();
+	/// Write the random state, block chain, track and the enabled state of each block's nodes for a snapshot.
+	void SaveRun(Serializer& dest) const;
+	/// Rebuild the blocks and track of a snapshot for a character from pooled or cached prefabs. Return false if the data is
+	/// malformed.
+	bool LoadRun(Deserializer& source, Character* character);
+
+	/// Describe each block prefab for the deterministic simulation: lane length, turn exits, and the coins and obstacles of
+	/// each group. The kit has a block for each prefab, by prefab index. Needs a scene to instantiate the prefabs into.
+	void CreateSimKit(SimKit& kit);
+	/// Return the next block of the track for the character's simulation. Past a junction the branch of the turn is taken.
+	virtual bool GetNextBlock(int turn, unsigned& block, unsigned& group);
+	/// Return the world position and heading of a simulated distance and sideways offset on a block of the track. Return
+	/// false if the block is not on the track.
+	bool GetTrackTransform(unsigned index, float distance, float lateral, Vector3& position, Vector3& direction) const;
+	/// Return the node of an item of a block on the track, or null if the block has been released.
+	Node* GetTrackItem(unsigned index, unsigned item) const;
+
+	/// Return the block pool.
+	BlockPool* GetPool() const { return pool_; }
+	/// Return the number of blocks generated ahead of the character.
+	int GetLookahead() const { return lookahead_; }
+	/// Return the number of blocks generated since the start, not counting the branches not yet taken.
+	unsigned GetNumBlocks() const { return generator_.numBlocks_; }
+	/// Return the number of blocks prepared past the junction ahead.
+	unsigned GetNumBranchBlocks() const { return branches_[0].blocks_.Size() + branches_[1].blocks_.Size(); }
+	/// Return the simulation kit of the block prefabs.
+	const SimKit& GetSimKit() const { return kit_; }
+	/// Return the number of blocks on the track, the ones the character has run and the ones generated ahead of it.
+	unsigned GetTrackSize() const { return track_.Size(); }
+	/// Return a block of the track by its number from the start.
+	const TrackBlock& GetTrackBlock(unsigned index) const { return track_[index]; }
+	/// Return the center path points of the track from the first block not released yet, in order.
+	const PODVector<Vector3>& GetTrackPoints() const { return trackPoints_; }
+	/// Return the number of center path points of the released blocks, dropped before the first returned one.
+	unsigned GetTrackPointsStart() const { return trackPointsStart_; }
+
+private:
+	/// Read the block prefab names from the kit configuration, or use the built-in ones.
+	void LoadBlockNames();
+	/// Generate blocks up to the next junction or the lookahead count, and start the branches past the junction.
+	void CreateBlocks();
+	/// Append generated blocks to the track, the first one entered by a turn from the junction at the end of the track.
+	void AddToTrack(const PODVector<Node*>& blocks, int turn);
+	/// Forget the track and its cursors.
+	void ClearTrack();
+	/// Generate up to a number of blocks from a generation state, stopping after a junction.
+	void GenerateBlocks(LevelGenerator& generator, int count, PODVector<Node*>& dest);
+	/// Set up the branches past both exits of a junction. They are generated later, a block at a time.
+	void StartBranches(Node* junction);
+	/// Generate the next block of the branch that has fewer. Return true if a block was generated.
+	bool PrepareBranches();
+	/// Generate the next block of a branch.
+	void GrowBranch(LevelBranch& branch);
+	/// Continue the track with the branch past an exit of the junction and release the other one.
+	void CommitBranch(unsigned exit);
+	/// Forget both branches, and release their blocks unless they have been removed otherwise.
+	void ClearBranches(bool release = true);
+	/// Choose the prefab and item group of the next block, from the script's batch or at random. The group is negative
+	/// for a random one.
+	void NextChoice(LevelGenerator& generator, bool retry, unsigned& block, int& group);
+
+	/// Scene.
+	WeakPtr<Scene> scene_;
+	/// Block pool.
+	SharedPtr<BlockPool> pool_;
+	/// Debug layer.
+	WeakPtr<DebugLayer> debugLayer_;
+	/// Character running the level.
+	WeakPtr<Character> character_;
+	/// Block choice script.
+	WeakPtr<LevelScript> script_;
+	/// Block prefab names.
+	Vector<String> blockNames_;
+	/// Generation state of the blocks on the track.
+	LevelGenerator generator_;
+	/// Simulation kit of the block prefabs.
+	SimKit kit_;
+	/// Blocks of the character's track from the start.
+	Vector<TrackBlock> track_;
+	/// Next block of the track to hand to the simulation.
+	unsigned nextTrackBlock_;
+	/// Blocks of the track released to the pool.
+	unsigned numReleased_;
+	/// Junction whose branches are being prepared.
+	Node* junction_;
+	/// Branches past the left and right exits of the junction.
+	LevelBranch branches_[2];
+	/// Center path points of the track from the first block not released yet.
+	PODVector<Vector3> trackPoints_;
+	/// Center path points dropped with the released blocks.
+	unsigned trackPointsStart_;
+	/// Blocks generated ahead of the character.
+	int lookahead_;
+};
@@ -0,0 +1,599 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "Character.h"
+#include "Deserializer.h"
+#include "MathDefs.h"
+#include "RunnerSim.h"
+#include "Serializer.h"
+#include "Sort.h"
+
+/// Length of a step.
+static const Fixed SIM_STEP = Fixed::FromRatio(1, SIM_FPS);
+/// Sideways distance from an item within which it is hit or picked up.
+static const Fixed SIM_REACH = Fixed::FromRatio(7, 10);
+/// Running speed reached quickly from standing.
+static const Fixed SIM_START_SPEED = Fixed::FromInt(6);
+/// Top running speed.
+static const Fixed SIM_MAX_SPEED = Fixed::FromInt(12);
+/// Speed change per step below the start speed, above it, and when not running.
+static const Fixed SIM_START_ACCEL = Fixed::FromRatio(12, SIM_FPS);
+static const Fixed SIM_SPEEDUP = Fixed::FromRatio(1, 10 * SIM_FPS);
+static const Fixed SIM_BRAKE = Fixed::FromRatio(20, SIM_FPS);
+/// Sideways movement per step when changing lane.
+static const Fixed SIM_LANE_STEP = Fixed::FromRatio(8, SIM_FPS);
+/// Vertical speed change per step in the air.
+static const Fixed SIM_GRAVITY_STEP = Fixed::FromRatio(25, SIM_FPS);
+/// Take-off speed of a jump.
+static const Fixed SIM_JUMP_SPEED = Fixed::FromInt(8);
+/// Height that clears a ground obstacle.
+static const Fixed SIM_LOW_CLEARANCE = Fixed::FromRatio(1, 2);
+/// Stretch before the end of a junction block where left and right turn instead of changing lane.
+static const Fixed SIM_TURN_ZONE = Fixed::FromInt(4);
+/// Shortest block, so that a step never crosses a whole block.
+static const Fixed SIM_MIN_BLOCK_LENGTH = Fixed::FromInt(1);
+/// Steps of a roll.
+static const int SIM_ROLL_STEPS = 36;
+/// Steps a left/right action is remembered as a turn request, a fifth of a second.
+static const int SIM_TURN_STEPS = 12;
+/// Distance the bot looks ahead.
+static const Fixed SIM_BOT_LOOKAHEAD = Fixed::FromInt(3);
+/// Distance before the end of a junction where the bot turns.
+static const Fixed SIM_BOT_TURN_DISTANCE = Fixed::FromInt(2);
+
+/// Items of a block without groups.
+static const PODVector<SimFeature> noFeatures;
+
+/// Fold a word into an FNV-1a hash byte by byte, so that the result does not depend on byte order.
+static unsigned HashWord(unsigned hash, unsigned word)
+{
+	for (unsigned i = 0; i < 4; ++i)
+	{
+		hash ^= (word >> (i * 8)) & 0xff;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/// Compare items by distance.
+static bool CompareFeatures(const SimFeature& lhs, const SimFeature& rhs)
+{
+	return lhs.distance_ < rhs.distance_;
+}
+
+/// Add a row of coins to a group.
+static void AddCoins(PODVector<SimFeature>& group, int lane, int from, int to)
+{
+	for (int distance = from; distance <= to; distance += 2)
+		group.Push(SimFeature(SIM_COIN, lane, Fixed::FromInt(distance), 5));
+}
+
+void SimKit::CreateDefault()
+{
+	blocks_.Clear();
+
+	// Starting platform
+	SimBlock start;
+	start.length_ = Fixed::FromInt(20);
+	AddBlock(start);
+
+	SimBlock straight;
+	straight.length_ = Fixed::FromInt(20);
+	straight.groups_.Resize(3);
+	AddCoins(straight.groups_[0], 0, 4, 10);
+	straight.groups_[0].Push(SimFeature(SIM_LOW_OBSTACLE, 0, Fixed::FromInt(14)));
+	AddCoins(straight.groups_[1], -1, 4, 10);
+	straight.groups_[1].Push(SimFeature(SIM_HIGH_OBSTACLE, 0, Fixed::FromInt(12)));
+	straight.groups_[1].Push(SimFeature(SIM_WALL, 1, Fixed::FromInt(12)));
+	straight.groups_[2].Push(SimFeature(SIM_WALL, 0, Fixed::FromInt(10)));
+	AddCoins(straight.groups_[2], 1, 12, 16);
+	AddBlock(straight);
+
+	SimBlock barrier;
+	barrier.length_ = Fixed::FromInt(30);
+	barrier.groups_.Resize(2);
+	for (int lane = -1; lane <= 1; ++lane)
+	{
+		barrier.groups_[0].Push(SimFeature(SIM_LOW_OBSTACLE, lane, Fixed::FromInt(15)));
+		barrier.groups_[1].Push(SimFeature(SIM_HIGH_OBSTACLE, lane, Fixed::FromInt(10)));
+	}
+	AddCoins(barrier.groups_[0], 0, 20, 24);
+	AddCoins(barrier.groups_[1], -1, 15, 21);
+	AddBlock(barrier);
+
+	SimBlock leftTurn;
+	leftTurn.length_ = Fixed::FromInt(20);
+	leftTurn.leftOut_ = true;
+	leftTurn.groups_.Resize(1);
+	AddCoins(leftTurn.groups_[0], 0, 4, 8);
+	AddBlock(leftTurn);
+
+	SimBlock rightTurn;
+	rightTurn.length_ = Fixed::FromInt(20);
+	rightTurn.rightOut_ = true;
+	rightTurn.groups_.Resize(1);
+	rightTurn.groups_[0].Push(SimFeature(SIM_WALL, -1, Fixed::FromInt(8)));
+	AddCoins(rightTurn.groups_[0], 1, 6, 10);
+	AddBlock(rightTurn);
+
+	SimBlock fork;
+	fork.length_ = Fixed::FromInt(24);
+	fork.leftOut_ = true;
+	fork.rightOut_ = true;
+	fork.groups_.Resize(1);
+	fork.groups_[0].Push(SimFeature(SIM_LOW_OBSTACLE, 0, Fixed::FromInt(10)));
+	AddCoins(fork.groups_[0], -1, 10, 14);
+	AddBlock(fork);
+}
+
+void SimKit::AddBlock(const SimBlock& block)
+{
+	blocks_.Push(block);
+	SimBlock& added = blocks_.Back();
+	added.length_ = Max(added.length_, SIM_MIN_BLOCK_LENGTH);
+	for (unsigned i = 0; i < added.groups_.Size(); ++i)
+		Sort(added.groups_[i].Begin(), added.groups_[i].End(), CompareFeatures);
+}
+
+RunnerSim::RunnerSim() :
+	kit_(0),
+	track_(0),
+	seed_(0),
+	step_(0),
+	block_(0),
+	group_(M_MAX_UNSIGNED),
+	numBlocks_(0),
+	hitItem_(M_MAX_UNSIGNED),
+	distance_(0),
+	lane_(0),
+	rollSteps_(0),
+	turnSteps_(0),
+	turnDirection_(0),
+	numTurns_(0),
+	score_(0),
+	numCoins_(0),
+	dead_(true)
+{
+}
+
+void RunnerSim::Start(const SimKit* kit, unsigned seed)
+{
+	track_ = 0;
+	seed_ = seed;
+	Begin(kit);
+}
+
+void RunnerSim::Start(const SimKit* kit, SimTrack* track)
+{
+	track_ = track;
+	seed_ = 0;
+	Begin(kit);
+}
+
+void RunnerSim::Step(int buttons, int actions)
+{
+	++step_;
+	pickups_.Clear();
+	if (dead_)
+		return;
+
+	const SimBlock& block = GetBlock();
+	bool inTurnZone = block.IsJunction() && blockDistance_ >= block.length_ - SIM_TURN_ZONE;
+
+	// Left/right is kept as a turn request for a short while, or as long as it is held
+	if (turnSteps_ > 0)
+		--turnSteps_;
+	if ((actions | buttons) & CTRL_LEFT)
+	{
+		turnDirection_ = -1;
+		turnSteps_ = SIM_TURN_STEPS;
+	}
+	else if ((actions | buttons) & CTRL_RIGHT)
+	{
+		turnDirection_ = 1;
+		turnSteps_ = SIM_TURN_STEPS;
+	}
+
+	// Near a junction left and right are turns, not lane changes
+	if (!inTurnZone)
+	{
+		if (actions & CTRL_LEFT)
+			lane_ = Max(lane_ - 1, -1);
+		if (actions & CTRL_RIGHT)
+			lane_ = Min(lane_ + 1, 1);
+	}
+
+	if ((actions & CTRL_JUMP) && IsOnGround())
+	{
+		verticalSpeed_ = SIM_JUMP_SPEED;
+		rollSteps_ = 0;
+	}
+
+	if (actions & CTRL_BACK)
+	{
+		rollSteps_ = SIM_ROLL_STEPS;
+		// Rolling in the air dives back to the ground
+		if (!IsOnGround())
+			verticalSpeed_ = Min(verticalSpeed_, -SIM_JUMP_SPEED);
+	}
+	else if (rollSteps_ > 0)
+		--rollSteps_;
+
+	if (buttons & CTRL_FORWARD)
+	{
+		if (speed_ < SIM_START_SPEED)
+			speed_ = Min(speed_ + SIM_START_ACCEL, SIM_START_SPEED);
+		else
+			speed_ = Min(speed_ + SIM_SPEEDUP, SIM_MAX_SPEED);
+	}
+	else
+		speed_ = Max(speed_ - SIM_BRAKE, Fixed());
+
+	Fixed target = SIM_LANE_WIDTH * lane_;
+	if (lateral_ < target)
+		lateral_ = Min(lateral_ + SIM_LANE_STEP, target);
+	else if (lateral_ > target)
+		lateral_ = Max(lateral_ - SIM_LANE_STEP, target);
+
+	// Explicit Euler on the step grid, the arc is the same for every jump and every build
+	if (!IsOnGround())
+	{
+		verticalSpeed_ -= SIM_GRAVITY_STEP;
+		height_ += verticalSpeed_ * SIM_STEP;
+		if (height_.GetRaw() <= 0)
+		{
+			height_ = Fixed();
+			verticalSpeed_ = Fixed();
+		}
+	}
+
+	Fixed advance = speed_ * SIM_STEP;
+	Fixed from = blockDistance_;
+	blockDistance_ += advance;
+	distance_ += advance.GetRaw();
+	Pass(from, Min(blockDistance_, block.length_));
+
+	while (!dead_ && blockDistance_ >= GetBlock().length_)
+	{
+		const SimBlock& ending = GetBlock();
+		int turn = 0;
+		if (ending.IsJunction())
+		{
+			// Running past a junction without a request for one of its exits ends the run
+			bool turnLeft = turnSteps_ > 0 && turnDirection_ < 0 && ending.leftOut_;
+			bool turnRight = turnSteps_ > 0 && turnDirection_ > 0 && ending.rightOut_;
+			if (!turnLeft && !turnRight)
+			{
+				blockDistance_ = ending.length_;
+				dead_ = true;
+				break;
+			}
+
+			turn = turnLeft ? -1 : 1;
+		}
+
+		// The exit taken is run before the next block starts, at distances below zero
+		Fixed overrun = blockDistance_ - ending.length_;
+		if (turn)
+			overrun -= ending.exitLength_[turn > 0 ? 1 : 0];
+		if (!EnterBlock(false, turn))
+		{
+			blockDistance_ = ending.length_;
+			dead_ = true;
+			break;
+		}
+
+		if (turn)
+		{
+			++numTurns_;
+			turnSteps_ = 0;
+		}
+		blockDistance_ = overrun;
+		// Items at the very start of the new block count as passed too
+		Pass(Fixed::FromRaw(-1), Min(blockDistance_, GetBlock().length_));
+	}
+}
+
+void RunnerSim::Save(Serializer& dest) const
+{
+	dest.WriteUInt(seed_);
+	dest.WriteUInt(step_);
+	dest.WriteUInt(block_);
+	dest.WriteUInt(group_);
+	dest.WriteUInt(numBlocks_);
+	dest.WriteInt(blockDistance_.GetRaw());
+	dest.WriteUInt((unsigned)distance_);
+	dest.WriteUInt((unsigned)(distance_ >> 32));
+	dest.WriteInt(speed_.GetRaw());
+	dest.WriteInt(lateral_.GetRaw());
+	dest.WriteInt(height_.GetRaw());
+	dest.WriteInt(verticalSpeed_.GetRaw());
+	dest.WriteInt(lane_);
+	dest.WriteInt(rollSteps_);
+	dest.WriteInt(turnSteps_);
+	dest.WriteInt(turnDirection_);
+	dest.WriteInt(numTurns_);
+	dest.WriteInt(score_);
+	dest.WriteInt(numCoins_);
+	dest.WriteBool(dead_);
+	dest.WriteVLE(picked_.Size());
+	for (unsigned i = 0; i < picked_.Size(); ++i)
+		dest.WriteUByte(picked_[i]);
+}
+
+bool RunnerSim::Load(Deserializer& source, const SimKit* kit, SimTrack* track)
+{
+	kit_ = kit;
+	track_ = track;
+	seed_ = source.ReadUInt();
+	step_ = source.ReadUInt();
+	block_ = source.ReadUInt();
+	group_ = source.ReadUInt();
+	numBlocks_ = source.ReadUInt();
+	blockDistance_ = Fixed::FromRaw(source.ReadInt());
+	distance_ = source.ReadUInt();
+	distance_ |= (long long)source.ReadUInt() << 32;
+	speed_ = Fixed::FromRaw(source.ReadInt());
+	lateral_ = Fixed::FromRaw(source.ReadInt());
+	height_ = Fixed::FromRaw(source.ReadInt());
+	verticalSpeed_ = Fixed::FromRaw(source.ReadInt());
+	lane_ = source.ReadInt();
+	rollSteps_ = source.ReadInt();
+	turnSteps_ = source.ReadInt();
+	turnDirection_ = source.ReadInt();
+	numTurns_ = source.ReadInt();
+	score_ = source.ReadInt();
+	numCoins_ = source.ReadInt();
+	dead_ = source.ReadBool();
+	pickups_.Clear();
+	hitItem_ = M_MAX_UNSIGNED;
+
+	// A state that does not fit the kit would index past its blocks and items
+	if (!kit_ || block_ >= kit_->GetNumBlocks() || (group_ != M_MAX_UNSIGNED && group_ >= GetBlock().groups_.Size()))
+		return false;
+	unsigned numPicked = source.ReadVLE();
+	if (numPicked != GetFeatures().Size())
+		return false;
+	picked_.Resize(numPicked);
+	for (unsigned i = 0; i < numPicked; ++i)
+		picked_[i] = source.ReadUByte();
+	return true;
+}
+
+unsigned RunnerSim::GetChecksum() const
+{
+	unsigned hash = 2166136261u;
+	hash = HashWord(hash, seed_);
+	hash = HashWord(hash, step_);
+	hash = HashWord(hash, block_);
+	hash = HashWord(hash, group_);
+	hash = HashWord(hash, numBlocks_);
+	hash = HashWord(hash, (unsigned)blockDistance_.GetRaw());
+	hash = HashWord(hash, (unsigned)distance_);
+	hash = HashWord(hash, (unsigned)(distance_ >> 32));
+	hash = HashWord(hash, (unsigned)speed_.GetRaw());
+	hash = HashWord(hash, (unsigned)lateral_.GetRaw());
+	hash = HashWord(hash, (unsigned)height_.GetRaw());
+	hash = HashWord(hash, (unsigned)verticalSpeed_.GetRaw());
+	hash = HashWord(hash, (unsigned)lane_);
+	hash = HashWord(hash, (unsigned)rollSteps_);
+	hash = HashWord(hash, (unsigned)turnSteps_);
+	hash = HashWord(hash, (unsigned)turnDirection_);
+	hash = HashWord(hash, (unsigned)numTurns_);
+	hash = HashWord(hash, (unsigned)score_);
+	hash = HashWord(hash, (unsigned)numCoins_);
+	hash = HashWord(hash, dead_ ? 1 : 0);
+	for (unsigned i = 0; i < picked_.Size(); ++i)
+		hash = HashWord(hash, picked_[i]);
+	return hash;
+}
+
+const PODVector<SimFeature>& RunnerSim::GetFeatures() const
+{
+	return group_ != M_MAX_UNSIGNED ? GetBlock().groups_[group_] : noFeatures;
+}
+
+void RunnerSim::Begin(const SimKit* kit)
+{
+	kit_ = kit;
+	step_ = 0;
+	numBlocks_ = 0;
+	pickups_.Clear();
+	hitItem_ = M_MAX_UNSIGNED;
+	blockDistance_ = Fixed();
+	distance_ = 0;
+	speed_ = Fixed();
+	lateral_ = Fixed();
+	height_ = Fixed();
+	verticalSpeed_ = Fixed();
+	lane_ = 0;
+	rollSteps_ = 0;
+	turnSteps_ = 0;
+	turnDirection_ = 0;
+	numTurns_ = 0;
+	score_ = 0;
+	numCoins_ = 0;
+	dead_ = !kit_ || !kit_->GetNumBlocks() || !EnterBlock(true, 0);
+}
+
+bool RunnerSim::EnterBlock(bool first, int turn)
+{
+	if (track_)
+	{
+		unsigned block;
+		unsigned group;
+		if (!track_->GetNextBlock(turn, block, group) || block >= kit_->GetNumBlocks())
+			return false;
+		block_ = block;
+		group_ = group < GetBlock().groups_.Size() ? group : M_MAX_UNSIGNED;
+	}
+	else
+	{
+		// Like the level, the track starts with the first block as the starting platform
+		block_ = first ? 0 : (unsigned)Rand() % kit_->GetNumBlocks();
+		const SimBlock& block = GetBlock();
+		group_ = block.groups_.Empty() ? M_MAX_UNSIGNED : (unsigned)Rand() % block.groups_.Size();
+	}
+	++numBlocks_;
+
+	picked_.Resize(GetFeatures().Size());
+	for (unsigned i = 0; i < picked_.Size(); ++i)
+		picked_[i] = 0;
+	return true;
+}
+
+void RunnerSim::Pass(Fixed from, Fixed to)
+{
+	const PODVector<SimFeature>& features = GetFeatures();
+	for (unsigned i = 0; i < features.Size() && !dead_; ++i)
+	{
+		const SimFeature& feature = features[i];
+		if (feature.distance_ <= from)
+			continue;
+		if (feature.distance_ > to)
+			break;
+		if (picked_[i] || Abs(lateral_ - SIM_LANE_WIDTH * feature.lane_) >= SIM_REACH)
+			continue;
+
+		switch (feature.type_)
+		{
+		case SIM_COIN:
+			{
+				picked_[i] = 1;
+				score_ += feature.points_;
+				++numCoins_;
+
+				SimPickup pickup;
+				pickup.block_ = numBlocks_ - 1;
+				pickup.item_ = feature.item_;
+				pickup.points_ = feature.points_;
+				pickups_.Push(pickup);
+			}
+			break;
+
+		case SIM_LOW_OBSTACLE:
+			if (height_ < SIM_LOW_CLEARANCE)
+				dead_ = true;
+			break;
+
+		case SIM_HIGH_OBSTACLE:
+			if (!rollSteps_)
+				dead_ = true;
+			break;
+
+		case SIM_WALL:
+			dead_ = true;
+			break;
+		}
+
+		if (dead_)
+			hitItem_ = feature.item_;
+	}
+}
+
+int RunnerSim::Rand()
+{
+	// The engine's generator, on state of its own
+	seed_ = seed_ * 214013 + 2531011;
+	return (seed_ >> 16) & 32767;
+}
+
+SimBot::SimBot(unsigned seed) :
+	seed_(seed * 2654435761u)
+{
+}
+
+int SimBot::GetActions(const RunnerSim& sim)
+{
+	seed_ = seed_ * 214013 + 2531011;
+	int random = (seed_ >> 16) & 32767;
+
+	// Now and then a careless action, so that not every run is perfect
+	if (random % 150 == 0)
+		return CTRL_BACK << (random / 150 % 4);
+
+	const SimBlock& block = sim.GetBlock();
+	Fixed distance = sim.GetBlockDistance();
+	if (block.IsJunction() && distance >= block.length_ - SIM_BOT_TURN_DISTANCE)
+	{
+		if (block.leftOut_ && (!block.rightOut_ || (random & 1)))
+			return CTRL_LEFT;
+		return CTRL_RIGHT;
+	}
+
+	const PODVector<SimFeature>& features = sim.GetFeatures();
+	int lane = sim.GetLane();
+	for (unsigned i = 0; i < features.Size(); ++i)
+	{
+		const SimFeature& feature = features[i];
+		if (feature.distance_ <= distance || feature.lane_ != lane || feature.type_ == SIM_COIN)
+			continue;
+		if (feature.distance_ > distance + SIM_BOT_LOOKAHEAD)
+			break;
+
+		switch (feature.type_)
+		{
+		case SIM_LOW_OBSTACLE:
+			return sim.IsOnGround() ? CTRL_JUMP : 0;
+
+		case SIM_HIGH_OBSTACLE:
+			return sim.IsRolling() ? 0 : CTRL_BACK;
+
+		default:
+			if (lane < 0)
+				return CTRL_RIGHT;
+			if (lane > 0)
+				return CTRL_LEFT;
+			return (random & 2) ? CTRL_LEFT : CTRL_RIGHT;
+		}
+	}
+
+	return 0;
+}
+
+SimBatchResult RunSimBatch(const SimKit& kit, unsigned firstSeed, unsigned numSeeds, unsigned maxSteps)
+{
+	SimBatchResult result;
+	result.checksum_ = 2166136261u;
+	result.numSteps_ = 0;
+	result.numDeaths_ = 0;
+	result.totalScore_ = 0;
+
+	RunnerSim sim;
+	for (unsigned i = 0; i < numSeeds; ++i)
+	{
+		unsigned seed = firstSeed + i;
+		SimBot bot(seed);
+		sim.Start(&kit, seed);
+		while (!sim.IsDead() && sim.GetStep() < maxSteps)
+			sim.Step(CTRL_FORWARD, bot.GetActions(sim));
+
+		result.checksum_ = HashWord(result.checksum_, sim.GetChecksum());
+		result.numSteps_ += sim.GetStep();
+		result.totalScore_ += sim.GetScore();
+		if (sim.IsDead())
+			++result.numDeaths_;
+	}
+
+	return result;
+}
@@ -0,0 +1,312 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "Fixed.h"
+#include "Vector.h"
+
+using namespace Urho3D;
+
+namespace Urho3D
+{
+	class Deserializer;
+	class Serializer;
+}
+
+/// Steps per second of the deterministic simulation.
+static const int SIM_FPS = 60;
+/// Steps of the reference bot runs.
+static const unsigned SIM_REFERENCE_STEPS = 3600;
+/// Seeds of the reference bot runs.
+static const unsigned SIM_REFERENCE_SEEDS = 10000;
+/// Folded checksum of the reference bot runs on the default kit. Every build must reproduce it, see RunSimBatch().
+static const unsigned SIM_REFERENCE_CHECKSUM = 0x2dd7a74a;
+/// Distance between lanes, as between the side and center paths of the blocks.
+static const Fixed SIM_LANE_WIDTH = Fixed::FromRatio(6, 5);
+
+/// Item on a simulated track.
+enum SimFeatureType
+{
+	/// Picked up when run through.
+	SIM_COIN = 0,
+	/// Ground obstacle, must be jumped over.
+	SIM_LOW_OBSTACLE,
+	/// Overhead obstacle, must be rolled under.
+	SIM_HIGH_OBSTACLE,
+	/// Obstacle filling the lane, must be avoided by changing lane.
+	SIM_WALL
+};
+
+/// Item of a simulated block.
+struct SimFeature
+{
+	/// Construct undefined.
+	SimFeature()
+	{
+	}
+
+	/// Construct with values.
+	SimFeature(SimFeatureType type, int lane, Fixed distance, int points = 0, unsigned item = 0) :
+		type_(type),
+		lane_(lane),
+		distance_(distance),
+		points_(points),
+		item_(item)
+	{
+	}
+
+	/// Item type.
+	SimFeatureType type_;
+	/// Lane, -1 left, 0 center, 1 right.
+	int lane_;
+	/// Distance from the start of the block.
+	Fixed distance_;
+	/// Points of a coin.
+	int points_;
+	/// Index of the item among the children of its group, to find its node in a placed block.
+	unsigned item_;
+};
+
+/// Block of a simulated track. Runs straight along three lanes, and ends in a junction if it has a turn exit.
+struct SimBlock
+{
+	/// Construct straight and empty.
+	SimBlock() :
+		leftOut_(false),
+		rightOut_(false)
+	{
+	}
+
+	/// Return whether the block ends in a junction.
+	bool IsJunction() const { return leftOut_ || rightOut_; }
+
+	/// Length of the center lane.
+	Fixed length_;
+	/// Left turn exit flag.
+	bool leftOut_;
+	/// Right turn exit flag.
+	bool rightOut_;
+	/// Length of the left and right exit past the junction, run before the next block starts.
+	Fixed exitLength_[2];
+	/// Alternative item groups, sorted by distance. One group is chosen each time the block is placed.
+	Vector<PODVector<SimFeature> > groups_;
+};
+
+/// Item picked up in a step.
+struct SimPickup
+{
+	/// Number of the block among the blocks entered, from zero.
+	unsigned block_;
+	/// Index of the item among the children of its group.
+	unsigned item_;
+	/// Points awarded.
+	int points_;
+};
+
+/// Blocks a simulated track is chained from.
+class SimKit
+{
+public:
+	/// Replace the blocks with the built-in kit, which depends on no asset and gives the reference checksum.
+	void CreateDefault();
+	/// Add a block. Its groups are sorted by distance.
+	void AddBlock(const SimBlock& block);
+	/// Remove all blocks.
+	void Clear() { blocks_.Clear(); }
+
+	/// Return number of blocks.
+	unsigned GetNumBlocks() const { return blocks_.Size(); }
+	/// Return a block.
+	const SimBlock& GetBlock(unsigned index) const { return blocks_[index]; }
+
+private:
+	/// Blocks.
+	Vector<SimBlock> blocks_;
+};
+
+/// Source of the blocks of a track chosen outside the simulation, such as the blocks a level has placed.
+class SimTrack
+{
+public:
+	/// Destruct.
+	virtual ~SimTrack() {}
+
+	/// Return the kit index and the group, or M_MAX_UNSIGNED for none, of the block after the current one. The turn into it is
+	/// -1 left, 1 right, or 0 for the first block and straight on. Return false if the track ends there.
+	virtual bool GetNextBlock(int turn, unsigned& block, unsigned& group) = 0;
+};
+
+/// Deterministic core of a run: path progress, lanes, jump arcs, rolls, coin pickups and obstacle hits on a track chained
+/// from kit blocks by a seed. Steps are fixed at 1/60 second and all state is 16.16 fixed point, with no dependency on physics,
+/// rendering or the frame rate, so a seed and an input stream give the same run and checksum on every build and platform.
+class RunnerSim
+{
+public:
+	/// Construct without a track.
+	RunnerSim();
+
+	/// Start a run on a track generated from a kit and seed. The kit must outlive the run.
+	void Start(const SimKit* kit, unsigned seed);
+	/// Start a run on a track whose blocks come from a source. Kit and source must outlive the run.
+	void Start(const SimKit* kit, SimTrack* track);
+	/// Advance one step with held control bits and the actions pressed since the previous step, as recorded for ghosts.
+	void Step(int buttons, int actions);
+
+	/// Write the whole simulation state.
+	void Save(Serializer& dest) const;
+	/// Read the state written by Save() for a run on a kit and track source. Return false if the data is malformed.
+	bool Load(Deserializer& source, const SimKit* kit, SimTrack* track);
+
+	/// Return a checksum of the whole simulation state.
+	unsigned GetChecksum() const;
+	/// Return steps simulated.
+	unsigned GetStep() const { return step_; }
+	/// Return score.
+	int GetScore() const { return score_; }
+	/// Return number of coins picked up.
+	int GetNumCoins() const { return numCoins_; }
+	/// Return distance run.
+	float GetDistance() const { return (float)distance_ / (float)FIXED_ONE; }
+	/// Return number of blocks entered, including the current one.
+	unsigned GetNumBlocks() const { return numBlocks_; }
+	/// Return the forward speed.
+	Fixed GetSpeed() const { return speed_; }
+	/// Return the vertical speed.
+	Fixed GetVerticalSpeed() const { return verticalSpeed_; }
+	/// Return the target lane.
+	int GetLane() const { return lane_; }
+	/// Return the sideways position from the center lane.
+	Fixed GetLateral() const { return lateral_; }
+	/// Return the height above the track.
+	Fixed GetHeight() const { return height_; }
+	/// Return whether rolling.
+	bool IsRolling() const { return rollSteps_ > 0; }
+	/// Return whether on the ground.
+	bool IsOnGround() const { return height_.GetRaw() == 0 && verticalSpeed_.GetRaw() <= 0; }
+	/// Return whether the run has ended.
+	bool IsDead() const { return dead_; }
+	/// Return the current block.
+	const SimBlock& GetBlock() const { return kit_->GetBlock(block_); }
+	/// Return the items of the current block.
+	const PODVector<SimFeature>& GetFeatures() const;
+	/// Return the distance into the current block.
+	Fixed GetBlockDistance() const { return blockDistance_; }
+	/// Return whether an item of the current block has been picked up.
+	bool IsPicked(unsigned index) const { return index < picked_.Size() && picked_[index]; }
+	/// Return the items picked up by the last step.
+	const PODVector<SimPickup>& GetPickups() const { return pickups_; }
+	/// Return the index among the children of its group of the obstacle the run ended on, or M_MAX_UNSIGNED if it did not end
+	/// on one.
+	unsigned GetHitItem() const { return hitItem_; }
+
+private:
+	/// Reset the state and enter the first block.
+	void Begin(const SimKit* kit);
+	/// Choose the next block and group from the track source or the seed and enter it. Return false if the track ends.
+	bool EnterBlock(bool first, int turn);
+	/// Handle the items passed in a stretch of the current block.
+	void Pass(Fixed from, Fixed to);
+	/// Return the next number of the track generator, 0-32767.
+	int Rand();
+
+	/// Block kit.
+	const SimKit* kit_;
+	/// Block source, or null to generate the track from the seed.
+	SimTrack* track_;
+	/// Track generator state.
+	unsigned seed_;
+	/// Steps simulated.
+	unsigned step_;
+	/// Current block index in the kit.
+	unsigned block_;
+	/// Chosen group of the current block, or M_MAX_UNSIGNED if it has none.
+	unsigned group_;
+	/// Blocks entered.
+	unsigned numBlocks_;
+	/// Pickup flags of the current block's items.
+	PODVector<unsigned char> picked_;
+	/// Items picked up by the last step.
+	PODVector<SimPickup> pickups_;
+	/// Item the run ended on.
+	unsigned hitItem_;
+	/// Distance into the current block.
+	Fixed blockDistance_;
+	/// Distance run in raw 16.16 units, kept wide so that long runs do not overflow.
+	long long distance_;
+	/// Forward speed.
+	Fixed speed_;
+	/// Sideways position from the center lane.
+	Fixed lateral_;
+	/// Height above the track.
+	Fixed height_;
+	/// Vertical speed.
+	Fixed verticalSpeed_;
+	/// Target lane.
+	int lane_;
+	/// Remaining roll steps.
+	int rollSteps_;
+	/// Remaining steps of the last turn request.
+	int turnSteps_;
+	/// Direction of the last turn request, -1 left, 1 right.
+	int turnDirection_;
+	/// Turns taken.
+	int numTurns_;
+	/// Score.
+	int score_;
+	/// Coins picked up.
+	int numCoins_;
+	/// Run ended flag.
+	bool dead_;
+};
+
+/// Bot that looks a few meters ahead and jumps, rolls, dodges and turns for what it sees, with a seeded share of mistakes.
+class SimBot
+{
+public:
+	/// Construct with a seed.
+	SimBot(unsigned seed);
+
+	/// Return the actions for the next step.
+	int GetActions(const RunnerSim& sim);
+
+private:
+	/// Random state.
+	unsigned seed_;
+};
+
+/// Totals of a batch of bot runs.
+struct SimBatchResult
+{
+	/// Folded final checksums of the runs.
+	unsigned checksum_;
+	/// Steps simulated.
+	unsigned numSteps_;
+	/// Runs that ended in a death.
+	unsigned numDeaths_;
+	/// Sum of the scores.
+	int totalScore_;
+};
+
+/// Run a bot on each of a range of seeds for at most a number of steps, and fold the final checksums in seed order.
+SimBatchResult RunSimBatch(const SimKit& kit, unsigned firstSeed, unsigned numSeeds, unsigned maxSteps);
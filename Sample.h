@@ -28,6 +28,8 @@
 namespace Urho3D
 {
 
+class Console;
+class DebugHud;
 class Sprite;
 
 }
@@ -38,9 +40,9 @@ using namespace Urho3D;
 /// Sample class, as framework for all samples.
 ///    - Initialization of the Urho3D engine (in Application class)
 ///    - Modify engine parameters for windowed mode and to show the class name as title
-///    - Create Urho3D logo at screen;
+///    - Create Urho3D logo at screen when it is first shown;
 ///    - Set custom window title and icon;
-///    - Create Console and Debug HUD, and use F1 and F2 key to toggle them;
+///    - Create Console and Debug HUD on first use, and use F1 and F2 key to toggle them;
 ///    - Toggle rendering options from the keys 1-8;
 ///    - Take screenshot with key 9
 ///    - Handle Esc key down to hide Console or exit application;
@@ -55,13 +57,20 @@ public:
 
     /// Setup before engine initialization. Modifies the engine parameters.
     virtual void Setup();
-    /// Setup after engine initialization. Creates the logo, console & debug HUD.
+    /// Setup after engine initialization. Sets the window title & icon and subscribes to the sample keys.
     virtual void Start();
 
-    /// Control logo visibility.
+    /// Control logo visibility. The logo is created when first shown.
     void SetLogoVisible(bool enable);
 
 protected:
+    /// Return the console, creating it on first use.
+    Console* GetConsole();
+    /// Return the debug HUD, creating it on first use.
+    DebugHud* GetDebugHud();
+    /// Configure the console after it has been created.
+    virtual void SetupConsole(Console* console) {}
+
     /// Logo sprite.
     SharedPtr<Sprite> logoSprite_;
 
@@ -70,8 +79,6 @@ private:
     void CreateLogo();
     /// Set custom window Title & Icon
     void SetWindowTitleAndIcon();
-    /// Create console and debug HUD.
-    void CreateConsoleAndDebugHud();
     /// Handle key down event to process key controls common to all samples.
     void HandleKeyDown(StringHash eventType, VariantMap& eventData);
 };
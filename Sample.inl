@@ -51,25 +51,44 @@ void Sample::Setup()
 
 void Sample::Start()
 {
-    // Create logo
-    CreateLogo();
-
-    // Set custom window Title & Icon
+    // Set custom window Title & Icon. The logo, console and debug HUD are created when first used
     SetWindowTitleAndIcon();
 
-    // Create console and debug HUD
-    CreateConsoleAndDebugHud();
-
     // Subscribe key down event
     SubscribeToEvent(E_KEYDOWN, HANDLER(Sample, HandleKeyDown));
 }
 
 void Sample::SetLogoVisible(bool enable)
 {
+    if (!logoSprite_ && enable)
+        CreateLogo();
     if (logoSprite_)
         logoSprite_->SetVisible(enable);
 }
 
+Console* Sample::GetConsole()
+{
+    Console* console = GetSubsystem<Console>();
+    if (!console)
+    {
+        console = engine_->CreateConsole();
+        console->SetDefaultStyle(GetSubsystem<ResourceCache>()->GetResource<XMLFile>("UI/DefaultStyle.xml"));
+        SetupConsole(console);
+    }
+    return console;
+}
+
+DebugHud* Sample::GetDebugHud()
+{
+    DebugHud* debugHud = GetSubsystem<DebugHud>();
+    if (!debugHud)
+    {
+        debugHud = engine_->CreateDebugHud();
+        debugHud->SetDefaultStyle(GetSubsystem<ResourceCache>()->GetResource<XMLFile>("UI/DefaultStyle.xml"));
+    }
+    return debugHud;
+}
+
 void Sample::CreateLogo()
 {
     // Get logo texture
@@ -116,21 +135,6 @@ void Sample::SetWindowTitleAndIcon()
     graphics->SetWindowTitle("Urho3D Sample");
 }
 
-void Sample::CreateConsoleAndDebugHud()
-{
-    // Get default style
-    ResourceCache* cache = GetSubsystem<ResourceCache>();
-    XMLFile* xmlFile = cache->GetResource<XMLFile>("UI/DefaultStyle.xml");
-
-    // Create console
-    Console* console = engine_->CreateConsole();
-    console->SetDefaultStyle(xmlFile);
-
-    // Create debug HUD.
-    DebugHud* debugHud = engine_->CreateDebugHud();
-    debugHud->SetDefaultStyle(xmlFile);
-}
-
 void Sample::HandleKeyDown(StringHash eventType, VariantMap& eventData)
 {
     using namespace KeyDown;
@@ -141,7 +145,7 @@ void Sample::HandleKeyDown(StringHash eventType, VariantMap& eventData)
     if (key == KEY_ESC)
     {
         Console* console = GetSubsystem<Console>();
-        if (console->IsVisible())
+        if (console && console->IsVisible())
             console->SetVisible(false);
         else
             engine_->Exit();
@@ -149,11 +153,11 @@ void Sample::HandleKeyDown(StringHash eventType, VariantMap& eventData)
 
     // Toggle console with F1
     else if (key == KEY_F1)
-        GetSubsystem<Console>()->Toggle();
+        GetConsole()->Toggle();
     
     // Toggle debug HUD with F2
     else if (key == KEY_F2)
-        GetSubsystem<DebugHud>()->ToggleAll();
+        GetDebugHud()->ToggleAll();
     
     // Common rendering quality controls, only when UI has no focused element
     else if (!GetSubsystem<UI>()->GetFocusElement())
@@ -0,0 +1,72 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "CoreEvents.h"
+#include "Log.h"
+#include "StartupTimeline.h"
+
+/// System time at static initialization, the closest to process start that is portable. Millisecond resolution.
+static const unsigned processStartTime = Time::GetSystemTime();
+
+StartupTimeline::StartupTimeline(Context* context) :
+	Object(context),
+	totalUSec_(0),
+	finished_(false)
+{
+	// Context, engine and subsystem construction happen before the high resolution timer can be used
+	Step step;
+	step.name_ = "Process start";
+	step.usec_ = (long long)(Time::GetSystemTime() - processStartTime) * 1000;
+	steps_.Push(step);
+	totalUSec_ = step.usec_;
+
+	SubscribeToEvent(E_ENDFRAME, HANDLER(StartupTimeline, HandleEndFrame));
+}
+
+void StartupTimeline::Mark(const char* step)
+{
+	if (finished_)
+		return;
+
+	Step newStep;
+	newStep.name_ = step;
+	newStep.usec_ = timer_.GetUSec(true);
+	steps_.Push(newStep);
+	totalUSec_ += newStep.usec_;
+}
+
+void StartupTimeline::Log() const
+{
+	for (unsigned i = 0; i < steps_.Size(); ++i)
+		LOGINFO(ToString("Startup %-20s %8.2f ms", steps_[i].name_, steps_[i].usec_ * 0.001f));
+	LOGINFO(ToString("Startup %-20s %8.2f ms", finished_ ? "Total" : "Total so far", totalUSec_ * 0.001f));
+}
+
+void StartupTimeline::HandleEndFrame(StringHash eventType, VariantMap& eventData)
+{
+	// The engine only starts running frames once the application has started, so the first frame is the menu's
+	Mark("First frame");
+	finished_ = true;
+	UnsubscribeFromEvent(E_ENDFRAME);
+	Log();
+}
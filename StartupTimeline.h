@@ -0,0 +1,71 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "Object.h"
+#include "Timer.h"
+
+using namespace Urho3D;
+
+/// Cold start timeline. Times the startup steps from process start to the end of the first interactive frame, and logs
+/// them when that frame ends.
+class StartupTimeline : public Object
+{
+	OBJECT(StartupTimeline);
+
+public:
+	/// Construct and start the first step, which covers the time from process start to the application constructor.
+	StartupTimeline(Context* context);
+
+	/// End the step in progress and name it. The name must be a string literal.
+	void Mark(const char* step);
+	/// Log the steps and the total.
+	void Log() const;
+	/// Return whether the first interactive frame has ended.
+	bool IsFinished() const { return finished_; }
+	/// Return the time from process start to the last step in microseconds.
+	long long GetTotalUSec() const { return totalUSec_; }
+
+private:
+	/// Handle frame end. Ends the timeline at the first frame.
+	void HandleEndFrame(StringHash eventType, VariantMap& eventData);
+
+	/// A timed step.
+	struct Step
+	{
+		/// Name.
+		const char* name_;
+		/// Duration in microseconds.
+		long long usec_;
+	};
+
+	/// Steps in order.
+	PODVector<Step> steps_;
+	/// Timer of the step in progress.
+	HiresTimer timer_;
+	/// Time from process start to the last step.
+	long long totalUSec_;
+	/// First interactive frame ended flag.
+	bool finished_;
+};
@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+#
+# Local stand-in for the AutoRunner leaderboard server, for testing result submission.
+#
+# Accepts POST requests whose body is a player ID line followed by one "score distance coins" line per run,
+# and answers "OK <best score>". Scores are kept in a JSON file next to this script.
+#
+#   python3 LeaderboardServer.py [--port 8080] [--fail-rate 0.3] [--delay 2.0]
+#   AutoRunner -leaderboard http://127.0.0.1:8080/scores
+#
+# --fail-rate answers that fraction of requests with an error and --delay holds each answer back,
+# to exercise the client's retries and to check that a slow server does not show in the frame time.
+
+import argparse
+import json
+import os
+import random
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+SCORES_FILE = os.path.join(os.path.dirname(os.path.abspath(__file__)), "LeaderboardScores.json")
+
+
+def load_scores():
+    if os.path.exists(SCORES_FILE):
+        with open(SCORES_FILE) as f:
+            return json.load(f)
+    return []
+
+
+def save_scores(scores):
+    with open(SCORES_FILE, "w") as f:
+        json.dump(scores, f, indent=1)
+
+
+class LeaderboardHandler(BaseHTTPRequestHandler):
+    def do_POST(self):
+        body = self.rfile.read(int(self.headers.get("Content-Length", 0))).decode("utf-8", "replace")
+        time.sleep(self.server.options.delay)
+
+        if random.random() < self.server.options.fail_rate:
+            self.answer(503, "ERROR unavailable")
+            return
+
+        lines = [line.split() for line in body.splitlines() if line.strip()]
+        if not lines or any(len(line) != 3 for line in lines[1:]):
+            self.answer(400, "ERROR malformed")
+            return
+
+        player = lines[0][0]
+        # Requests are handled on their own threads, the score list and its file are shared
+        with self.server.lock:
+            for score, distance, coins in lines[1:]:
+                self.server.scores.append({"player": player, "score": int(score), "distance": int(distance),
+                                           "coins": int(coins), "time": int(time.time())})
+            save_scores(self.server.scores)
+            best = max(entry["score"] for entry in self.server.scores)
+        print("%s posted %d results, best %d" % (player, len(lines) - 1, best))
+        self.answer(200, "OK %d" % best)
+
+    def do_GET(self):
+        with self.server.lock:
+            top = sorted(self.server.scores, key=lambda entry: entry["score"], reverse=True)[:10]
+        self.answer(200, "\n".join("%s %d" % (entry["player"], entry["score"]) for entry in top))
+
+    def answer(self, status, text):
+        data = text.encode("utf-8")
+        self.send_response(status)
+        self.send_header("Content-Type", "text/plain")
+        self.send_header("Content-Length", str(len(data)))
+        self.end_headers()
+        self.wfile.write(data)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="AutoRunner leaderboard stand-in")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--fail-rate", type=float, default=0.0)
+    parser.add_argument("--delay", type=float, default=0.0)
+    options = parser.parse_args()
+
+    server = ThreadingHTTPServer(("", options.port), LeaderboardHandler)
+    server.options = options
+    server.scores = load_scores()
+    server.lock = threading.Lock()
+    print("Leaderboard stand-in listening on port %d" % options.port)
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
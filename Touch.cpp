@@ -28,6 +28,7 @@
 #include "Graphics.h"
 #include "Input.h"
 #include "InputEvents.h"
+#include "LatencyTracer.h"
 #include "Log.h"
 #include "Octree.h"
 #include "PhysicsWorld.h"
@@ -39,6 +40,72 @@
 #include "Touch.h"
 #include "UI.h"
 
+#include <SDL/SDL_timer.h>
+
+SwipeRecognizer::SwipeRecognizer() :
+	touchID_(-1),
+	origin_(IntVector2::ZERO),
+	startTime_(0),
+	fired_(false)
+{
+}
+
+void SwipeRecognizer::Begin(const InputEvent& event)
+{
+	// Only the first finger down is tracked as a swipe.
+	if (touchID_ >= 0)
+		return;
+
+	touchID_ = event.touchID_;
+	origin_ = event.position_;
+	startTime_ = event.timestamp_;
+	fired_ = false;
+}
+
+int SwipeRecognizer::Move(const InputEvent& event, float screenHeight)
+{
+	if (event.touchID_ != touchID_ || fired_ || screenHeight <= 0.0f)
+		return 0;
+
+	IntVector2 delta = event.position_ - origin_;
+	float dx = (float)delta.x_ / screenHeight;
+	float dy = (float)delta.y_ / screenHeight;
+	float absX = Abs(dx);
+	float absY = Abs(dy);
+	float distance = sqrtf(dx * dx + dy * dy);
+
+	if (distance < SWIPE_MIN_DISTANCE)
+		return 0;
+
+	// Direction is still ambiguous, wait for more samples.
+	if (absX < absY * SWIPE_DOMINANCE && absY < absX * SWIPE_DOMINANCE)
+		return 0;
+
+	// Touch samples within the same millisecond are treated as one millisecond apart.
+	float elapsed = Max((float)(event.timestamp_ - startTime_), 1.0f) * 0.001f;
+	if (distance / elapsed < SWIPE_MIN_VELOCITY && distance < SWIPE_MIN_DISTANCE * 3.0f)
+		return 0;
+
+	fired_ = true;
+
+	if (absX > absY)
+		return dx < 0.0f ? CTRL_LEFT : CTRL_RIGHT;
+	else
+		return dy < 0.0f ? CTRL_JUMP : CTRL_BACK;
+}
+
+void SwipeRecognizer::End(const InputEvent& event)
+{
+	if (event.touchID_ == touchID_)
+		Reset();
+}
+
+void SwipeRecognizer::Reset()
+{
+	touchID_ = -1;
+	fired_ = false;
+}
+
 Touch::Touch(Context* context) :
     Object(context),
     cameraDistance_(CAMERA_INITIAL_DIST),
@@ -51,10 +118,7 @@ Touch::Touch(Context* context) :
     newFirstPerson_(false),
     shadowMode_(false),
     zoom_(false),
-    touchEnabled_(false),
-	touchMoved_(false),
-	maxMovement_(0),
-	deltaXY_(IntVector2::ZERO)
+    touchEnabled_(false)
 {
 }
 
@@ -158,34 +222,6 @@ void Touch::UpdateTouches(Controls& controls) // Called from HandleUpdate
                     controls.pitch_ = Clamp(controls.pitch_, -80.0f, 80.0f); // Limit pitch
                 }*/
 
-				if (touchMoved_ && deltaXY_ != IntVector2::ZERO)
-				{
-					float degree = Urho3D::Atan2(-(float)deltaXY_.y_, (float)deltaXY_.x_);
-					if (IsLeft(deltaXY_, degree))
-					{
-						controls.Set(CTRL_LEFT, true);
-						maxMovement_++;
-					}
-
-					if (IsRight(deltaXY_, degree))
-					{
-						controls.Set(CTRL_RIGHT, true);
-						maxMovement_++;
-					}
-
-					if (IsBack(deltaXY_, degree))
-					{
-						controls.Set(CTRL_BACK, true);
-						maxMovement_++;
-					}
-
-					if (IsUp(deltaXY_, degree))
-					{
-						controls.Set(CTRL_JUMP, true);
-						maxMovement_++;
-					}
-				}
-
                 /*if (touch->touchID_ == moveTouchID_)
                 {
                     int relX = touch->position_.x_ - moveButton_->GetScreenPosition().x_ - touchButtonSize_ / 2;
@@ -224,13 +260,51 @@ void Touch::UpdateTouches(Controls& controls) // Called from HandleUpdate
     }*/
 }
 
+int Touch::ApplyInput() // Called from the physics pre-step
+{
+	float screenHeight = (float)GetSubsystem<Graphics>()->GetHeight();
+	LatencyTracer* tracer = GetSubsystem<LatencyTracer>();
+	InputEvent event;
+	int actions = 0;
+
+	while (inputEvents_.Pop(event))
+	{
+		switch (event.type_)
+		{
+		case INPUT_TOUCH_BEGIN:
+			swipe_.Begin(event);
+			break;
+		case INPUT_TOUCH_MOVE:
+			{
+				int control = swipe_.Move(event, screenHeight);
+				if (control)
+				{
+					actions |= control;
+					if (tracer)
+					{
+						// Trace from the sample that made the swipe unambiguous.
+						tracer->BeginInput(control, event.timestamp_);
+						tracer->Mark(control, LATENCY_CONTROLS);
+					}
+				}
+			}
+			break;
+		case INPUT_TOUCH_END:
+			swipe_.End(event);
+			break;
+		}
+	}
+
+	return actions;
+}
+
 void Touch::HandleTouchBegin(StringHash eventType, VariantMap& eventData)
 {
     using namespace TouchBegin;
 
-	touchMoved_ = true;
-	deltaXY_ = IntVector2::ZERO;
-	maxMovement_ = 0;
+	// Events are sent while SDL input is pumped, so the tick count here is the receive time of the touch.
+	inputEvents_.Push(InputEvent(INPUT_TOUCH_BEGIN, eventData[P_TOUCHID].GetInt(),
+		IntVector2(eventData[P_X].GetInt(), eventData[P_Y].GetInt()), SDL_GetTicks()));
 
     /*int touchID = eventData[P_TOUCHID].GetInt(); // Get #touches or dragging value
     IntVector2 pos(eventData[P_X].GetInt(), eventData[P_Y].GetInt()); // Get touch coordinates
@@ -272,12 +346,10 @@ void Touch::HandleTouchBegin(StringHash eventType, VariantMap& eventData)
 
 void Touch::HandleTouchEnd(StringHash eventType, VariantMap& eventData)
 {
-    using namespace TouchBegin;
-
-	//int touchID = eventData[P_TOUCHID].GetInt();
-	//IntVector2 pos(eventData[P_X].GetInt(), eventData[P_Y].GetInt()); // Get touch coordinates
+    using namespace TouchEnd;
 
-	touchMoved_ = false;
+	inputEvents_.Push(InputEvent(INPUT_TOUCH_END, eventData[P_TOUCHID].GetInt(),
+		IntVector2(eventData[P_X].GetInt(), eventData[P_Y].GetInt()), SDL_GetTicks()));
 
     /*if (touchID == moveTouchID_)
         moveTouchID_ = -1;
@@ -295,63 +367,12 @@ void Touch::HandleTouchMove(StringHash eventType, VariantMap& eventData)
 {
 	using namespace TouchMove;
 
-	IntVector2 pos(eventData[P_X].GetInt(), eventData[P_Y].GetInt()); // Get touch coordinates
-	IntVector2 deltaPos(eventData[P_DX].GetInt(), eventData[P_DY].GetInt()); // Get touch coordinates
-	unsigned int sampleSize = 3;
-
-	if(moveTouches_.Size() >= sampleSize)
-	{
-		for (unsigned int i = 0; i < moveTouches_.Size(); i++)
-			deltaXY_ += moveTouches_[i];
-
-		if (maxMovement_ > 1)
-			deltaXY_ = IntVector2::ZERO;
-		else
-			deltaXY_ /= sampleSize;
-
-		moveTouches_.Clear();
-	}
-	else
-	{
-		moveTouches_.Push(deltaPos);
-	}
+	inputEvents_.Push(InputEvent(INPUT_TOUCH_MOVE, eventData[P_TOUCHID].GetInt(),
+		IntVector2(eventData[P_X].GetInt(), eventData[P_Y].GetInt()), SDL_GetTicks()));
 }
 
 void Touch::Reset()
 {
-	touchMoved_ = false;
-	maxMovement_ = 0;
-	deltaXY_ = IntVector2::ZERO;
-}
-
-bool Touch::IsBack(const IntVector2& delta, float degree)
-{
-	if (Urho3D::Equals(degree, -90.0f) || (degree < -45 && degree > -90) || (degree < -90 && degree > -135))
-		return true;
-
-	return false;
-}
-
-bool Touch::IsLeft(const IntVector2& delta, float degree)
-{
-	if (Urho3D::Equals(degree, -180.0f) || (degree < 180 && degree > 135) || (degree > -180 && degree < -135))
-		return true;
-
-	return false;
-}
-
-bool Touch::IsRight(const IntVector2& delta, float degree)
-{
-	if (Urho3D::Equals(degree, 0.0f) || (degree < 45 && degree > 0) || (degree < 0 && degree > -45))
-		return true;
-
-	return false;
-}
-
-bool Touch::IsUp(const IntVector2& delta, float degree)
-{
-	if (Urho3D::Equals(degree, 90.0f) || (degree < 90 && degree > 45) || (degree < 135 && degree > 90))
-		return true;
-
-	return false;
+	inputEvents_.Clear();
+	swipe_.Reset();
 }
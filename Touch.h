@@ -22,6 +22,7 @@
 
 #pragma once
 
+#include "InputQueue.h"
 #include "Object.h"
 
 using namespace Urho3D;
@@ -40,6 +41,39 @@ const float GYROSCOPE_THRESHOLD = 0.1f;
 const float CAMERA_MIN_DIST = 4.99f;
 const float CAMERA_INITIAL_DIST = 5.0f;
 const float CAMERA_MAX_DIST = 20.0f;
+/// Minimum swipe length as a fraction of the screen height.
+const float SWIPE_MIN_DISTANCE = 0.04f;
+/// Minimum swipe speed in screen heights per second. Slower drags need three times the minimum length.
+const float SWIPE_MIN_VELOCITY = 0.6f;
+/// Ratio the dominant axis must exceed the other one by before the direction is considered unambiguous.
+const float SWIPE_DOMINANCE = 1.5f;
+
+/// Velocity-based swipe recognizer. Fires once per touch as soon as the swipe direction is unambiguous.
+class SwipeRecognizer
+{
+public:
+	/// Construct.
+	SwipeRecognizer();
+
+	/// Start tracking a touch.
+	void Begin(const InputEvent& event);
+	/// Feed a move sample. Return the recognized control bit, or 0 if nothing was recognized.
+	int Move(const InputEvent& event, float screenHeight);
+	/// Stop tracking a touch.
+	void End(const InputEvent& event);
+	/// Stop tracking any touch.
+	void Reset();
+
+private:
+	/// Tracked touch ID, or -1 for none.
+	int touchID_;
+	/// Position at touch begin.
+	IntVector2 origin_;
+	/// Timestamp at touch begin.
+	unsigned startTime_;
+	/// Already fired for the tracked touch flag.
+	bool fired_;
+};
 
 /// Mobile framework for Android/iOS
 /// Gamepad from NinjaSnowWar
@@ -58,6 +92,7 @@ const float CAMERA_MAX_DIST = 20.0f;
 ///   -> to detect platform, use 'if (GetPlatform() == "Android" || GetPlatform() == "iOS")' from ProcessUtils.h
 /// - Subscribe to touch events (Begin, Move, End) using 'SubscribeToTouchEvents()'
 /// - Call the update function 'UpdateTouches()' from HandleUpdate or equivalent update handler function
+/// - Call 'ApplyInput()' from the physics pre-step and queue the returned actions, so that recognized swipes apply at the next fixed step
 class Touch : public Object
 {
     OBJECT(Touch);
@@ -74,6 +109,8 @@ public:
     void SubscribeToTouchEvents();
     /// Update touch controls for the current frame.
     void UpdateTouches(Controls& controls);
+    /// Drain queued touch samples through the swipe recognizer. Return the recognized action control bits. Called before each physics step.
+    int ApplyInput();
     /// Handle finger touch begin.
     void HandleTouchBegin(StringHash eventType, VariantMap& eventData);
     /// Handle finger touch end.
@@ -115,17 +152,11 @@ public:
     bool touchEnabled_;
 
 private:
-	bool IsBack(const IntVector2& delta, float degree);
-	bool IsLeft(const IntVector2& delta, float degree);
-	bool IsRight(const IntVector2& delta, float degree);
-	bool IsUp(const IntVector2& delta, float degree);
-
 	/// Game mechanics.
-	bool touchMoved_;
-	/// Max movement between TouchBegin and TouchEnd event.
-	unsigned int maxMovement_;
-	IntVector2 deltaXY_;
-	PODVector<IntVector2> moveTouches_;
+	/// Timestamped touch samples, produced by the touch event handlers and consumed at the physics step.
+	InputRing<InputEvent, 64> inputEvents_;
+	/// Swipe recognizer.
+	SwipeRecognizer swipe_;
 
 };
 